@@ -0,0 +1,322 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Multithreaded lookup benchmark. Several threads repeatedly read the first children of the wide aggregate by index, with one
+ * thread modifying values at the same time, once with a single mutex guarding every call, once with the tree in
+ * concurrent mode locking every call, and once in concurrent mode with each reader holding the lock of the tree across
+ * a pass over the children. Every result is printed as one JSON object per line.
+ * Usage: concurrent <data_directory> [iterations]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "slconfig/slconfig.h"
+
+#define MAX_THREADS (8)
+/* The reads are cheap, so that the cost of the locking shows */
+#define MAX_LOOKUPS (256)
+#define PASSES_PER_ITERATION (200)
+/* Values modified by the writer per pass of a reader over the names */
+#define WRITES_PER_PASS (4)
+
+#ifdef _WIN32
+typedef HANDLE THREAD;
+typedef CRITICAL_SECTION MUTEX;
+#else
+typedef pthread_t THREAD;
+typedef pthread_mutex_t MUTEX;
+#endif
+
+static
+double get_time()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+typedef struct
+{
+	SLCONFIG_NODE* wide;
+	const SLCONFIG_STRING* names;
+	size_t num_names;
+	int iterations;
+	/* NULL when the tree is in concurrent mode */
+	MUTEX* mutex;
+	/* Whether the readers hold the lock of the tree across each pass */
+	bool scoped;
+	size_t num_found;
+} TASK;
+
+static
+void lock(MUTEX* mutex)
+{
+	if(!mutex)
+		return;
+#ifdef _WIN32
+	EnterCriticalSection(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+static
+void unlock(MUTEX* mutex)
+{
+	if(!mutex)
+		return;
+#ifdef _WIN32
+	LeaveCriticalSection(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+static
+void read_values(TASK* task)
+{
+	for(int pass = 0; pass < task->iterations * PASSES_PER_ITERATION; pass++)
+	{
+		if(task->scoped)
+			slc_begin_read(task->wide);
+		for(size_t ii = 0; ii < task->num_names; ii++)
+		{
+			lock(task->mutex);
+			SLCONFIG_NODE* node = slc_get_node_by_index(task->wide, ii);
+			unlock(task->mutex);
+			
+			lock(task->mutex);
+			SLCONFIG_STRING value = slc_get_value(node);
+			unlock(task->mutex);
+			task->num_found += value.start != NULL;
+		}
+		if(task->scoped)
+			slc_end_read(task->wide);
+	}
+}
+
+static
+void write_values(TASK* task)
+{
+	size_t num_writes = (size_t)task->iterations * PASSES_PER_ITERATION * WRITES_PER_PASS;
+	for(size_t ii = 0; ii < num_writes; ii++)
+	{
+		lock(task->mutex);
+		SLCONFIG_NODE* node = slc_get_node(task->wide, task->names[ii % task->num_names]);
+		unlock(task->mutex);
+		
+		lock(task->mutex);
+		slc_set_value(node, slc_from_c_str("changed"), false);
+		unlock(task->mutex);
+	}
+}
+
+#ifdef _WIN32
+static
+DWORD WINAPI reader_thread(void* arg)
+{
+	read_values(arg);
+	return 0;
+}
+
+static
+DWORD WINAPI writer_thread(void* arg)
+{
+	write_values(arg);
+	return 0;
+}
+#else
+static
+void* reader_thread(void* arg)
+{
+	read_values(arg);
+	return NULL;
+}
+
+static
+void* writer_thread(void* arg)
+{
+	write_values(arg);
+	return NULL;
+}
+#endif
+
+static
+bool start_thread(THREAD* thread, bool writer, TASK* task)
+{
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, writer ? &writer_thread : &reader_thread, task, 0, NULL);
+	return *thread != NULL;
+#else
+	return pthread_create(thread, NULL, writer ? &writer_thread : &reader_thread, task) == 0;
+#endif
+}
+
+static
+void join_thread(THREAD thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+/* Returns the number of seconds it took all the readers to finish, or a negative number on failure */
+static
+double run_readers(SLCONFIG_NODE* wide, const SLCONFIG_STRING* names, size_t num_names, size_t num_readers,
+                   bool writer, int iterations, MUTEX* mutex, bool scoped)
+{
+	TASK tasks[MAX_THREADS + 1];
+	THREAD threads[MAX_THREADS + 1];
+	size_t num_threads = num_readers + writer;
+	bool success = true;
+	
+	double start = get_time();
+	size_t num_started = 0;
+	for(; num_started < num_threads; num_started++)
+	{
+		TASK* task = &tasks[num_started];
+		task->wide = wide;
+		task->names = names;
+		task->num_names = num_names;
+		task->iterations = iterations;
+		task->mutex = mutex;
+		task->scoped = scoped;
+		task->num_found = 0;
+		if(!start_thread(&threads[num_started], num_started == num_readers, task))
+		{
+			success = false;
+			break;
+		}
+	}
+	
+	for(size_t ii = 0; ii < num_started; ii++)
+		join_thread(threads[ii]);
+	double seconds = get_time() - start;
+	
+	for(size_t ii = 0; ii < num_readers && ii < num_started; ii++)
+		success &= tasks[ii].num_found == num_names * iterations * PASSES_PER_ITERATION;
+	return success ? seconds : -1;
+}
+
+static
+void report(const char* operation, size_t num_readers, bool writer, double seconds, size_t num_reads)
+{
+	if(seconds <= 0)
+		seconds = 1e-9;
+	printf("{\"case\": \"wide\", \"operation\": \"%s\", \"threads\": %zu, \"writer\": %s, \"seconds\": %.9f, "
+	       "\"reads\": %zu, \"reads_per_s\": %.1f}\n",
+	       operation, num_readers, writer ? "true" : "false", seconds, num_reads, num_reads / seconds);
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage:\n%s <data_directory> [iterations]\n", argv[0]);
+		return -1;
+	}
+	
+	const char* dir = argv[1];
+	int iterations = argc > 2 ? atoi(argv[2]) : 3;
+	if(iterations < 1)
+		iterations = 1;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_add_search_directory(root, slc_from_c_str(dir), true);
+	if(!slc_load_nodes(root, slc_from_c_str("wide.cfg")))
+	{
+		fprintf(stderr, "Could not load '%s/wide.cfg'. Run the generator first.\n", dir);
+		slc_destroy_node(root);
+		return -1;
+	}
+	
+	SLCONFIG_NODE* wide = slc_get_node(root, slc_from_c_str("wide"));
+	size_t num_names = slc_get_num_children(wide);
+	if(num_names > MAX_LOOKUPS)
+		num_names = MAX_LOOKUPS;
+	SLCONFIG_STRING* names = malloc(num_names * sizeof(SLCONFIG_STRING));
+	for(size_t ii = 0; ii < num_names; ii++)
+		names[ii] = slc_get_name(slc_get_node_by_index(wide, ii));
+	
+	MUTEX mutex;
+#ifdef _WIN32
+	InitializeCriticalSection(&mutex);
+#else
+	pthread_mutex_init(&mutex, NULL);
+#endif
+	
+	bool success = true;
+	for(size_t num_readers = 1; num_readers <= MAX_THREADS && success; num_readers *= 2)
+	{
+		for(int writer = 0; writer < 2 && success; writer++)
+		{
+			size_t num_reads = num_names * iterations * PASSES_PER_ITERATION * num_readers;
+			
+			double seconds = run_readers(wide, names, num_names, num_readers, writer, iterations, &mutex, false);
+			success &= seconds >= 0;
+			report("mutex", num_readers, writer, seconds, num_reads);
+			
+			for(int scoped = 0; scoped < 2; scoped++)
+			{
+				success &= slc_set_concurrent(root, true);
+				seconds = run_readers(wide, names, num_names, num_readers, writer, iterations, NULL, scoped);
+				success &= seconds >= 0;
+				report(scoped ? "concurrent_scoped" : "concurrent", num_readers, writer, seconds, num_reads);
+				/* Frees the values replaced by the writer */
+				slc_set_concurrent(root, false);
+			}
+		}
+	}
+	
+	if(!success)
+		fprintf(stderr, "Failed to run the readers.\n");
+	
+#ifdef _WIN32
+	DeleteCriticalSection(&mutex);
+#else
+	pthread_mutex_destroy(&mutex);
+#endif
+	free(names);
+	slc_destroy_node(root);
+	return success ? 0 : -1;
+}
@@ -0,0 +1,252 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Generates synthetic configuration files for the benchmark driver. Each file stresses a different part of the
+ * parser. Usage: generate <output_directory> [scale]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+static
+FILE* open_output(const char* dir, const char* name)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE* f = fopen(path, "wb");
+	if(!f)
+		fprintf(stderr, "Could not open '%s' for writing.\n", path);
+	return f;
+}
+
+/* One aggregate with very many string children */
+static
+bool generate_wide(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	fprintf(f, "wide\n{\n");
+	for(int ii = 0; ii < 20000 * scale; ii++)
+	{
+		switch(ii % 3)
+		{
+			case 0:
+				fprintf(f, "\tint n%d = %d;\n", ii, ii * 7919);
+				break;
+			case 1:
+				fprintf(f, "\tdouble n%d = %d.%de-3;\n", ii, ii, ii % 1000);
+				break;
+			default:
+				fprintf(f, "\tn%d = \"value %d\";\n", ii, ii);
+		}
+	}
+	fprintf(f, "}\n");
+	return true;
+}
+
+/* Many chains of nested aggregates */
+static
+bool generate_deep(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	const int depth = 200;
+	for(int chain = 0; chain < 50 * scale; chain++)
+	{
+		fprintf(f, "chain%d", chain);
+		for(int ii = 0; ii < depth; ii++)
+			fprintf(f, " { d%d", ii);
+		fprintf(f, " = leaf;");
+		for(int ii = 0; ii < depth; ii++)
+			fprintf(f, " }");
+		fprintf(f, "\n");
+	}
+	return true;
+}
+
+/* A single chain of aggregates, deep enough to overflow the call stack of a recursive parser */
+static
+bool generate_nested(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	const int depth = 100000 * scale;
+	fprintf(f, "nested");
+	for(int ii = 0; ii < depth; ii++)
+		fprintf(f, " { n");
+	fprintf(f, " = leaf;");
+	for(int ii = 0; ii < depth; ii++)
+		fprintf(f, " }");
+	fprintf(f, "\n");
+	return true;
+}
+
+/* Aggregates built by expanding a template, and strings built by expanding its values */
+static
+bool generate_expand(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	fprintf(f, "template\n{\n");
+	for(int ii = 0; ii < 20; ii++)
+		fprintf(f, "\tfield%d = %d;\n", ii, ii);
+	fprintf(f, "}\n");
+	
+	for(int ii = 0; ii < 5000 * scale; ii++)
+	{
+		fprintf(f, "item%d\n{\n\t$template;\n\tfield%d = override;\n\tcopy = $template:field%d;\n}\n", ii, ii % 20, (ii + 1) % 20);
+	}
+	return true;
+}
+
+/* Values made of many concatenated pieces */
+static
+bool generate_concat(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	fprintf(f, "piece = xyz;\n");
+	for(int ii = 0; ii < 10000 * scale; ii++)
+	{
+		fprintf(f, "c%d =", ii);
+		for(int jj = 0; jj < 50; jj++)
+		{
+			if(jj % 10 == 9)
+				fprintf(f, " $piece");
+			else
+				fprintf(f, " p%d", jj);
+		}
+		fprintf(f, ";\n");
+	}
+	return true;
+}
+
+/* Heredoc values that contain quotes and near-misses of their sentinel */
+static
+bool generate_heredoc(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	for(int ii = 0; ii < 10000 * scale; ii++)
+	{
+		fprintf(f, "h%d = EOF\"", ii);
+		for(int jj = 0; jj < 8; jj++)
+			fprintf(f, "line %d with \"quotes\" and \"EO almost ending it\n", jj);
+		fprintf(f, "\"EOF;\n");
+	}
+	return true;
+}
+
+/* Heredoc values with a long sentinel, full of quotes followed by all but the last character of it */
+static
+bool generate_sentinel(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	char sentinel[257];
+	memset(sentinel, '-', 256);
+	sentinel[256] = '\0';
+	for(int ii = 0; ii < 500 * scale; ii++)
+	{
+		fprintf(f, "s%d = %s\"", ii, sentinel);
+		for(int jj = 0; jj < 50; jj++)
+			fprintf(f, "\"%.255sx", sentinel);
+		fprintf(f, "\"%s;\n", sentinel);
+	}
+	return true;
+}
+
+/* Nested block comments, full of characters that almost open or close them */
+static
+bool generate_comments(const char* dir, FILE* f, int scale)
+{
+	(void)dir;
+	for(int ii = 0; ii < 2000 * scale; ii++)
+	{
+		for(int jj = 0; jj < 50; jj++)
+			fprintf(f, "/* * / ** // ");
+		fprintf(f, "\n");
+		for(int jj = 0; jj < 50; jj++)
+			fprintf(f, "*/");
+		fprintf(f, "\nc%d = %d;\n", ii, ii);
+	}
+	return true;
+}
+
+/* A file that includes many other files */
+static
+bool generate_include(const char* dir, FILE* f, int scale)
+{
+	for(int ii = 0; ii < 200 * scale; ii++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "include_%d.cfg", ii);
+		fprintf(f, "inc%d\n{\n\t#include \"%s\";\n}\n", ii, name);
+		
+		FILE* included = open_output(dir, name);
+		if(!included)
+			return false;
+		for(int jj = 0; jj < 500; jj++)
+			fprintf(included, "v%d = %d;\n", jj, ii * jj);
+		fclose(included);
+	}
+	return true;
+}
+
+typedef struct
+{
+	const char* name;
+	bool (*generate)(const char* dir, FILE* f, int scale);
+} GENERATOR;
+
+static const GENERATOR generators[] =
+{
+	{"wide.cfg", &generate_wide},
+	{"deep.cfg", &generate_deep},
+	{"nested.cfg", &generate_nested},
+	{"expand.cfg", &generate_expand},
+	{"concat.cfg", &generate_concat},
+	{"heredoc.cfg", &generate_heredoc},
+	{"sentinel.cfg", &generate_sentinel},
+	{"comments.cfg", &generate_comments},
+	{"include.cfg", &generate_include},
+};
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage:\n%s <output_directory> [scale]\n", argv[0]);
+		return -1;
+	}
+	
+	const char* dir = argv[1];
+	int scale = argc > 2 ? atoi(argv[2]) : 1;
+	if(scale < 1)
+		scale = 1;
+	
+	for(size_t ii = 0; ii < sizeof(generators) / sizeof(generators[0]); ii++)
+	{
+		FILE* f = open_output(dir, generators[ii].name);
+		if(!f)
+			return -1;
+		bool success = generators[ii].generate(dir, f, scale);
+		fclose(f);
+		if(!success)
+			return -1;
+	}
+	
+	return 0;
+}
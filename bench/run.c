@@ -0,0 +1,400 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ * 
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Benchmark driver. Loads the files produced by the generator and times the main operations of the library. Every
+ * result is printed as one JSON object per line. Usage: run <data_directory> [iterations]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "slconfig/slconfig.h"
+
+/* Keeps the size of each allocation in front of it, so that the live byte count can be tracked */
+#define HEADER_SIZE (16)
+
+static size_t num_allocations;
+static size_t cur_bytes;
+static size_t peak_bytes;
+
+static
+void* counting_realloc(void* buf, size_t size)
+{
+	size_t old_size = 0;
+	char* block = NULL;
+	if(buf)
+	{
+		block = (char*)buf - HEADER_SIZE;
+		memcpy(&old_size, block, sizeof(size_t));
+	}
+	
+	if(size == 0)
+	{
+		free(block);
+		cur_bytes -= old_size;
+		return NULL;
+	}
+	
+	block = realloc(block, size + HEADER_SIZE);
+	if(!block)
+		return NULL;
+	memcpy(block, &size, sizeof(size_t));
+	
+	num_allocations++;
+	cur_bytes += size - old_size;
+	if(cur_bytes > peak_bytes)
+		peak_bytes = cur_bytes;
+	return block + HEADER_SIZE;
+}
+
+static
+void ignore_error(SLCONFIG_STRING s)
+{
+	(void)s;
+}
+
+static
+double get_time()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+typedef struct
+{
+	double seconds;
+	size_t allocations;
+	size_t peak_bytes;
+} MEASUREMENT;
+
+static
+void start_measurement(double* start)
+{
+	num_allocations = 0;
+	peak_bytes = cur_bytes;
+	*start = get_time();
+}
+
+/* Keeps the fastest of the iterations, and the allocation counts of the last one */
+static
+void end_measurement(double start, size_t base_bytes, MEASUREMENT* result)
+{
+	double seconds = get_time() - start;
+	if(result->seconds == 0 || seconds < result->seconds)
+		result->seconds = seconds;
+	result->allocations = num_allocations;
+	result->peak_bytes = peak_bytes - base_bytes;
+}
+
+static
+void report(const char* name, const char* operation, const MEASUREMENT* result, size_t bytes, size_t nodes)
+{
+	double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+	printf("{\"case\": \"%s\", \"operation\": \"%s\", \"seconds\": %.9f, \"bytes\": %zu, \"nodes\": %zu, "
+	       "\"mb_per_s\": %.3f, \"nodes_per_s\": %.1f, \"allocations\": %zu, \"peak_bytes\": %zu}\n",
+	       name, operation, result->seconds, bytes, nodes,
+	       bytes / seconds / (1024 * 1024), nodes / seconds, result->allocations, result->peak_bytes);
+}
+
+/* Uses an explicit stack, as the nested case is too deep to recurse through */
+static
+size_t count_nodes(SLCONFIG_NODE* node)
+{
+	size_t ret = 0;
+	size_t stack_size = 1;
+	size_t stack_capacity = 64;
+	SLCONFIG_NODE** stack = malloc(stack_capacity * sizeof(SLCONFIG_NODE*));
+	stack[0] = node;
+	while(stack_size)
+	{
+		node = stack[--stack_size];
+		ret++;
+		for(size_t ii = 0; ii < slc_get_num_children(node); ii++)
+		{
+			if(stack_size == stack_capacity)
+			{
+				stack_capacity *= 2;
+				stack = realloc(stack, stack_capacity * sizeof(SLCONFIG_NODE*));
+			}
+			stack[stack_size++] = slc_get_node_by_index(node, ii);
+		}
+	}
+	free(stack);
+	return ret;
+}
+
+/* The same count as count_nodes, through the walker */
+static
+size_t walk_nodes(SLCONFIG_NODE* node)
+{
+	size_t ret = 0;
+	SLCONFIG_WALKER walker;
+	slc_walk_begin(&walker, node);
+	while(slc_walk_next(&walker))
+		ret += walker.event != SLCONFIG_WALK_LEAVE;
+	return ret;
+}
+
+static
+char* read_file(const char* dir, const char* name, size_t* size)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE* f = fopen(path, "rb");
+	if(!f)
+		return NULL;
+	
+	fseek(f, 0, SEEK_END);
+	*size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char* ret = malloc(*size ? *size : 1);
+	if(fread(ret, 1, *size, f) != *size)
+	{
+		free(ret);
+		ret = NULL;
+	}
+	fclose(f);
+	return ret;
+}
+
+static
+SLCONFIG_NODE* create_root(const char* dir, const SLCONFIG_VTABLE* vtable)
+{
+	SLCONFIG_NODE* root = slc_create_root_node(vtable);
+	slc_add_search_directory(root, slc_from_c_str(dir), true);
+	return root;
+}
+
+typedef struct
+{
+	const char* name;
+	/* The saved size grows quadratically with the depth when indenting */
+	const char* indentation;
+} CASE;
+
+static
+bool run_case(const char* dir, const char* name, const char* indentation, int iterations, const SLCONFIG_VTABLE* vtable)
+{
+	char filename[256];
+	snprintf(filename, sizeof(filename), "%s.cfg", name);
+	size_t size;
+	char* contents = read_file(dir, filename, &size);
+	if(!contents)
+	{
+		fprintf(stderr, "Could not read '%s/%s'. Run the generator first.\n", dir, filename);
+		return false;
+	}
+	
+	MEASUREMENT load_file = {0, 0, 0};
+	MEASUREMENT compact = {0, 0, 0};
+	MEASUREMENT load_string = {0, 0, 0};
+	MEASUREMENT scan_by_index = {0, 0, 0};
+	MEASUREMENT walk = {0, 0, 0};
+	MEASUREMENT save_string = {0, 0, 0};
+	MEASUREMENT fork = {0, 0, 0};
+	MEASUREMENT destroy = {0, 0, 0};
+	size_t num_nodes = 0;
+	size_t saved_size = 0;
+	bool success = true;
+	double start;
+	
+	for(int iteration = 0; iteration < iterations && success; iteration++)
+	{
+		SLCONFIG_NODE* root = create_root(dir, vtable);
+		size_t base_bytes = cur_bytes;
+		start_measurement(&start);
+		success &= slc_load_nodes(root, slc_from_c_str(filename));
+		end_measurement(start, base_bytes, &load_file);
+		
+		/* Only files loaded by the library are compacted */
+		base_bytes = cur_bytes;
+		start_measurement(&start);
+		slc_compact(root, true);
+		end_measurement(start, base_bytes, &compact);
+		slc_destroy_node(root);
+		
+		root = create_root(dir, vtable);
+		base_bytes = cur_bytes;
+		SLCONFIG_STRING file = {contents, contents + size};
+		start_measurement(&start);
+		success &= slc_load_nodes_string(root, slc_from_c_str(filename), file, false);
+		end_measurement(start, base_bytes, &load_string);
+		base_bytes = cur_bytes;
+		start_measurement(&start);
+		num_nodes = count_nodes(root);
+		end_measurement(start, base_bytes, &scan_by_index);
+		
+		base_bytes = cur_bytes;
+		start_measurement(&start);
+		success &= walk_nodes(root) == num_nodes;
+		end_measurement(start, base_bytes, &walk);
+		
+		base_bytes = cur_bytes;
+		start_measurement(&start);
+		SLCONFIG_STRING saved = slc_save_node_string(root, slc_from_c_str("\n"), slc_from_c_str(indentation));
+		end_measurement(start, base_bytes, &save_string);
+		saved_size = slc_string_length(saved);
+		slc_destroy_string(&saved, vtable->realloc);
+		
+		base_bytes = cur_bytes;
+		start_measurement(&start);
+		SLCONFIG_NODE* forked_root = slc_fork_root(root);
+		end_measurement(start, base_bytes, &fork);
+		slc_destroy_node(forked_root);
+		
+		base_bytes = cur_bytes;
+		start_measurement(&start);
+		slc_destroy_node(root);
+		end_measurement(start, base_bytes, &destroy);
+	}
+	
+	if(success)
+	{
+		report(name, "load_file", &load_file, size, num_nodes);
+		report(name, "compact", &compact, size, num_nodes);
+		report(name, "load_string", &load_string, size, num_nodes);
+		report(name, "scan_by_index", &scan_by_index, size, num_nodes);
+		report(name, "walk", &walk, size, num_nodes);
+		report(name, "save_string", &save_string, saved_size, num_nodes);
+		report(name, "fork", &fork, size, num_nodes);
+		report(name, "destroy", &destroy, size, num_nodes);
+	}
+	else
+	{
+		fprintf(stderr, "Failed to load '%s/%s'.\n", dir, filename);
+	}
+	
+	free(contents);
+	return success;
+}
+
+/* Looks up every child of the wide aggregate, both directly and through references from the root */
+static
+bool run_lookups(const char* dir, int iterations, const SLCONFIG_VTABLE* vtable)
+{
+	SLCONFIG_NODE* root = create_root(dir, vtable);
+	if(!slc_load_nodes(root, slc_from_c_str("wide.cfg")))
+	{
+		slc_destroy_node(root);
+		return false;
+	}
+	
+	SLCONFIG_NODE* wide = slc_get_node(root, slc_from_c_str("wide"));
+	size_t num_children = slc_get_num_children(wide);
+	SLCONFIG_STRING* names = malloc(num_children * sizeof(SLCONFIG_STRING));
+	SLCONFIG_STRING* references = malloc(num_children * sizeof(SLCONFIG_STRING));
+	size_t reference_bytes = 0;
+	for(size_t ii = 0; ii < num_children; ii++)
+	{
+		names[ii] = slc_get_name(slc_get_node_by_index(wide, ii));
+		
+		size_t length = slc_string_length(names[ii]) + 5;
+		char* reference = malloc(length);
+		memcpy(reference, "wide:", 5);
+		memcpy(reference + 5, names[ii].start, length - 5);
+		references[ii].start = reference;
+		references[ii].end = reference + length;
+		reference_bytes += length;
+	}
+	
+	MEASUREMENT get_node = {0, 0, 0};
+	MEASUREMENT get_node_by_reference = {0, 0, 0};
+	bool success = true;
+	double start;
+	for(int iteration = 0; iteration < iterations; iteration++)
+	{
+		start_measurement(&start);
+		for(size_t ii = 0; ii < num_children; ii++)
+			success &= slc_get_node(wide, names[ii]) != NULL;
+		end_measurement(start, cur_bytes, &get_node);
+		
+		start_measurement(&start);
+		for(size_t ii = 0; ii < num_children; ii++)
+			success &= slc_get_node_by_reference(root, references[ii]) != NULL;
+		end_measurement(start, cur_bytes, &get_node_by_reference);
+	}
+	
+	report("wide", "get_node", &get_node, 0, num_children);
+	report("wide", "get_node_by_reference", &get_node_by_reference, reference_bytes, num_children);
+	
+	for(size_t ii = 0; ii < num_children; ii++)
+		free((char*)references[ii].start);
+	free(references);
+	free(names);
+	slc_destroy_node(root);
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage:\n%s <data_directory> [iterations]\n", argv[0]);
+		return -1;
+	}
+	
+	const char* dir = argv[1];
+	int iterations = argc > 2 ? atoi(argv[2]) : 3;
+	if(iterations < 1)
+		iterations = 1;
+	
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.realloc = &counting_realloc;
+	vtable.error = &ignore_error;
+	
+	const CASE cases[] =
+	{
+		{"wide", "\t"},
+		{"deep", "\t"},
+		{"nested", ""},
+		{"expand", "\t"},
+		{"concat", "\t"},
+		{"heredoc", "\t"},
+		{"sentinel", "\t"},
+		{"comments", "\t"},
+		{"include", "\t"},
+	};
+	bool success = true;
+	for(size_t ii = 0; ii < sizeof(cases) / sizeof(cases[0]); ii++)
+		success &= run_case(dir, cases[ii].name, cases[ii].indentation, iterations, &vtable);
+	success &= run_lookups(dir, iterations, &vtable);
+	
+	return success ? 0 : -1;
+}
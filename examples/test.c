@@ -18,7 +18,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 #include "slconfig/slconfig.h"
 
@@ -102,12 +108,1713 @@ bool test_user_data()
 	return ret;
 }
 
+static
+bool test_typed_values()
+{
+	bool ret = true;
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("i = -42; d = 2.5e-3; b = true; s = 12abc; big = 9223372036854775808;"), false);
+	
+	int64_t i;
+	double d;
+	bool b;
+	TEST(slc_get_int64(slc_get_node(root, slc_from_c_str("i")), &i) && i == -42);
+	TEST(slc_get_double(slc_get_node(root, slc_from_c_str("i")), &d) && d == -42.0);
+	TEST(slc_get_double(slc_get_node(root, slc_from_c_str("d")), &d) && d == 2.5e-3);
+	TEST(slc_get_bool(slc_get_node(root, slc_from_c_str("b")), &b) && b);
+	TEST(!slc_get_int64(slc_get_node(root, slc_from_c_str("s")), &i));
+	TEST(!slc_get_double(slc_get_node(root, slc_from_c_str("s")), &d));
+	TEST(!slc_get_bool(slc_get_node(root, slc_from_c_str("s")), &b));
+	TEST(!slc_get_int64(slc_get_node(root, slc_from_c_str("big")), &i));
+	
+	/* The cache must not survive a value change */
+	SLCONFIG_NODE* node = slc_get_node(root, slc_from_c_str("i"));
+	slc_set_value(node, slc_from_c_str("7"), false);
+	TEST(slc_get_int64(node, &i) && i == 7);
+	
+	TEST(slc_set_double(node, 0.1));
+	TEST(slc_string_equal(slc_get_value(node), slc_from_c_str("0.1")));
+	TEST(slc_get_double(node, &d) && d == 0.1);
+	TEST(slc_set_double(node, 1e23));
+	TEST(slc_string_equal(slc_get_value(node), slc_from_c_str("1e+23")));
+	TEST(slc_set_double(node, -0.000123));
+	TEST(slc_string_equal(slc_get_value(node), slc_from_c_str("-0.000123")));
+	TEST(slc_set_double(node, 5e-324));
+	TEST(slc_get_double(node, &d) && d == 5e-324);
+	
+	/* Values the fast path cannot round exactly */
+	slc_set_value(node, slc_from_c_str("9007199254740993"), false);
+	TEST(slc_get_double(node, &d) && d == 9007199254740992.0);
+	slc_set_value(node, slc_from_c_str("2.2250738585072011e-308"), false);
+	TEST(slc_get_double(node, &d) && d == 2.2250738585072011e-308);
+	slc_set_value(node, slc_from_c_str("1e400"), false);
+	TEST(!slc_get_double(node, &d));
+	
+	/* Longer than any fixed digit buffer, just above the halfway point between 1 and the next double */
+	char digits[1024];
+	strcpy(digits, "1.00000000000000011102230246251565404236316680908203125");
+	memset(digits + strlen(digits), '0', 1000 - strlen(digits));
+	strcpy(digits + 1000, "1");
+	slc_set_value(node, slc_from_c_str(digits), false);
+	TEST(slc_get_double(node, &d) && d == 1.0000000000000002);
+	
+	TEST(slc_set_int64(node, INT64_MIN));
+	TEST(slc_string_equal(slc_get_value(node), slc_from_c_str("-9223372036854775808")));
+	TEST(slc_get_int64(node, &i) && i == INT64_MIN);
+	TEST(slc_set_bool(node, false));
+	TEST(slc_get_bool(node, &b) && !b);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+typedef struct
+{
+	int64_t port;
+	double timeout;
+	bool verbose;
+	SLCONFIG_STRING host;
+	int64_t retries;
+} SETTINGS;
+
+static
+void ignore_error(SLCONFIG_STRING s)
+{
+	(void)s;
+}
+
+static
+bool test_binding()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &ignore_error;
+	
+	SLCONFIG_BINDING bindings[] =
+	{
+		{"server:port", SLCONFIG_BIND_INT64, offsetof(SETTINGS, port), NULL},
+		{"server:timeout", SLCONFIG_BIND_DOUBLE, offsetof(SETTINGS, timeout), "1.5"},
+		{"verbose", SLCONFIG_BIND_BOOL, offsetof(SETTINGS, verbose), "false"},
+		{"server:\"host name\"", SLCONFIG_BIND_STRING, offsetof(SETTINGS, host), NULL},
+		{"retries", SLCONFIG_BIND_INT64, offsetof(SETTINGS, retries), "3"},
+	};
+	SLCONFIG_BIND_PLAN* plan = slc_create_bind_plan(bindings, sizeof(bindings) / sizeof(bindings[0]), &vtable);
+	TEST(plan);
+	
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("server { port = 80; \"host name\" = localhost; } verbose = true;"), false);
+	SETTINGS settings;
+	memset(&settings, 0, sizeof(SETTINGS));
+	TEST(slc_bind(root, plan, &settings));
+	TEST(settings.port == 80);
+	TEST(settings.timeout == 1.5);
+	TEST(settings.verbose);
+	TEST(slc_string_equal(settings.host, slc_from_c_str("localhost")));
+	TEST(settings.retries == 3);
+	
+	/* The plan outlives the tree it was used with */
+	slc_destroy_node(root);
+	root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("server { port = eighty; timeout = 2; } retries = 5;"), false);
+	TEST(!slc_bind(root, plan, &settings));
+	TEST(settings.timeout == 2.0);
+	TEST(settings.retries == 5);
+	slc_destroy_node(root);
+	
+	slc_destroy_bind_plan(plan);
+	
+	SLCONFIG_BINDING bad_bindings[] =
+	{
+		{"a", SLCONFIG_BIND_INT64, 0, NULL},
+		{"a:b", SLCONFIG_BIND_INT64, 0, NULL},
+	};
+	TEST(!slc_create_bind_plan(bad_bindings, 2, &vtable));
+	bad_bindings[1].path = "b";
+	bad_bindings[1].default_value = "x";
+	TEST(!slc_create_bind_plan(bad_bindings, 2, &vtable));
+	return ret;
+}
+
+static
+bool test_schema()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &ignore_error;
+	
+	SLCONFIG_NODE* schema_root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(schema_root, slc_from_c_str(""), slc_from_c_str(
+		"aggregate server { required port = port_t; optional timeout = seconds_t; optional host; } "
+		"aggregate plugins { optional \"*\" = server; } "
+		"string port_t = int64; "
+		"string seconds_t = double;"), false);
+	SLCONFIG_SCHEMA* schema = slc_create_schema(schema_root);
+	TEST(schema);
+	
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"server main { port_t port = 80; seconds_t timeout = 1.5; host = localhost; } "
+		"plugins p { server a { port_t port = 1; } }"), false);
+	TEST(slc_validate(schema, root) == 0);
+	slc_destroy_node(root);
+	
+	/* Every violation is reported, not just the first one */
+	root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"server main { port_t port = eighty; extra = 1; } "
+		"server other { seconds_t timeout = 2; } "
+		"plugins p { a = 1; } "
+		"port_t lone { }"), false);
+	TEST(slc_validate(schema, root) == 5);
+	slc_destroy_node(root);
+	
+	slc_destroy_schema(schema);
+	slc_destroy_node(schema_root);
+	
+	schema_root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(schema_root, slc_from_c_str(""), slc_from_c_str("string a = float;"), false);
+	TEST(!slc_create_schema(schema_root));
+	slc_destroy_node(schema_root);
+	return ret;
+}
+
+static
+bool test_full_name()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a { b { c = 1; } }"), false);
+	SLCONFIG_NODE* c = slc_get_node_by_reference(root, slc_from_c_str("a:b:c"));
+	
+	char buf[16];
+	TEST(slc_format_full_name(root, buf, sizeof(buf)) == 1 && strcmp(buf, ":") == 0);
+	TEST(slc_format_full_name(c, NULL, 0) == 7);
+	TEST(slc_format_full_name(c, buf, sizeof(buf)) == 7 && strcmp(buf, "::a:b:c") == 0);
+	/* Truncated, but still terminated */
+	TEST(slc_format_full_name(c, buf, 5) == 7 && strcmp(buf, "::a:") == 0);
+	
+	SLCONFIG_STRING full_name = slc_get_full_name(c);
+	TEST(slc_string_equal(full_name, slc_from_c_str("::a:b:c")));
+	slc_destroy_string(&full_name, NULL);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_bulk_access()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"ints { a = 1; b = -23; c = 123456789012345678; d = 9223372036854775807; e = 12x; } "
+		"mixed { a = 1.5; b { } c = 2; }"), false);
+	SLCONFIG_NODE* ints = slc_get_node(root, slc_from_c_str("ints"));
+	SLCONFIG_NODE* mixed = slc_get_node(root, slc_from_c_str("mixed"));
+	
+	int64_t i[8];
+	TEST(slc_get_int64s(ints, i, 8) == 4);
+	TEST(i[0] == 1 && i[1] == -23 && i[2] == 123456789012345678 && i[3] == INT64_MAX);
+	TEST(slc_get_int64s(ints, i, 2) == 2);
+	
+	double d[8];
+	TEST(slc_get_doubles(ints, d, 8) == 4);
+	TEST(d[1] == -23.0);
+	TEST(slc_get_doubles(mixed, d, 8) == 1 && d[0] == 1.5);
+	
+	SLCONFIG_STRING s[8];
+	TEST(slc_get_values(ints, s, 8) == 5);
+	TEST(slc_string_equal(s[4], slc_from_c_str("12x")));
+	TEST(slc_get_values(mixed, s, 8) == 1);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_load_stats()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	/* The tests may be run from either the root directory or the examples directory */
+	slc_add_search_directory(root, slc_from_c_str("examples"), false);
+	
+	size_t num_stats;
+	TEST(slc_get_load_stats(root, &num_stats) == NULL && num_stats == 0);
+	slc_load_nodes_string(root, slc_from_c_str("untracked"), slc_from_c_str("a = 1;"), false);
+	slc_get_load_stats(root, &num_stats);
+	TEST(num_stats == 0);
+	
+	slc_enable_load_stats(root, true);
+	TEST(slc_load_nodes_string(root, slc_from_c_str("main"), slc_from_c_str(
+		"t { x = 1; y = 2; } "
+		"u { $t; } "
+		"v = $a; "
+		"inc { #include test2.cfg; }"), false));
+	
+	const SLCONFIG_LOAD_STATS* stats = slc_get_load_stats(root, &num_stats);
+	TEST(num_stats == 3);
+	if(num_stats == 3)
+	{
+		TEST(slc_string_equal(stats[0].filename, slc_from_c_str("main")));
+		TEST(stats[0].include_depth == 0);
+		TEST(stats[0].expansions == 2);
+		TEST(stats[0].num_tokens[SLCONFIG_TOKEN_LEFT_BRACE] == 3);
+		TEST(stats[0].num_tokens[SLCONFIG_TOKEN_HASH] == 1);
+		TEST(stats[0].num_tokens[SLCONFIG_TOKEN_EOF] == 1);
+		TEST(stats[0].allocations > 0);
+		
+		TEST(slc_string_equal(stats[1].filename, slc_from_c_str("test2.cfg")));
+		TEST(stats[1].include_depth == 1);
+		TEST(stats[1].bytes_read > 0);
+		TEST(stats[1].nodes_created > 0);
+		
+		TEST(slc_string_equal(stats[2].filename, slc_from_c_str("test3.cfg")));
+		TEST(stats[2].include_depth == 2);
+	}
+	
+	slc_clear_load_stats(root);
+	TEST(slc_get_load_stats(root, &num_stats) == NULL && num_stats == 0);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_deep_nesting()
+{
+	bool ret = true;
+	
+	/* Deep enough to overflow the call stack if anything recursed */
+	const size_t depth = 100000;
+	char* deep = malloc(depth * 3 + 32);
+	char* p = deep;
+	p += sprintf(p, "a");
+	for(size_t ii = 0; ii < depth; ii++)
+		p += sprintf(p, "{b");
+	p += sprintf(p, "=1;");
+	for(size_t ii = 0; ii < depth; ii++)
+		p += sprintf(p, "}");
+	p += sprintf(p, "c{$a;}");
+	
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &ignore_error;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(deep), false));
+	
+	SLCONFIG_NODE* node = slc_get_node(root, slc_from_c_str("c"));
+	size_t found_depth = 0;
+	while(node && slc_get_num_children(node) == 1)
+	{
+		node = slc_get_node_by_index(node, 0);
+		found_depth++;
+	}
+	TEST(found_depth == depth);
+	
+	SLCONFIG_STRING saved = slc_save_node_string(root, slc_from_c_str(""), slc_from_c_str(""));
+	SLCONFIG_NODE* copy = slc_create_root_node(&vtable);
+	TEST(slc_load_nodes_string(copy, slc_from_c_str(""), saved, false));
+	SLCONFIG_STRING resaved = slc_save_node_string(copy, slc_from_c_str(""), slc_from_c_str(""));
+	TEST(slc_string_equal(saved, resaved));
+	slc_destroy_string(&resaved, NULL);
+	slc_destroy_string(&saved, NULL);
+	slc_destroy_node(copy);
+	
+	/* The depth is counted from the root, even when loading into a child */
+	slc_set_max_depth(root, 3);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("d { e { f { } } }"), false));
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("g { h { i { j { } } } }"), false));
+	TEST(!slc_get_node(root, slc_from_c_str("g")));
+	SLCONFIG_NODE* d = slc_get_node(root, slc_from_c_str("d"));
+	TEST(slc_load_nodes_string(d, slc_from_c_str(""), slc_from_c_str("k { l { } }"), false));
+	TEST(!slc_load_nodes_string(d, slc_from_c_str(""), slc_from_c_str("m { n { o { } } }"), false));
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(deep), false));
+	slc_set_max_depth(root, 0);
+	
+	slc_destroy_node(root);
+	free(deep);
+	return ret;
+}
+
+static
+bool test_parse_errors()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &ignore_error;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a = 1;"), false));
+	
+	/* These used to loop forever */
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("p { q = 1;"), false));
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("= 1;"), false));
+	TEST(!slc_get_node(root, slc_from_c_str("p")));
+	
+	/* A failed statement that created a node must only destroy that node */
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("r = 1"), false));
+	TEST(!slc_get_node(root, slc_from_c_str("r")));
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("s = $a;"), false));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(root, slc_from_c_str("s"))), slc_from_c_str("1")));
+	
+	/* Expanded children get their own copies of owned names */
+	char name[] = "owned";
+	SLCONFIG_NODE* t = slc_add_node(root, slc_from_c_str(""), false, slc_from_c_str("t"), false, true);
+	slc_add_node(t, slc_from_c_str(""), false, slc_from_c_str(name), true, false);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("u { $t; }"), false));
+	slc_destroy_node(t);
+	memset(name, 0, sizeof(name));
+	TEST(slc_get_node(slc_get_node(root, slc_from_c_str("u")), slc_from_c_str("owned")) != NULL);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_string_scanning()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"a = ---\"x\"-\"--\"\"---;\n"
+		"b = \"q\\\"r\";\n"
+		"/* one *//* two */ c = 1;\n"
+		"/** doc **/ d = 2; /* outer /* inner */ still outer */\n"
+		"e = 3; /* last */"), false));
+	
+	TEST(slc_string_equal(slc_get_value(slc_get_node(root, slc_from_c_str("a"))), slc_from_c_str("x\"-\"--\"")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(root, slc_from_c_str("b"))), slc_from_c_str("q\"r")));
+	TEST(slc_get_node(root, slc_from_c_str("c")) != NULL);
+	TEST(slc_get_node(root, slc_from_c_str("d")) != NULL);
+	TEST(slc_get_node(root, slc_from_c_str("e")) != NULL);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_dedupe()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"t { a = \"long value\"; \"b\\n\" = 2; } "
+		"u { $t; } v { $t; }\n"
+		"/** doc */ w = \"long value\";"), false);
+	
+	/* The expanded values are copies, the escaped names are owned by the nodes */
+	TEST(slc_dedupe(root) > 0);
+	TEST(slc_dedupe(root) == 0);
+	
+	SLCONFIG_NODE* ua = slc_get_node_by_reference(root, slc_from_c_str("u:a"));
+	SLCONFIG_NODE* va = slc_get_node_by_reference(root, slc_from_c_str("v:a"));
+	TEST(slc_get_value(ua).start == slc_get_value(va).start);
+	
+	slc_set_value(ua, slc_from_c_str("other"), true);
+	TEST(slc_string_equal(slc_get_value(ua), slc_from_c_str("other")));
+	TEST(slc_string_equal(slc_get_value(va), slc_from_c_str("long value")));
+	
+	/* Pooled strings that were replaced everywhere are released by the next dedupe of the root */
+	slc_set_value(va, slc_from_c_str("other"), true);
+	slc_set_value(slc_get_node_by_reference(root, slc_from_c_str("t:a")), slc_from_c_str("other"), true);
+	slc_set_value(slc_get_node(root, slc_from_c_str("w")), slc_from_c_str("other"), true);
+	size_t shared_strings = slc_get_memory_stats(root).shared_strings;
+	TEST(slc_dedupe(root) > 0);
+	TEST(slc_get_memory_stats(root).shared_strings < shared_strings);
+	TEST(slc_string_equal(slc_get_value(ua), slc_from_c_str("other")));
+	TEST(slc_get_value(ua).start == slc_get_value(va).start);
+	
+	/* Appending to a shared comment must not modify it in place */
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("x = 1;\n/** doc */ y = 2;"), false);
+	slc_dedupe(root);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("/** more */ w = 3;"), false);
+	TEST(slc_string_equal(slc_get_comment(slc_get_node(root, slc_from_c_str("w"))), slc_from_c_str(" doc \n more ")));
+	TEST(slc_string_equal(slc_get_comment(slc_get_node(root, slc_from_c_str("y"))), slc_from_c_str(" doc ")));
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+/* Modifying a shared node is refused with an error */
+static size_t num_refusals;
+
+static
+void count_refusal(SLCONFIG_STRING s)
+{
+	(void)s;
+	num_refusals++;
+}
+
+static
+bool store_node(SLCONFIG_NODE* node, void* data)
+{
+	*(SLCONFIG_NODE**)data = node;
+	return false;
+}
+
+static
+bool test_overlay()
+{
+	bool ret = true;
+	
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &count_refusal;
+	SLCONFIG_NODE* base = slc_create_root_node(&vtable);
+	slc_load_nodes_string(base, slc_from_c_str(""), slc_from_c_str("a { x = 1; y = 2; } b = 3; c { d { e = 4; } } n = 5;"), false);
+	SLCONFIG_NODE* n = slc_get_node(base, slc_from_c_str("n"));
+	
+	SLCONFIG_NODE* first = slc_create_overlay_root(base, NULL);
+	SLCONFIG_NODE* second = slc_create_overlay_root(base, NULL);
+	TEST(slc_load_nodes_string(first, slc_from_c_str(""), slc_from_c_str("a:x = 10; ~b; c { f = 6; } g = $n;"), false));
+	TEST(slc_load_nodes_string(second, slc_from_c_str(""), slc_from_c_str("a { z = 7; } n = 8; h { $a; }"), false));
+	
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(first, slc_from_c_str("a:x"))), slc_from_c_str("10")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(first, slc_from_c_str("a:y"))), slc_from_c_str("2")));
+	TEST(slc_get_node(first, slc_from_c_str("b")) == NULL);
+	TEST(slc_get_node_by_reference(first, slc_from_c_str("c:d")) == NULL);
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(first, slc_from_c_str("c:f"))), slc_from_c_str("6")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(first, slc_from_c_str("g"))), slc_from_c_str("5")));
+	
+	TEST(slc_get_num_children(slc_get_node(second, slc_from_c_str("a"))) == 1);
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(second, slc_from_c_str("h:z"))), slc_from_c_str("7")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(second, slc_from_c_str("b"))), slc_from_c_str("3")));
+	
+	/* Reading an overlay copies nothing, and hands out the read only nodes of the base */
+	size_t memory = slc_get_memory_stats(second).total;
+	SLCONFIG_NODE* e = slc_get_node_by_reference(second, slc_from_c_str("c:d:e"));
+	TEST(e == slc_get_node_by_reference(base, slc_from_c_str("c:d:e")));
+	for(size_t ii = 0; ii < slc_get_num_children(second); ii++)
+		slc_get_node_by_index(second, ii);
+	TEST(slc_get_memory_stats(second).total == memory);
+	num_refusals = 0;
+	TEST(!slc_set_int64(e, 41));
+	TEST(num_refusals == 1);
+	
+	/* Adding an existing node, and slc_get_writable_node, give back one that the overlay owns */
+	SLCONFIG_NODE* b = slc_add_node(second, slc_from_c_str(""), false, slc_from_c_str("b"), false, false);
+	TEST(b != slc_get_node(base, slc_from_c_str("b")));
+	TEST(slc_get_node(second, slc_from_c_str("b")) == b);
+	TEST(slc_set_int64(b, 30));
+	TEST(slc_set_int64(slc_get_writable_node(second, slc_from_c_str("c:d:e")), 40));
+	TEST(slc_get_writable_node(e, slc_from_c_str("e")) == NULL);
+	
+	/* Removing a node through an overlay only hides it there */
+	slc_destroy_node(slc_get_writable_node(second, slc_from_c_str("a")));
+	TEST(slc_get_node(second, slc_from_c_str("a")) == NULL);
+	TEST(slc_get_node(first, slc_from_c_str("a")) != NULL);
+	
+	/* The nodes of the base are shared with the overlays, and read only */
+	TEST(!slc_set_int64(n, 50));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(second, slc_from_c_str("n"))), slc_from_c_str("8")));
+	
+	/* Overlays stack */
+	SLCONFIG_NODE* third = slc_create_overlay_root(first, NULL);
+	TEST(slc_load_nodes_string(third, slc_from_c_str(""), slc_from_c_str("a:y = 20;"), false));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(third, slc_from_c_str("a:x"))), slc_from_c_str("10")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(third, slc_from_c_str("a:y"))), slc_from_c_str("20")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(first, slc_from_c_str("a:y"))), slc_from_c_str("2")));
+	
+	slc_dedupe(first);
+	slc_dedupe(third);
+	
+	/* The base is untouched */
+	SLCONFIG_STRING saved = slc_save_node_string(base, slc_from_c_str(" "), slc_from_c_str(""));
+	TEST(slc_string_equal(saved, slc_from_c_str("a { x = 1; y = 2; } b = 3; c { d { e = 4; } } n = 5; ")));
+	slc_destroy_string(&saved, NULL);
+	
+	/* Changing or destroying the base does not affect the overlays */
+	TEST(slc_load_nodes_string(base, slc_from_c_str(""), slc_from_c_str("a:y = 9; ~c;"), false));
+	slc_destroy_node(slc_get_writable_node(base, slc_from_c_str("b")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(first, slc_from_c_str("a:y"))), slc_from_c_str("2")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(second, slc_from_c_str("c:d:e"))), slc_from_c_str("40")));
+	slc_destroy_node(base);
+	slc_destroy_node(first);
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(third, slc_from_c_str("a:x"))), slc_from_c_str("10")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(second, slc_from_c_str("b"))), slc_from_c_str("30")));
+	
+	slc_destroy_node(third);
+	slc_destroy_node(second);
+	return ret;
+}
+
+static
+bool test_fork()
+{
+	bool ret = true;
+	
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &count_refusal;
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a { x = 1; y = 2; } b = 3;\n/** doc */ c = 4;"), true);
+	SLCONFIG_NODE* b = slc_get_node(root, slc_from_c_str("b"));
+	
+	SLCONFIG_NODE* fork = slc_fork_root(root);
+	TEST(slc_get_node(fork, slc_from_c_str("b")) == b);
+	
+	/* The iterators and queries hand out the same read only nodes as the lookups */
+	SLCONFIG_ITER iter;
+	slc_iter_begin(&iter, fork);
+	while(slc_iter_next(&iter) && !slc_string_equal(iter.name, slc_from_c_str("b")))
+		;
+	TEST(iter.node == b);
+	SLCONFIG_NODE* match = NULL;
+	SLCONFIG_QUERY* query = slc_query_compile(slc_from_c_str("b"), NULL);
+	slc_query_exec(query, fork, &store_node, &match);
+	slc_destroy_query(query);
+	TEST(match == b);
+	num_refusals = 0;
+	TEST(!slc_set_int64(match, 31));
+	TEST(num_refusals == 1);
+	TEST(slc_set_int64(slc_get_writable_node(fork, iter.name), 31));
+	TEST(slc_string_equal(slc_get_value(b), slc_from_c_str("3")));
+	
+	/* The nodes from before the fork are shared from then on, and read only */
+	TEST(!slc_set_int64(b, 31));
+	TEST(!slc_set_comment(b, slc_from_c_str(" b "), false));
+	TEST(slc_string_equal(slc_get_value(b), slc_from_c_str("3")));
+	
+	/* Both sides copy the shared nodes before modifying them */
+	TEST(slc_load_nodes_string(fork, slc_from_c_str(""), slc_from_c_str("a:x = 10; ~c;"), false));
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a:y = 20; d = 5;"), false));
+	SLCONFIG_NODE* fork_b = slc_add_node(fork, slc_from_c_str(""), false, slc_from_c_str("b"), false, false);
+	TEST(fork_b != b);
+	TEST(slc_string_equal(slc_get_value(fork_b), slc_from_c_str("31")));
+	slc_set_int64(fork_b, 30);
+	
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(root, slc_from_c_str("a:x"))), slc_from_c_str("1")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(root, slc_from_c_str("a:y"))), slc_from_c_str("20")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(root, slc_from_c_str("b"))), slc_from_c_str("3")));
+	TEST(slc_get_node(root, slc_from_c_str("c")) != NULL);
+	
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(fork, slc_from_c_str("a:x"))), slc_from_c_str("10")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(fork, slc_from_c_str("a:y"))), slc_from_c_str("2")));
+	TEST(slc_get_node(fork, slc_from_c_str("c")) == NULL);
+	TEST(slc_get_node(fork, slc_from_c_str("d")) == NULL);
+	
+	/* Writable nodes belong to the tree they are looked up in */
+	uint64_t root_gen = slc_get_generation(root);
+	TEST(!slc_set_int64(slc_get_node_by_reference(fork, slc_from_c_str("a:y")), 99));
+	SLCONFIG_NODE* fork_y = slc_get_writable_node(fork, slc_from_c_str("a:y"));
+	TEST(slc_set_int64(fork_y, 99));
+	TEST(slc_get_generation(fork) == slc_get_generation(fork_y));
+	TEST(slc_get_generation(root) == root_gen);
+	slc_destroy_node(slc_get_node(fork, slc_from_c_str("b")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(root, slc_from_c_str("a:y"))), slc_from_c_str("20")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(root, slc_from_c_str("b"))), slc_from_c_str("3")));
+	
+	/* Forks of forks, and forks that outlive the original */
+	SLCONFIG_NODE* second = slc_fork_root(fork);
+	SLCONFIG_NODE* third = slc_fork_root(root);
+	slc_destroy_node(root);
+	slc_destroy_node(fork);
+	
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(second, slc_from_c_str("a:x"))), slc_from_c_str("10")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(second, slc_from_c_str("a:y"))), slc_from_c_str("99")));
+	TEST(slc_get_node(second, slc_from_c_str("b")) == NULL);
+	TEST(slc_string_equal(slc_get_comment(slc_get_node(third, slc_from_c_str("c"))), slc_from_c_str(" doc ")));
+	TEST(slc_load_nodes_string(third, slc_from_c_str(""), slc_from_c_str("/** more */ c = 6;"), false));
+	TEST(slc_string_equal(slc_get_comment(slc_get_node(third, slc_from_c_str("c"))), slc_from_c_str(" doc \n more ")));
+	
+	slc_destroy_node(third);
+	slc_destroy_node(second);
+	return ret;
+}
+
+/* Files served from memory, so that their contents can change between loads */
+static const char* base_file_contents;
+
+typedef struct
+{
+	const char* data;
+	size_t pos;
+	size_t size;
+} MEMORY_FILE;
+
+static
+void* memory_fopen(SLCONFIG_STRING filename, bool read)
+{
+	const char* data;
+	if(!read)
+		return NULL;
+	else if(slc_string_equal(filename, slc_from_c_str("base.cfg")))
+		data = base_file_contents;
+	else if(slc_string_equal(filename, slc_from_c_str("inc.cfg")))
+		data = "b = 2;";
+	else
+		return NULL;
+	
+	MEMORY_FILE* f = malloc(sizeof(MEMORY_FILE));
+	f->data = data;
+	f->pos = 0;
+	f->size = strlen(data);
+	return f;
+}
+
+static
+int memory_fclose(void* f)
+{
+	free(f);
+	return 0;
+}
+
+static
+size_t memory_fread(void* buf, size_t size, void* file)
+{
+	MEMORY_FILE* f = file;
+	if(size > f->size - f->pos)
+		size = f->size - f->pos;
+	memcpy(buf, f->data + f->pos, size);
+	f->pos += size;
+	return size;
+}
+
+static
+bool test_file_cache()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.fopen = &memory_fopen;
+	vtable.fclose = &memory_fclose;
+	vtable.fread = &memory_fread;
+	base_file_contents = "a = 1;\n#include inc.cfg;";
+	
+	SLCONFIG_FILE_CACHE* cache = slc_create_file_cache(NULL);
+	SLCONFIG_NODE* first = slc_create_root_node(&vtable);
+	SLCONFIG_NODE* second = slc_create_root_node(&vtable);
+	slc_set_file_cache(first, cache);
+	slc_set_file_cache(second, cache);
+	
+	TEST(slc_load_nodes(first, slc_from_c_str("base.cfg")));
+	TEST(slc_load_nodes(second, slc_from_c_str("base.cfg")));
+	TEST(slc_get_num_cached_files(cache) == 2);
+	
+	/* The names point into the same buffer */
+	SLCONFIG_NODE* first_b = slc_get_node(first, slc_from_c_str("b"));
+	SLCONFIG_NODE* second_b = slc_get_node(second, slc_from_c_str("b"));
+	TEST(first_b && second_b && slc_get_name(first_b).start == slc_get_name(second_b).start);
+	
+	slc_destroy_node(first);
+	TEST(slc_get_num_cached_files(cache) == 2);
+	TEST(slc_string_equal(slc_get_name(second_b), slc_from_c_str("b")));
+	
+	/* A file that changed gets its own entry */
+	base_file_contents = "a = 3;";
+	SLCONFIG_NODE* third = slc_create_root_node(&vtable);
+	slc_set_file_cache(third, cache);
+	TEST(slc_load_nodes(third, slc_from_c_str("base.cfg")));
+	TEST(slc_load_nodes_string(third, slc_from_c_str("string.cfg"), slc_from_c_str("c = 4;"), true));
+	TEST(slc_get_num_cached_files(cache) == 4);
+	
+	slc_destroy_node(second);
+	TEST(slc_get_num_cached_files(cache) == 2);
+	
+	/* Enough files to grow the tables, each loaded twice and released out of order */
+	SLCONFIG_NODE* roots[40];
+	char file[32];
+	for(size_t ii = 0; ii < 40; ii++)
+	{
+		snprintf(file, sizeof(file), "v%d = 1;", (int)(ii % 20));
+		roots[ii] = slc_create_root_node(NULL);
+		slc_set_file_cache(roots[ii], cache);
+		TEST(slc_load_nodes_string(roots[ii], slc_from_c_str("many.cfg"), slc_from_c_str(file), true));
+	}
+	TEST(slc_get_num_cached_files(cache) == 22);
+	TEST(slc_get_name(slc_get_node_by_index(roots[3], 0)).start == slc_get_name(slc_get_node_by_index(roots[23], 0)).start);
+	for(size_t ii = 0; ii < 40; ii += 3)
+		slc_destroy_node(roots[ii]);
+	TEST(slc_get_num_cached_files(cache) == 22);
+	for(size_t ii = 0; ii < 40; ii++)
+	{
+		if(ii % 3)
+			slc_destroy_node(roots[ii]);
+	}
+	TEST(slc_get_num_cached_files(cache) == 2);
+	
+	/* The roots keep the cache alive */
+	slc_destroy_file_cache(cache);
+	TEST(slc_string_equal(slc_get_value(slc_get_node(third, slc_from_c_str("a"))), slc_from_c_str("3")));
+	slc_destroy_node(third);
+	return ret;
+}
+
+static
+bool test_compact()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"/* A comment that is not kept */\n"
+		"type a { x = 1; y = 2; }\n"
+		"/** Kept */\n"
+		"type b { x = 3; }                              "), true);
+	
+	TEST(slc_compact(root, true) > 0);
+	SLCONFIG_NODE* ax = slc_get_node_by_reference(root, slc_from_c_str("a:x"));
+	SLCONFIG_NODE* bx = slc_get_node_by_reference(root, slc_from_c_str("b:x"));
+	SLCONFIG_NODE* b = slc_get_node(root, slc_from_c_str("b"));
+	TEST(slc_string_equal(slc_get_name(ax), slc_from_c_str("x")));
+	TEST(slc_get_name(ax).start == slc_get_name(bx).start);
+	TEST(slc_string_equal(slc_get_type(b), slc_from_c_str("type")));
+	TEST(slc_string_equal(slc_get_comment(b), slc_from_c_str(" Kept ")));
+	TEST(slc_string_equal(slc_get_value(bx), slc_from_c_str("3")));
+	
+	/* The pool is compacted again along with newly loaded files */
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("c = 4;\n~a;"), true);
+	TEST(slc_compact(root, false) > 0);
+	TEST(slc_string_equal(slc_get_name(slc_get_node(root, slc_from_c_str("c"))), slc_from_c_str("c")));
+	TEST(slc_string_equal(slc_get_name(bx), slc_from_c_str("x")));
+	
+	/* Nothing is done while an overlay shares the nodes */
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("d { e = 6; }"), true);
+	SLCONFIG_NODE* overlay = slc_create_overlay_root(root, NULL);
+	TEST(slc_compact(root, true) == 0);
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(overlay, slc_from_c_str("d:e"))), slc_from_c_str("6")));
+	slc_destroy_node(overlay);
+	TEST(slc_compact(root, true) > 0);
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(root, slc_from_c_str("d:e"))), slc_from_c_str("6")));
+	slc_destroy_node(root);
+	
+	/* Strings that are not copied belong to the caller */
+	const char* file = "d = 5;";
+	root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(file), false);
+	TEST(slc_compact(root, true) == 0);
+	TEST(slc_get_name(slc_get_node(root, slc_from_c_str("d"))).start == file);
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_memory_stats()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a { x = 1; y = 22; }\nb { $a; }"), true);
+	
+	SLCONFIG_MEMORY_STATS stats = slc_get_memory_stats(root);
+	TEST(stats.files == strlen("a { x = 1; y = 22; }\nb { $a; }"));
+	/* The values are copies, while the names point into the file */
+	TEST(stats.values == 6);
+	TEST(stats.names == 0);
+	TEST(stats.children == 6 * sizeof(SLCONFIG_NODE*));
+	TEST(stats.total == stats.nodes + stats.children + stats.types + stats.names + stats.values + stats.comments
+	                    + stats.files + stats.shared_strings + stats.bookkeeping);
+	
+	SLCONFIG_MEMORY_STATS b_stats = slc_get_node_memory_stats(slc_get_node(root, slc_from_c_str("b")));
+	TEST(b_stats.nodes * 7 == stats.nodes * 3);
+	TEST(b_stats.values == 3);
+	TEST(b_stats.files == 0);
+	
+	slc_compact(root, false);
+	TEST(slc_get_memory_stats(root).files < stats.files);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+/* The diagnostics of the last load, their strings point into a buffer that is reused so they are copied */
+typedef struct
+{
+	SLCONFIG_SEVERITY severity;
+	SLCONFIG_ERROR_CODE code;
+	size_t line;
+	char filename[32];
+	char node_path[32];
+	char include_file[32];
+	size_t include_line;
+	size_t num_includes;
+} DIAGNOSTIC_COPY;
+
+static DIAGNOSTIC_COPY diagnostics[16];
+static size_t num_diagnostics;
+static size_t num_error_calls;
+static bool error_prefix_ok;
+
+static
+void copy_c_str(char* dest, SLCONFIG_STRING str)
+{
+	size_t length = slc_string_length(str);
+	if(length > 31)
+		length = 31;
+	if(length)
+		memcpy(dest, str.start, length);
+	dest[length] = '\0';
+}
+
+static
+void collect_diagnostic(const SLCONFIG_DIAGNOSTIC* diagnostic)
+{
+	if(num_diagnostics == sizeof(diagnostics) / sizeof(diagnostics[0]))
+		return;
+	DIAGNOSTIC_COPY* copy = &diagnostics[num_diagnostics++];
+	copy->severity = diagnostic->severity;
+	copy->code = diagnostic->code;
+	copy->line = diagnostic->line;
+	copy->num_includes = diagnostic->num_includes;
+	copy_c_str(copy->filename, diagnostic->filename);
+	copy_c_str(copy->node_path, diagnostic->node_path);
+	copy_c_str(copy->include_file, diagnostic->num_includes ? diagnostic->include_files[0] : slc_from_c_str(""));
+	copy->include_line = diagnostic->num_includes ? diagnostic->include_lines[0] : 0;
+}
+
+static
+void count_error(SLCONFIG_STRING s)
+{
+	if(num_error_calls == 0)
+		error_prefix_ok = slc_string_length(s) > 18 && memcmp(s.start, "test.cfg:2: Error:", 18) == 0;
+	num_error_calls++;
+}
+
+static
+bool test_diagnostics()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.fopen = &memory_fopen;
+	vtable.fclose = &memory_fclose;
+	vtable.fread = &memory_fread;
+	vtable.diagnostic = &collect_diagnostic;
+	
+	const char* file = "a = 1;\nb = $missing;\nc { d = 2 }\na { }\ne = 3;\n}\nf = 4;";
+	
+	/* Every error is collected in one pass */
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	slc_set_max_errors(root, 0);
+	num_diagnostics = 0;
+	TEST(!slc_load_nodes_string(root, slc_from_c_str("test.cfg"), slc_from_c_str(file), false));
+	TEST(num_diagnostics == 4);
+	TEST(diagnostics[0].code == SLCONFIG_ERROR_DOES_NOT_EXIST && diagnostics[0].line == 2);
+	TEST(strcmp(diagnostics[0].node_path, "::missing") == 0);
+	TEST(strcmp(diagnostics[0].filename, "test.cfg") == 0);
+	TEST(diagnostics[1].code == SLCONFIG_ERROR_UNEXPECTED_TOKEN && diagnostics[1].line == 3);
+	TEST(diagnostics[2].code == SLCONFIG_ERROR_NOT_AGGREGATE && diagnostics[2].line == 4);
+	TEST(strcmp(diagnostics[2].node_path, "::a") == 0);
+	TEST(diagnostics[3].code == SLCONFIG_ERROR_UNPAIRED_BRACE && diagnostics[3].line == 6);
+	TEST(diagnostics[0].severity == SLCONFIG_SEVERITY_ERROR && diagnostics[0].num_includes == 0);
+	/* The statements after the errors are still parsed */
+	TEST(slc_get_node(root, slc_from_c_str("c")));
+	TEST(slc_get_node(root, slc_from_c_str("e")));
+	TEST(slc_get_node(root, slc_from_c_str("f")));
+	slc_destroy_node(root);
+	
+	/* By default, parsing stops at the first error */
+	root = slc_create_root_node(&vtable);
+	num_diagnostics = 0;
+	TEST(!slc_load_nodes_string(root, slc_from_c_str("test.cfg"), slc_from_c_str(file), false));
+	TEST(num_diagnostics == 1);
+	TEST(!slc_get_node(root, slc_from_c_str("e")));
+	slc_destroy_node(root);
+	
+	/* Errors in an included file carry the include chain, and the including file goes on after them */
+	base_file_contents = "x = 1;\ny = $nope;";
+	root = slc_create_root_node(&vtable);
+	slc_set_max_errors(root, 0);
+	num_diagnostics = 0;
+	TEST(!slc_load_nodes_string(root, slc_from_c_str("main.cfg"), slc_from_c_str("a = 1;\n#include base.cfg;\n#include none.cfg;\nz = 2;"), false));
+	TEST(num_diagnostics == 2);
+	TEST(strcmp(diagnostics[0].filename, "base.cfg") == 0 && diagnostics[0].line == 2);
+	TEST(diagnostics[0].num_includes == 1);
+	TEST(strcmp(diagnostics[0].include_file, "main.cfg") == 0 && diagnostics[0].include_line == 2);
+	TEST(diagnostics[1].code == SLCONFIG_ERROR_MISSING_FILE && diagnostics[1].line == 3);
+	TEST(diagnostics[1].num_includes == 0);
+	TEST(slc_get_node(root, slc_from_c_str("x")));
+	TEST(slc_get_node(root, slc_from_c_str("z")));
+	slc_destroy_node(root);
+	
+	/* Warnings do not fail the load */
+	root = slc_create_root_node(&vtable);
+	num_diagnostics = 0;
+	TEST(slc_load_nodes_string(root, slc_from_c_str("test.cfg"), slc_from_c_str("a { } b = $a;"), false));
+	TEST(num_diagnostics == 1);
+	TEST(diagnostics[0].severity == SLCONFIG_SEVERITY_WARNING && diagnostics[0].code == SLCONFIG_ERROR_IS_AGGREGATE);
+	slc_destroy_node(root);
+	
+	/* Without a diagnostic callback, each error is reported to the error callback in one piece */
+	vtable.diagnostic = NULL;
+	vtable.error = &count_error;
+	root = slc_create_root_node(&vtable);
+	slc_set_max_errors(root, 0);
+	num_error_calls = 0;
+	TEST(!slc_load_nodes_string(root, slc_from_c_str("test.cfg"), slc_from_c_str(file), false));
+	TEST(num_error_calls == 4);
+	TEST(error_prefix_ok);
+	slc_destroy_node(root);
+	return ret;
+}
+
+/* Output of the writer, collected in memory */
+static char written[262144];
+static size_t written_size;
+static size_t num_writes;
+
+static
+void* capture_fopen(SLCONFIG_STRING filename, bool read)
+{
+	(void)filename;
+	if(read)
+		return NULL;
+	written_size = 0;
+	num_writes = 0;
+	return written;
+}
+
+static
+int capture_fclose(void* f)
+{
+	(void)f;
+	return 0;
+}
+
+static
+size_t capture_fwrite(const void* buf, size_t size, void* f)
+{
+	(void)f;
+	if(size > sizeof(written) - written_size)
+		size = sizeof(written) - written_size;
+	memcpy(written + written_size, buf, size);
+	written_size += size;
+	num_writes++;
+	return size;
+}
+
+static
+bool test_writer()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.fopen = &capture_fopen;
+	vtable.fclose = &capture_fclose;
+	vtable.fwrite = &capture_fwrite;
+	
+	SLCONFIG_WRITER* writer = slc_create_writer(slc_from_c_str("out.cfg"), slc_from_c_str("\n"), slc_from_c_str("\t"), &vtable);
+	TEST(writer);
+	TEST(slc_writer_comment(writer, slc_from_c_str(" doc ")));
+	TEST(slc_writer_string_node(writer, slc_from_c_str(""), slc_from_c_str("a"), slc_from_c_str("1")));
+	TEST(slc_writer_begin_aggregate(writer, slc_from_c_str("t"), slc_from_c_str("b")));
+	TEST(slc_writer_string_node(writer, slc_from_c_str(""), slc_from_c_str("c"), slc_from_c_str("x y")));
+	TEST(slc_writer_begin_aggregate(writer, slc_from_c_str(""), slc_from_c_str("e")));
+	TEST(slc_writer_end_aggregate(writer));
+	TEST(slc_writer_begin_aggregate(writer, slc_from_c_str(""), slc_from_c_str("f")));
+	TEST(slc_writer_string_node(writer, slc_from_c_str(""), slc_from_c_str("g"), slc_from_c_str("")));
+	/* Aggregates left open are closed when the writer is destroyed */
+	TEST(slc_destroy_writer(writer));
+	
+	const char* expected = "/** doc */\na = 1;\nt b\n{\n\tc = -\"x y\"-;\n\te {}\n\tf\n\t{\n\t\tg;\n\t}\n}\n";
+	TEST(written_size == strlen(expected) && memcmp(written, expected, written_size) == 0);
+	/* The output is the same as saving the tree it describes */
+	SLCONFIG_STRING output = {written, written + written_size};
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	TEST(slc_load_nodes_string(root, slc_from_c_str("out.cfg"), output, true));
+	SLCONFIG_STRING saved = slc_save_node_string(root, slc_from_c_str("\n"), slc_from_c_str("\t"));
+	TEST(slc_string_equal(saved, output));
+	slc_destroy_string(&saved, NULL);
+	slc_destroy_node(root);
+	
+	/* Small nodes are buffered into a few large writes */
+	writer = slc_create_writer(slc_from_c_str("out.cfg"), slc_from_c_str("\n"), slc_from_c_str(""), &vtable);
+	for(size_t ii = 0; ii < 1000; ii++)
+		slc_writer_string_node(writer, slc_from_c_str(""), slc_from_c_str("node"), slc_from_c_str("value"));
+	TEST(slc_destroy_writer(writer));
+	TEST(written_size == 1000 * strlen("node = value;\n"));
+	TEST(num_writes < 10);
+	return ret;
+}
+
+static
+bool test_compact_saving()
+{
+	bool ret = true;
+	
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("/** doc */ a = 1;\nt b\n{\n\tc = \"x y\";\n\te {}\n\tf { g; }\n}"), false);
+	SLCONFIG_STRING compact = slc_save_node_compact_string(root, false);
+	TEST(slc_string_equal(compact, slc_from_c_str("a=1;t b{c=-\"x y\"-;e{}f{g;}}")));
+	
+	/* The same tree built in a different order has the same canonical form and hash */
+	SLCONFIG_NODE* other = slc_create_root_node(NULL);
+	slc_load_nodes_string(other, slc_from_c_str(""), slc_from_c_str("t b { f { g; } e {} c = -\"x y\"-; } a = 1;"), false);
+	SLCONFIG_STRING canonical = slc_save_node_compact_string(root, true);
+	SLCONFIG_STRING other_canonical = slc_save_node_compact_string(other, true);
+	TEST(slc_string_equal(canonical, slc_from_c_str("a=1;t b{c=-\"x y\"-;e{}f{g;}}")));
+	TEST(slc_string_equal(canonical, other_canonical));
+	TEST(slc_hash_node(root) == slc_hash_node(other));
+	
+	slc_set_value(slc_get_node_by_reference(other, slc_from_c_str("b:c")), slc_from_c_str("x z"), false);
+	TEST(slc_hash_node(root) != slc_hash_node(other));
+	TEST(slc_hash_node(slc_get_node(root, slc_from_c_str("a"))) == slc_hash_node(slc_get_node(other, slc_from_c_str("a"))));
+	
+	slc_destroy_string(&compact, NULL);
+	slc_destroy_string(&canonical, NULL);
+	slc_destroy_string(&other_canonical, NULL);
+	slc_destroy_node(other);
+	slc_destroy_node(root);
+	
+	/* Strings that would read back differently are quoted */
+	root = slc_create_root_node(NULL);
+	slc_add_node(root, slc_from_c_str(""), false, slc_from_c_str(""), false, false);
+	slc_set_value(slc_add_node(root, slc_from_c_str(""), false, slc_from_c_str("c"), false, false), slc_from_c_str("/*x"), false);
+	compact = slc_save_node_compact_string(root, true);
+	TEST(slc_string_equal(compact, slc_from_c_str("-\"\"-;c=-\"/*x\"-;")));
+	other = slc_create_root_node(NULL);
+	TEST(slc_load_nodes_string(other, slc_from_c_str(""), compact, false));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(other, slc_from_c_str("c"))), slc_from_c_str("/*x")));
+	TEST(slc_get_node(other, slc_from_c_str("")));
+	TEST(slc_hash_node(root) == slc_hash_node(other));
+	slc_destroy_node(other);
+	slc_destroy_string(&compact, NULL);
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_parallel_saving()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.fopen = &capture_fopen;
+	vtable.fclose = &capture_fclose;
+	vtable.fwrite = &capture_fwrite;
+	
+	/* Large aggregates next to small ones, so that some get split and some do not */
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("/** doc */ a = 1; e {} t f { g = -\"x y\"-; }"), false);
+	char name[32];
+	for(size_t ii = 0; ii < 4; ii++)
+	{
+		snprintf(name, sizeof(name), "big%zu", ii);
+		SLCONFIG_NODE* big = slc_add_node(root, slc_from_c_str("t"), false, slc_from_c_str(name), true, true);
+		slc_set_comment(big, slc_from_c_str(" big "), false);
+		for(size_t jj = 0; jj < 40; jj++)
+		{
+			snprintf(name, sizeof(name), "agg%zu", jj);
+			SLCONFIG_NODE* agg = slc_add_node(big, slc_from_c_str(""), false, slc_from_c_str(name), true, true);
+			for(size_t kk = 0; kk < 40; kk++)
+			{
+				snprintf(name, sizeof(name), "leaf%zu", kk);
+				slc_set_value(slc_add_node(agg, slc_from_c_str(""), false, slc_from_c_str(name), true, false), slc_from_c_str("value"), false);
+			}
+		}
+		slc_add_node(big, slc_from_c_str(""), false, slc_from_c_str("empty"), false, true);
+	}
+	
+	SLCONFIG_STRING serial = slc_save_node_string(root, slc_from_c_str("\n"), slc_from_c_str("\t"));
+	size_t thread_counts[] = {0, 1, 3, 8};
+	for(size_t ii = 0; ii < sizeof(thread_counts) / sizeof(size_t); ii++)
+	{
+		SLCONFIG_STRING parallel = slc_save_node_string_parallel(root, slc_from_c_str("\n"), slc_from_c_str("\t"), thread_counts[ii]);
+		TEST(slc_string_equal(serial, parallel));
+		slc_destroy_string(&parallel, NULL);
+	}
+	
+	TEST(slc_save_node_parallel(root, slc_from_c_str("out.cfg"), slc_from_c_str("\n"), slc_from_c_str("\t"), 4));
+	SLCONFIG_STRING output = {written, written + written_size};
+	TEST(slc_string_equal(serial, output));
+	slc_destroy_string(&serial, NULL);
+	
+	/* Aggregates other than the root keep their header and braces */
+	SLCONFIG_NODE* big = slc_get_node(root, slc_from_c_str("big1"));
+	serial = slc_save_node_string(big, slc_from_c_str("\n"), slc_from_c_str("  "));
+	SLCONFIG_STRING parallel = slc_save_node_string_parallel(big, slc_from_c_str("\n"), slc_from_c_str("  "), 4);
+	TEST(slc_string_equal(serial, parallel));
+	slc_destroy_string(&serial, NULL);
+	slc_destroy_string(&parallel, NULL);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_load_many()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.fopen = &memory_fopen;
+	vtable.fclose = &memory_fclose;
+	vtable.fread = &memory_fread;
+	vtable.error = &ignore_error;
+	base_file_contents = "a = 1;\n#include inc.cfg;";
+	
+	SLCONFIG_NODE* roots[64];
+	SLCONFIG_STRING filenames[64];
+	for(size_t ii = 0; ii < 64; ii++)
+	{
+		roots[ii] = slc_create_root_node(&vtable);
+		filenames[ii] = slc_from_c_str("base.cfg");
+	}
+	
+	SLCONFIG_FILE_CACHE* cache = slc_create_file_cache(NULL);
+	TEST(slc_load_many(roots, filenames, 64, 4, cache, true));
+	TEST(slc_get_num_cached_files(cache) == 2);
+	SLCONFIG_STRING first_b = slc_get_name(slc_get_node(roots[0], slc_from_c_str("b")));
+	for(size_t ii = 0; ii < 64; ii++)
+	{
+		TEST(slc_string_equal(slc_get_value(slc_get_node(roots[ii], slc_from_c_str("a"))), slc_from_c_str("1")));
+		TEST(slc_get_name(slc_get_node(roots[ii], slc_from_c_str("b"))).start == first_b.start);
+	}
+	
+	/* Every root holds on to its files until it is destroyed */
+	for(size_t ii = 0; ii < 64; ii++)
+		slc_destroy_node(roots[ii]);
+	TEST(slc_get_num_cached_files(cache) == 0);
+	slc_destroy_file_cache(cache);
+	
+	/* A file that fails to load does not stop the others */
+	for(size_t ii = 0; ii < 8; ii++)
+	{
+		roots[ii] = slc_create_root_node(&vtable);
+		filenames[ii] = slc_from_c_str(ii == 3 ? "missing.cfg" : "inc.cfg");
+	}
+	TEST(!slc_load_many(roots, filenames, 8, 0, NULL, false));
+	for(size_t ii = 0; ii < 8; ii++)
+	{
+		TEST((slc_get_node(roots[ii], slc_from_c_str("b")) == NULL) == (ii == 3));
+		slc_destroy_node(roots[ii]);
+	}
+	return ret;
+}
+
+#ifndef _WIN32
+#define NUM_CONCURRENT_READS (2000)
+
+typedef struct
+{
+	SLCONFIG_NODE* root;
+	bool success;
+} CONCURRENT_READER;
+
+static
+void* concurrent_read(void* arg)
+{
+	CONCURRENT_READER* reader = arg;
+	SLCONFIG_NODE* counter = slc_get_node(reader->root, slc_from_c_str("counter"));
+	SLCONFIG_NODE* aggr = slc_get_node(reader->root, slc_from_c_str("aggr"));
+	int64_t last = -1;
+	for(size_t ii = 0; ii < NUM_CONCURRENT_READS; ii++)
+	{
+		/* The writer only increments the counter */
+		int64_t value;
+		if(!slc_get_int64(counter, &value) || value < last)
+			reader->success = false;
+		last = value;
+		
+		/* Children may disappear between the calls, but the returned ones stay readable */
+		size_t num_children = slc_get_num_children(aggr);
+		for(size_t jj = 0; jj < num_children; jj++)
+		{
+			SLCONFIG_NODE* child = slc_get_node_by_index(aggr, jj);
+			if(child && slc_string_length(slc_get_name(child)) == 0)
+				reader->success = false;
+		}
+		
+		/* Unless the tree is kept locked across the calls */
+		if(!slc_begin_read(reader->root))
+			reader->success = false;
+		slc_begin_read(aggr);
+		num_children = slc_get_num_children(aggr);
+		for(size_t jj = 0; jj < num_children; jj++)
+		{
+			if(!slc_get_node_by_index(aggr, jj))
+				reader->success = false;
+		}
+		slc_end_read(aggr);
+		slc_end_read(reader->root);
+		
+		SLCONFIG_STRING value_str = slc_get_value(counter);
+		if(slc_string_length(value_str) == 0 || value_str.start[0] < '0' || value_str.start[0] > '9')
+			reader->success = false;
+	}
+	return NULL;
+}
+#endif
+
+static
+bool test_concurrent()
+{
+	bool ret = true;
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	TEST(slc_set_concurrent(root, true));
+	SLCONFIG_NODE* counter = slc_add_node(root, slc_from_c_str(""), false, slc_from_c_str("counter"), false, false);
+	SLCONFIG_NODE* aggr = slc_add_node(root, slc_from_c_str(""), false, slc_from_c_str("aggr"), false, true);
+	TEST(slc_set_int64(counter, 0));
+	
+	/* Replaced values and destroyed nodes are kept until they are reclaimed */
+	SLCONFIG_STRING old_value = slc_get_value(counter);
+	SLCONFIG_NODE* child = slc_add_node(aggr, slc_from_c_str(""), false, slc_from_c_str("child"), false, false);
+	size_t base_total = slc_get_memory_stats(root).total;
+	TEST(slc_set_int64(counter, 1));
+	slc_destroy_node(child);
+	TEST(slc_string_equal(old_value, slc_from_c_str("0")));
+	TEST(slc_string_equal(slc_get_name(child), slc_from_c_str("child")));
+	TEST(slc_get_num_children(aggr) == 0);
+	TEST(slc_get_node_by_index(aggr, 0) == NULL);
+	TEST(slc_get_memory_stats(root).total >= base_total);
+	slc_reclaim(root);
+	TEST(slc_get_memory_stats(root).total < base_total);
+	
+#ifndef _WIN32
+	CONCURRENT_READER readers[4];
+	pthread_t threads[4];
+	for(size_t ii = 0; ii < 4; ii++)
+	{
+		readers[ii].root = root;
+		readers[ii].success = true;
+		pthread_create(&threads[ii], NULL, &concurrent_read, &readers[ii]);
+	}
+	
+	for(int64_t ii = 2; ii < 500; ii++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "n%d", (int)ii);
+		SLCONFIG_NODE* node = slc_add_node(aggr, slc_from_c_str(""), false, slc_from_c_str(name), true, false);
+		slc_set_value(node, slc_from_c_str(name), true);
+		TEST(slc_set_int64(counter, ii));
+		if(ii % 2)
+			slc_destroy_node(node);
+	}
+	
+	for(size_t ii = 0; ii < 4; ii++)
+	{
+		pthread_join(threads[ii], NULL);
+		TEST(readers[ii].success);
+	}
+	slc_reclaim(root);
+	TEST(slc_get_num_children(aggr) == 249);
+#endif
+	
+	TEST(slc_set_concurrent(root, false));
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool collect_match(SLCONFIG_NODE* node, void* data)
+{
+	SLCONFIG_STRING* names = data;
+	while(names->start)
+		names++;
+	*names = slc_get_name(node);
+	return true;
+}
+
+static
+bool stop_after_first(SLCONFIG_NODE* node, void* data)
+{
+	(void)node;
+	(void)data;
+	return false;
+}
+
+/* Runs the query and checks that the names of the matches are the space separated names in order */
+static
+bool check_query(SLCONFIG_NODE* root, const char* query_str, const char* expected)
+{
+	SLCONFIG_QUERY* query = slc_query_compile(slc_from_c_str(query_str), NULL);
+	if(!query)
+		return false;
+	
+	SLCONFIG_STRING names[16];
+	memset(names, 0, sizeof(names));
+	size_t num_matches = slc_query_exec(query, root, &collect_match, names);
+	slc_destroy_query(query);
+	
+	const char* p = expected;
+	for(size_t ii = 0; ii < num_matches; ii++)
+	{
+		size_t len = strcspn(p, " ");
+		SLCONFIG_STRING name = {p, p + len};
+		if(!slc_string_equal(names[ii], name))
+			return false;
+		p += len;
+		if(*p == ' ')
+			p++;
+	}
+	return *p == '\0';
+}
+
+static
+bool test_query()
+{
+	bool ret = true;
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &ignore_error;
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(
+		"servers { web { port = 80; host = a; } db { port = 5432; } cache { host = c; } }"
+		"net { listener http { port = 8080; } group { listener https { port = 8443; } other {} } }"
+		"port = 1;"), false);
+	
+	TEST(check_query(root, "servers:*:port", "port port"));
+	TEST(check_query(root, "servers:*:host", "host host"));
+	TEST(check_query(root, "servers:*", "web db cache"));
+	TEST(check_query(root, "servers:web", "web"));
+	TEST(check_query(root, "servers:missing", ""));
+	TEST(check_query(root, "net:**:*[type=listener]", "http https"));
+	TEST(check_query(root, "net:**", "http port group https port other"));
+	TEST(check_query(root, "**:port", "port port port port port"));
+	TEST(check_query(root, "**:**:port", "port port port port port"));
+	TEST(check_query(root, "**:*[type!=listener]:port", "port port"));
+	TEST(check_query(root, "**:port[value>=5432]", "port port port"));
+	TEST(check_query(root, "**:port[value<100]", "port port"));
+	TEST(check_query(root, "servers:*:port[value=80]", "port"));
+	TEST(check_query(root, "servers:*:host[value!=a]", "host"));
+	TEST(check_query(root, "servers:*:host[value=\"c\"]", "host"));
+	TEST(check_query(root, "s*s:c*", "cache"));
+	TEST(check_query(root, "*:*[type=listener]:port", "port"));
+	
+	/* Queries are relative to the aggregate they are run on */
+	SLCONFIG_QUERY* query = slc_query_compile(slc_from_c_str("*:port"), NULL);
+	TEST(slc_query_exec(query, slc_get_node(root, slc_from_c_str("servers")), NULL, NULL) == 2);
+	TEST(slc_query_exec(query, slc_get_node_by_reference(root, slc_from_c_str("servers:web:port")), NULL, NULL) == 0);
+	slc_destroy_query(query);
+	
+	query = slc_query_compile(slc_from_c_str("**:port"), NULL);
+	TEST(slc_query_exec(query, root, &stop_after_first, NULL) == 1);
+	slc_destroy_query(query);
+	
+	TEST(slc_query_compile(slc_from_c_str(""), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("a::b"), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("a[name=b]"), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("a[value=b"), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("a[value<b]"), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("a[type<1]"), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("**[type=a]"), &vtable) == NULL);
+	TEST(slc_query_compile(slc_from_c_str("a[type=b]c"), &vtable) == NULL);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_iteration()
+{
+	bool ret = true;
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a = 1; int b = 2; c { d = 3; e { f; } } g {}"), false);
+	
+	SLCONFIG_ITER iter;
+	slc_iter_begin(&iter, root);
+	const char* names[] = {"a", "b", "c", "g"};
+	size_t num_children = 0;
+	while(slc_iter_next(&iter))
+	{
+		TEST(iter.index == num_children);
+		TEST(iter.node == slc_get_node_by_index(root, num_children));
+		TEST(slc_string_equal(iter.name, slc_from_c_str(names[num_children])));
+		TEST(iter.is_aggregate == (num_children >= 2));
+		num_children++;
+	}
+	TEST(num_children == 4);
+	slc_iter_begin(&iter, slc_get_node(root, slc_from_c_str("b")));
+	TEST(!slc_iter_next(&iter));
+	slc_iter_begin(&iter, root);
+	TEST(slc_iter_next(&iter) && slc_string_equal(iter.value, slc_from_c_str("1")));
+	TEST(slc_iter_next(&iter) && slc_string_equal(iter.type, slc_from_c_str("int")));
+	
+	/* Each event is encoded as '+' for entering, '-' for leaving and '=' for a value, followed by the name */
+	char events[128];
+	size_t len = 0;
+	size_t level = 0;
+	SLCONFIG_WALKER walker;
+	slc_walk_begin(&walker, root);
+	while(slc_walk_next(&walker))
+	{
+		if(walker.event == SLCONFIG_WALK_LEAVE)
+			level--;
+		TEST(walker.depth == level);
+		if(walker.event == SLCONFIG_WALK_ENTER)
+			level++;
+		events[len++] = walker.event == SLCONFIG_WALK_ENTER ? '+' : walker.event == SLCONFIG_WALK_LEAVE ? '-' : '=';
+		for(const char* p = walker.name.start; p < walker.name.end; p++)
+			events[len++] = *p;
+		
+		if(walker.event == SLCONFIG_WALK_ENTER && slc_string_equal(walker.name, slc_from_c_str("e")))
+			slc_walk_skip(&walker);
+	}
+	events[len] = '\0';
+	TEST(strcmp(events, "+=a=b+c=d+e-e-c+g-g-") == 0);
+	slc_destroy_node(root);
+	
+	/* Trees deeper than the inline frames work too */
+	root = slc_create_root_node(NULL);
+	SLCONFIG_NODE* node = root;
+	for(size_t ii = 0; ii < SLCONFIG_WALK_INLINE_DEPTH * 4; ii++)
+		node = slc_add_node(node, slc_from_c_str(""), false, slc_from_c_str("n"), false, true);
+	slc_add_node(node, slc_from_c_str(""), false, slc_from_c_str("leaf"), false, false);
+	
+	size_t max_depth = 0;
+	size_t num_events = 0;
+	slc_walk_begin(&walker, root);
+	while(slc_walk_next(&walker))
+	{
+		if(walker.depth > max_depth)
+			max_depth = walker.depth;
+		num_events++;
+	}
+	TEST(max_depth == SLCONFIG_WALK_INLINE_DEPTH * 4 + 1);
+	TEST(num_events == 2 * (SLCONFIG_WALK_INLINE_DEPTH * 4 + 1) + 1);
+	
+	/* Stopping early */
+	slc_walk_begin(&walker, root);
+	for(size_t ii = 0; ii < SLCONFIG_WALK_INLINE_DEPTH * 2; ii++)
+		TEST(slc_walk_next(&walker) && walker.event == SLCONFIG_WALK_ENTER);
+	slc_walk_end(&walker);
+	TEST(!slc_walk_next(&walker));
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
+static
+bool test_load_filter()
+{
+	bool ret = true;
+	const char* source =
+		"/** The template */\n"
+		"tmpl { port = 80; host = local; }\n"
+		"servers\n"
+		"{\n"
+		"\tdb { $tmpl; port = 5432; } /** About port */\n"
+		"\tweb { $tmpl; port = 8080; }\n"
+		"\tcache = x;\n"
+		"}\n"
+		"x = 1;\n"
+		"x = 2;\n"
+		"log { level = $x; /** About level */\n"
+		"\tport = $servers:db:port; }\n"
+		"x = 3;\n"
+		"unused { a { b = 1; } }\n"
+		"/** About tail */\n"
+		"tail = \"end\";\n";
+	SLCONFIG_STRING paths[] = {slc_from_c_str("servers:web"), slc_from_c_str("::log"), slc_from_c_str("tail")};
+	
+	SLCONFIG_NODE* full = slc_create_root_node(NULL);
+	TEST(slc_load_nodes_string(full, slc_from_c_str(""), slc_from_c_str(source), false));
+	SLCONFIG_NODE* root = slc_create_root_node(NULL);
+	TEST(slc_set_load_filter(root, paths, 3));
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(source), false));
+	
+	/* The kept paths, and the skipped nodes they reference, end up as if nothing was skipped */
+	const char* same[] = {"servers:web:port", "servers:web:host", "log:level", "log:port", "tmpl:port", "servers:db:port", "x", "tail"};
+	for(size_t ii = 0; ii < sizeof(same) / sizeof(same[0]); ii++)
+	{
+		SLCONFIG_NODE* expected = slc_get_node_by_reference(full, slc_from_c_str(same[ii]));
+		SLCONFIG_NODE* node = slc_get_node_by_reference(root, slc_from_c_str(same[ii]));
+		TEST(node && slc_string_equal(slc_get_value(node), slc_get_value(expected)));
+		TEST(node && slc_string_equal(slc_get_comment(node), slc_get_comment(expected)));
+	}
+	TEST(slc_string_equal(slc_get_comment(slc_get_node(root, slc_from_c_str("tmpl"))), slc_from_c_str(" The template ")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(root, slc_from_c_str("log:level"))), slc_from_c_str("2")));
+	TEST(slc_get_node_by_reference(root, slc_from_c_str("servers:cache")) == NULL);
+	TEST(slc_get_node(root, slc_from_c_str("unused")) == NULL);
+	
+	/* Forks keep the filter */
+	SLCONFIG_NODE* fork = slc_fork_root(root);
+	TEST(slc_load_nodes_string(fork, slc_from_c_str(""), slc_from_c_str("other = 1; tail = 2;"), false));
+	TEST(slc_get_node(fork, slc_from_c_str("other")) == NULL);
+	TEST(slc_string_equal(slc_get_value(slc_get_node(fork, slc_from_c_str("tail"))), slc_from_c_str("2")));
+	slc_destroy_node(fork);
+	slc_destroy_node(full);
+	slc_destroy_node(root);
+	
+	/* Skipped statements are still checked, and the ones that fail are not skipped */
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.fopen = &memory_fopen;
+	vtable.fclose = &memory_fclose;
+	vtable.fread = &memory_fread;
+	vtable.error = &ignore_error;
+	root = slc_create_root_node(&vtable);
+	SLCONFIG_STRING keep = slc_from_c_str("keep");
+	TEST(slc_set_load_filter(root, &keep, 1));
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("bad { a = ; } keep = 1;"), false));
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("bad { a = 1; keep = 1;"), false));
+	TEST(!slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("gone { a = 1; } ~gone; keep { $gone; }"), false));
+	slc_destroy_node(root);
+	
+	/* Included files are filtered too */
+	root = slc_create_root_node(&vtable);
+	TEST(slc_set_load_filter(root, &keep, 1));
+	base_file_contents = "keep { #include inc.cfg; }\nskip { #include inc.cfg; }\nc = $skip:b;\nd { e = 1; }";
+	TEST(slc_load_nodes(root, slc_from_c_str("base.cfg")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node_by_reference(root, slc_from_c_str("keep:b"))), slc_from_c_str("2")));
+	TEST(slc_string_equal(slc_get_value(slc_get_node(root, slc_from_c_str("c"))), slc_from_c_str("2")));
+	TEST(slc_get_node(root, slc_from_c_str("d")) == NULL);
+	
+	/* Invalid filters leave the old one be, and an empty one keeps everything */
+	SLCONFIG_STRING invalid[] = {slc_from_c_str("a:"), slc_from_c_str("a b"), slc_from_c_str("")};
+	for(size_t ii = 0; ii < 3; ii++)
+		TEST(!slc_set_load_filter(root, &invalid[ii], 1));
+	SLCONFIG_STRING many[65];
+	for(size_t ii = 0; ii < 65; ii++)
+		many[ii] = keep;
+	TEST(!slc_set_load_filter(root, many, 65));
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("f = 1;"), false));
+	TEST(slc_get_node(root, slc_from_c_str("f")) == NULL);
+	TEST(slc_set_load_filter(root, NULL, 0));
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("f = 1;"), false));
+	TEST(slc_get_node(root, slc_from_c_str("f")) != NULL);
+	slc_destroy_node(root);
+	return ret;
+}
+
+/* Counts the changes of each kind, and remembers the last node */
+typedef struct
+{
+	size_t counts[SLCONFIG_CHANGE_LOAD + 1];
+	SLCONFIG_NODE* last;
+} CHANGES;
+
+static
+void count_change(SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event, void* data)
+{
+	CHANGES* changes = data;
+	changes->counts[event]++;
+	changes->last = node;
+}
+
+static
+bool test_change_tracking()
+{
+	bool ret = true;
+	
+	SLCONFIG_VTABLE vtable;
+	memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	vtable.error = &count_refusal;
+	SLCONFIG_NODE* root = slc_create_root_node(&vtable);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("a { x = 1; y = 2; } b { z = 3; }"), false));
+	SLCONFIG_NODE* a = slc_get_node(root, slc_from_c_str("a"));
+	SLCONFIG_NODE* b = slc_get_node(root, slc_from_c_str("b"));
+	SLCONFIG_NODE* x = slc_get_node(a, slc_from_c_str("x"));
+	SLCONFIG_NODE* y = slc_get_node(a, slc_from_c_str("y"));
+	TEST(slc_get_generation(root) > 0);
+	TEST(slc_get_generation(x) == slc_get_generation(root));
+	
+	CHANGES changes;
+	memset(&changes, 0, sizeof(CHANGES));
+	slc_add_observer(root, &count_change, &changes);
+	
+	/* A change moves the node and its ancestors to a new generation, and leaves the rest alone */
+	uint64_t root_gen = slc_get_generation(root);
+	uint64_t b_gen = slc_get_generation(b);
+	uint64_t y_gen = slc_get_generation(y);
+	TEST(slc_set_int64(x, 5));
+	TEST(slc_get_generation(x) > root_gen);
+	TEST(slc_get_generation(a) == slc_get_generation(x));
+	TEST(slc_get_generation(root) == slc_get_generation(x));
+	TEST(slc_get_generation(b) == b_gen);
+	TEST(slc_get_generation(y) == y_gen);
+	TEST(changes.counts[SLCONFIG_CHANGE_VALUE] == 1 && changes.last == x);
+	
+	TEST(!slc_set_value(a, slc_from_c_str("1"), false));
+	TEST(changes.counts[SLCONFIG_CHANGE_VALUE] == 1);
+	
+	root_gen = slc_get_generation(root);
+	slc_set_comment(y, slc_from_c_str("About y"), true);
+	TEST(slc_get_generation(root) > root_gen);
+	TEST(changes.counts[SLCONFIG_CHANGE_COMMENT] == 1 && changes.last == y);
+	
+	/* Adding an existing node changes nothing */
+	root_gen = slc_get_generation(root);
+	SLCONFIG_NODE* w = slc_add_node(b, slc_from_c_str(""), false, slc_from_c_str("w"), false, false);
+	TEST(slc_get_generation(b) > b_gen);
+	TEST(slc_get_generation(w) == slc_get_generation(root));
+	TEST(changes.counts[SLCONFIG_CHANGE_ADD] == 1 && changes.last == w);
+	b_gen = slc_get_generation(b);
+	TEST(slc_add_node(b, slc_from_c_str(""), false, slc_from_c_str("w"), false, false) == w);
+	TEST(slc_get_generation(b) == b_gen);
+	TEST(changes.counts[SLCONFIG_CHANGE_ADD] == 1);
+	
+	slc_destroy_node(w);
+	TEST(slc_get_generation(b) > b_gen);
+	TEST(changes.counts[SLCONFIG_CHANGE_REMOVE] == 1 && changes.last == w);
+	
+	/* A load is reported once, and only touches what it changes */
+	uint64_t a_gen = slc_get_generation(a);
+	b_gen = slc_get_generation(b);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str("b:z = 4; c = 5; ~a:y;"), false));
+	TEST(changes.counts[SLCONFIG_CHANGE_LOAD] == 1 && changes.last == root);
+	TEST(slc_get_generation(a) > a_gen);
+	TEST(slc_get_generation(b) > b_gen);
+	TEST(slc_get_generation(x) < slc_get_generation(a));
+	TEST(slc_get_generation(slc_get_node(root, slc_from_c_str("c"))) == slc_get_generation(root));
+	TEST(changes.counts[SLCONFIG_CHANGE_VALUE] == 1);
+	
+	root_gen = slc_get_generation(root);
+	TEST(slc_load_nodes_string(root, slc_from_c_str(""), slc_from_c_str(""), false));
+	TEST(slc_get_generation(root) == root_gen);
+	TEST(changes.counts[SLCONFIG_CHANGE_LOAD] == 1);
+	
+	/* Changes to a fork do not show up in the original */
+	SLCONFIG_NODE* fork = slc_fork_root(root);
+	TEST(slc_set_int64(slc_get_writable_node(fork, slc_from_c_str("b:z")), 6));
+	TEST(slc_get_generation(slc_get_node_by_reference(fork, slc_from_c_str("b:z"))) > root_gen);
+	TEST(slc_get_generation(fork) > root_gen);
+	TEST(slc_get_generation(root) == root_gen);
+	TEST(slc_get_generation(slc_get_node_by_reference(root, slc_from_c_str("b:z"))) <= root_gen);
+	TEST(changes.counts[SLCONFIG_CHANGE_VALUE] == 1);
+	slc_destroy_node(fork);
+	
+	TEST(slc_remove_observer(root, &count_change, &changes));
+	TEST(!slc_remove_observer(root, &count_change, &changes));
+	TEST(!slc_set_int64(x, 6));
+	TEST(slc_set_int64(slc_get_writable_node(root, slc_from_c_str("a:x")), 6));
+	TEST(changes.counts[SLCONFIG_CHANGE_VALUE] == 1);
+	
+	slc_destroy_node(root);
+	return ret;
+}
+
 int main()
 {
 	bool ret = true;
 	ret &= test_references();
 	ret &= test_saving();
 	ret &= test_user_data();
+	ret &= test_typed_values();
+	ret &= test_binding();
+	ret &= test_schema();
+	ret &= test_full_name();
+	ret &= test_bulk_access();
+	ret &= test_load_stats();
+	ret &= test_deep_nesting();
+	ret &= test_parse_errors();
+	ret &= test_string_scanning();
+	ret &= test_dedupe();
+	ret &= test_overlay();
+	ret &= test_fork();
+	ret &= test_file_cache();
+	ret &= test_compact();
+	ret &= test_memory_stats();
+	ret &= test_diagnostics();
+	ret &= test_writer();
+	ret &= test_compact_saving();
+	ret &= test_parallel_saving();
+	ret &= test_load_many();
+	ret &= test_concurrent();
+	ret &= test_query();
+	ret &= test_iteration();
+	ret &= test_load_filter();
+	ret &= test_change_tracking();
 
 	if(ret)
 	{
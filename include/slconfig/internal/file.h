@@ -3,4 +3,12 @@
 
 #include <stdlib.h>
 
+#include "slconfig/internal/slconfig.h"
+
+void _slc_retain_file_cache(SLCONFIG_FILE_CACHE* cache);
+void _slc_release_file_cache(SLCONFIG_FILE_CACHE* cache);
+/* Returns the cached copy of the file, taking over the passed buffer. Each call must be paired with a release */
+SLCONFIG_STRING _slc_cache_file(SLCONFIG_FILE_CACHE* cache, CONFIG* config, SLCONFIG_STRING path, SLCONFIG_STRING file);
+void _slc_release_cached_file(SLCONFIG_FILE_CACHE* cache, SLCONFIG_STRING file);
+
 #endif
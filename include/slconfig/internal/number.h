@@ -0,0 +1,18 @@
+#ifndef _INTERNAL_NUMBER_H
+#define _INTERNAL_NUMBER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "slconfig/slconfig.h"
+
+/* Large enough for any formatted int64_t or double, including the sign */
+#define NUMBER_BUFFER_SIZE (32)
+
+bool _slc_parse_int64(SLCONFIG_STRING str, int64_t* value);
+bool _slc_parse_double(SLCONFIG_STRING str, double* value);
+bool _slc_parse_bool(SLCONFIG_STRING str, bool* value);
+size_t _slc_format_int64(int64_t value, char* buf);
+size_t _slc_format_double(double value, char* buf);
+
+#endif
@@ -5,6 +5,10 @@
 #include "slconfig/internal/tokenizer.h"
 
 bool _slc_parse_file(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filename, SLCONFIG_STRING file);
+/* Forget the statements skipped by the load that just ended, returns false if replaying any of them failed */
+bool _slc_clear_skipped_statements(CONFIG* config);
+void _slc_clear_load_filter(CONFIG* config);
+void _slc_copy_load_filter(CONFIG* dest, const CONFIG* src);
 
 #endif
 
@@ -2,11 +2,34 @@
 #define _INTERNAL_SLCONFIG_H
 
 #include "slconfig/slconfig.h"
+#include "slconfig/internal/thread.h"
 
+/* Bits of SLCONFIG_NODE::value_cache. A value is only decoded once, whether or not it succeeds */
+#define VALUE_CACHE_INT64          (1 << 0)
+#define VALUE_CACHE_INT64_VALID    (1 << 1)
+#define VALUE_CACHE_DOUBLE         (1 << 2)
+#define VALUE_CACHE_DOUBLE_VALID   (1 << 3)
+#define VALUE_CACHE_BOOL           (1 << 4)
+#define VALUE_CACHE_BOOL_VALID     (1 << 5)
+
+/* Value of CONFIG::cur_stats when statistics are not being collected */
+#define NO_STATS ((size_t)-1)
+
+/* A callback registered with slc_add_observer */
 typedef struct
+{
+	void (*callback)(SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event, void* data);
+	void* data;
+} OBSERVER;
+
+typedef struct CONFIG
 {
 	SLCONFIG_STRING* files;
+	/* Cache each file belongs to, NULL if the config owns it */
+	SLCONFIG_FILE_CACHE** file_caches;
 	size_t num_files;
+	/* Cache that newly loaded files are shared through */
+	SLCONFIG_FILE_CACHE* file_cache;
 	
 	SLCONFIG_NODE* root;
 	
@@ -22,6 +45,67 @@ typedef struct
 	SLCONFIG_STRING* search_dirs;
 	bool* search_dir_ownerships;
 	size_t num_search_dirs;
+	
+	/* Load statistics, one entry per loaded file */
+	bool collect_stats;
+	SLCONFIG_LOAD_STATS* load_stats;
+	size_t num_load_stats;
+	size_t cur_stats;
+	/* Time spent in includes of the file currently being parsed */
+	uint64_t nested_ns;
+	
+	/* Maximum nesting depth of aggregate blocks when parsing, 0 if unlimited */
+	size_t max_depth;
+	
+	/*
+	 * Paths kept by loads, see slc_set_load_filter. The names of the path ii are filter_names[filter_starts[ii]] up to
+	 * filter_names[filter_starts[ii + 1]]
+	 */
+	SLCONFIG_STRING* filter_names;
+	size_t* filter_starts;
+	size_t num_filter_paths;
+	/* Statements skipped by the current load, NULL if there are none */
+	struct SKIPPED_STATEMENTS* skipped_statements;
+	
+	/* Diagnostic being assembled, its text lives in error_buffer which is reused between diagnostics */
+	SLCONFIG_DIAGNOSTIC diagnostic;
+	char* error_buffer;
+	size_t error_size;
+	size_t error_capacity;
+	/* Offsets of the message and the node path in error_buffer, node_path_end is 0 if there is no node path */
+	size_t message_start;
+	size_t node_path_start;
+	size_t node_path_end;
+	/* Errors reported by the current load, and how many are collected before parsing stops, 0 if unlimited */
+	size_t num_errors;
+	size_t max_errors;
+	
+	/* Generation of the latest change to the tree. While loading, every change made by the load shares it */
+	uint64_t generation;
+	bool loading;
+	OBSERVER* observers;
+	size_t num_observers;
+	
+	/* Strings shared between nodes by slc_dedupe */
+	SLCONFIG_STRING* shared_strings;
+	size_t num_shared_strings;
+	size_t shared_strings_capacity;
+	
+	/* Number of roots using this config, its own and its forks and overlays */
+	size_t refcount;
+	/* Config of the tree this one is a fork or an overlay of */
+	struct CONFIG* base;
+	/* Nodes holding the former children of the aggregates that were forked or overlaid, shared with the new roots */
+	SLCONFIG_NODE** frozen_nodes;
+	size_t num_frozen_nodes;
+	
+	/* Taken by the public functions in concurrent mode, NULL otherwise */
+	RWLOCK* lock;
+	/* Strings and nodes replaced or removed in concurrent mode, which readers might still hold, freed by slc_reclaim */
+	SLCONFIG_STRING* retired_strings;
+	size_t num_retired_strings;
+	SLCONFIG_NODE** retired_nodes;
+	size_t num_retired_nodes;
 } CONFIG;
 
 struct SLCONFIG_NODE
@@ -35,9 +119,18 @@ struct SLCONFIG_NODE
 	SLCONFIG_STRING comment;
 	bool own_comment;
 	
+	/* Decoded forms of the value, see VALUE_CACHE_* */
+	unsigned char value_cache;
+	bool bool_value;
+	int64_t int64_value;
+	double double_value;
+	
 	SLCONFIG_NODE** children;
 	size_t num_children;
 	
+	/* Generation of the latest change to the node or any of its descendants */
+	uint64_t generation;
+	
 	intptr_t user_data;
 	void (*user_destructor)(intptr_t);
 	
@@ -46,13 +139,45 @@ struct SLCONFIG_NODE
 	CONFIG* config;
 };
 
+void _slc_fill_vtable(SLCONFIG_VTABLE* vtable);
+/* Lock the tree for the duration of a public function. These do nothing unless the tree is in concurrent mode */
+void _slc_begin_read(const CONFIG* config);
+void _slc_end_read(const CONFIG* config);
+void _slc_begin_write(CONFIG* config);
+void _slc_end_write(CONFIG* config);
+/* Unlocked versions of the public functions, for use inside of the library */
+SLCONFIG_NODE* _slc_get_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name);
+SLCONFIG_NODE* _slc_add_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool copy_type, SLCONFIG_STRING name, bool copy_name, bool is_aggregate);
+size_t _slc_format_full_name(const SLCONFIG_NODE* node, char* buf, size_t capacity);
+bool _slc_get_int64(const SLCONFIG_NODE* string_node, int64_t* value);
+bool _slc_get_double(const SLCONFIG_NODE* string_node, double* value);
+bool _slc_get_bool(const SLCONFIG_NODE* string_node, bool* value);
 SLCONFIG_NODE* _slc_search_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name);
 SLCONFIG_NODE* _slc_add_node_no_attach(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool copy_type, SLCONFIG_STRING name, bool copy_name, bool is_aggregate);
 void _slc_attach_node(SLCONFIG_NODE* aggregate, SLCONFIG_NODE* node);
+/* Gives the node and its ancestors a new generation */
+void _slc_touch_node(SLCONFIG_NODE* node);
 void _slc_copy_into(SLCONFIG_NODE* dest, SLCONFIG_NODE* src);
 void _slc_destroy_node(SLCONFIG_NODE* node, bool detach);
+/* Destroys the children that the aggregate owns, and forgets the ones it shares with the base of an overlay */
+void _slc_destroy_children(SLCONFIG_NODE* aggregate);
+/* Make sure a child belongs to the aggregate rather than the base of an overlay, so that it can be modified */
+SLCONFIG_NODE* _slc_own_child(SLCONFIG_NODE* aggregate, size_t idx);
+SLCONFIG_NODE* _slc_get_own_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name);
+SLCONFIG_NODE* _slc_search_own_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name);
+/* Whether the node is shared between trees, and so must not be modified in place */
+bool _slc_is_frozen(const SLCONFIG_NODE* node);
 void _slc_free(CONFIG* config, void*);
-void _slc_add_file(CONFIG* config, SLCONFIG_STRING new_file);
+void* _slc_realloc(CONFIG* config, void* ptr, size_t size);
+/* Makes room for one more frame in an explicit stack, used to walk deep trees without recursion */
+void* _slc_grow_stack(const CONFIG* config, void* stack, size_t size, size_t* capacity, size_t frame_size);
+void _slc_append_to_string(CONFIG* config, SLCONFIG_STRING* dest, SLCONFIG_STRING new_str);
+void _slc_own_string(CONFIG* config, SLCONFIG_STRING* str, bool* own);
+/* Frees a string that a node no longer uses, or keeps it until slc_reclaim in concurrent mode */
+void _slc_retire_string(CONFIG* config, SLCONFIG_STRING* str);
+SLCONFIG_LOAD_STATS* _slc_get_cur_stats(CONFIG* config);
+size_t _slc_begin_load_stats(CONFIG* config, SLCONFIG_STRING filename);
+void _slc_add_file(CONFIG* config, SLCONFIG_STRING path, SLCONFIG_STRING* new_file);
 bool _slc_load_file(CONFIG* config, SLCONFIG_STRING filename, SLCONFIG_STRING* file);
 
 bool _slc_add_include(CONFIG* config, SLCONFIG_STRING filename, bool own, size_t line);
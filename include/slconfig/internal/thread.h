@@ -0,0 +1,36 @@
+#ifndef _INTERNAL_THREAD_H
+#define _INTERNAL_THREAD_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* The platform types stay in thread.c, so that nothing else needs to know about them */
+typedef struct THREAD THREAD;
+typedef struct MUTEX MUTEX;
+typedef struct RWLOCK RWLOCK;
+
+/* Returns NULL if the thread could not be started */
+THREAD* _slc_start_thread(void (*func)(void* arg), void* arg, void* (*custom_realloc)(void*, size_t));
+void _slc_join_thread(THREAD* thread, void* (*custom_realloc)(void*, size_t));
+MUTEX* _slc_create_mutex(void* (*custom_realloc)(void*, size_t));
+void _slc_destroy_mutex(MUTEX* mutex, void* (*custom_realloc)(void*, size_t));
+void _slc_lock_mutex(MUTEX* mutex);
+void _slc_unlock_mutex(MUTEX* mutex);
+/* Readers share the lock, writers hold it alone. Neither can take it again while holding it */
+RWLOCK* _slc_create_rwlock(void* (*custom_realloc)(void*, size_t));
+void _slc_destroy_rwlock(RWLOCK* lock, void* (*custom_realloc)(void*, size_t));
+void _slc_lock_read(RWLOCK* lock);
+void _slc_unlock_read(RWLOCK* lock);
+void _slc_lock_write(RWLOCK* lock);
+void _slc_unlock_write(RWLOCK* lock);
+size_t _slc_get_num_cpus(void);
+/* A pointer kept separately for every thread, NULL until it is set. Setting it returns false if that is not possible */
+void* _slc_get_thread_data(void);
+bool _slc_set_thread_data(void* data);
+/*
+ * Calls func for every task below num_tasks, on up to num_threads threads including the calling one, and returns once
+ * they are all done. 0 threads means one per processor
+ */
+void _slc_parallel_for(size_t num_tasks, size_t num_threads, void (*func)(void* arg, size_t task), void* arg, void* (*custom_realloc)(void*, size_t));
+
+#endif
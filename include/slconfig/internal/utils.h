@@ -6,8 +6,17 @@
 #include "slconfig/slconfig.h"
 #include "slconfig/internal/tokenizer.h"
 
-void _slc_print_error_prefix(CONFIG* config, SLCONFIG_STRING filename, size_t line, SLCONFIG_VTABLE* table);
+#define HASH_SEED (14695981039346656037ull)
+
+void _slc_begin_error(CONFIG* config, SLCONFIG_ERROR_CODE code, SLCONFIG_STRING filename, size_t line);
+void _slc_begin_warning(CONFIG* config, SLCONFIG_ERROR_CODE code, SLCONFIG_STRING filename, size_t line);
+void _slc_error(CONFIG* config, SLCONFIG_STRING str);
+void _slc_error_full_name(CONFIG* config, const SLCONFIG_NODE* node);
+void _slc_end_error(CONFIG* config);
 void _slc_expected_after_error(CONFIG* config, TOKENIZER_STATE* state, size_t line, SLCONFIG_STRING expected, SLCONFIG_STRING after, SLCONFIG_STRING actual);
 void _slc_expected_error(CONFIG* config, TOKENIZER_STATE* state, size_t line, SLCONFIG_STRING expected, SLCONFIG_STRING actual);
+uint64_t _slc_hash_string(uint64_t hash, SLCONFIG_STRING str);
+int _slc_string_compare(SLCONFIG_STRING a, SLCONFIG_STRING b);
+uint64_t _slc_get_time_ns(void);
 
 #endif
@@ -12,6 +12,43 @@ typedef struct
 	const char* end;
 } SLCONFIG_STRING;
 
+typedef enum
+{
+	SLCONFIG_SEVERITY_ERROR,
+	SLCONFIG_SEVERITY_WARNING
+} SLCONFIG_SEVERITY;
+
+typedef enum
+{
+	SLCONFIG_ERROR_UNTERMINATED_STRING,
+	SLCONFIG_ERROR_UNTERMINATED_COMMENT,
+	SLCONFIG_ERROR_UNEXPECTED_TOKEN,
+	SLCONFIG_ERROR_UNPAIRED_BRACE,
+	SLCONFIG_ERROR_DOES_NOT_EXIST,
+	SLCONFIG_ERROR_NOT_AGGREGATE,
+	SLCONFIG_ERROR_IS_AGGREGATE,
+	SLCONFIG_ERROR_TYPE_CONFLICT,
+	SLCONFIG_ERROR_CIRCULAR_INCLUDE,
+	SLCONFIG_ERROR_MISSING_FILE,
+	SLCONFIG_ERROR_MAX_DEPTH,
+	SLCONFIG_ERROR_SCHEMA_VIOLATION,
+	SLCONFIG_ERROR_INVALID_VALUE,
+	SLCONFIG_ERROR_READ_ONLY
+} SLCONFIG_ERROR_CODE;
+
+typedef struct
+{
+	SLCONFIG_SEVERITY severity;
+	SLCONFIG_ERROR_CODE code;
+	SLCONFIG_STRING filename;
+	size_t line;
+	const SLCONFIG_STRING* include_files;
+	const size_t* include_lines;
+	size_t num_includes;
+	SLCONFIG_STRING node_path;
+	SLCONFIG_STRING message;
+} SLCONFIG_DIAGNOSTIC;
+
 typedef struct
 {
 	void* (*realloc)(void* buf, size_t size);
@@ -20,18 +57,181 @@ typedef struct
 	int (*fclose)(void* file);
 	size_t (*fread)(void* buf, size_t size, void* file);
 	size_t (*fwrite)(const void* buf, size_t size, void* file);
+	void (*diagnostic)(const SLCONFIG_DIAGNOSTIC* diagnostic);
 } SLCONFIG_VTABLE;
 
 typedef struct SLCONFIG_NODE SLCONFIG_NODE;
 
+typedef enum
+{
+	SLCONFIG_BIND_INT64,
+	SLCONFIG_BIND_DOUBLE,
+	SLCONFIG_BIND_BOOL,
+	SLCONFIG_BIND_STRING
+} SLCONFIG_BIND_TYPE;
+
+typedef struct
+{
+	const char* path;
+	SLCONFIG_BIND_TYPE type;
+	size_t offset;
+	const char* default_value;
+} SLCONFIG_BINDING;
+
+typedef struct SLCONFIG_BIND_PLAN SLCONFIG_BIND_PLAN;
+
+typedef struct SLCONFIG_SCHEMA SLCONFIG_SCHEMA;
+
+typedef struct SLCONFIG_FILE_CACHE SLCONFIG_FILE_CACHE;
+
+typedef struct SLCONFIG_WRITER SLCONFIG_WRITER;
+
+typedef struct SLCONFIG_QUERY SLCONFIG_QUERY;
+
+typedef enum
+{
+	SLCONFIG_TOKEN_STRING,
+	SLCONFIG_TOKEN_DOLLAR,
+	SLCONFIG_TOKEN_SEMICOLON,
+	SLCONFIG_TOKEN_LEFT_BRACE,
+	SLCONFIG_TOKEN_RIGHT_BRACE,
+	SLCONFIG_TOKEN_COLON,
+	SLCONFIG_TOKEN_DOUBLE_COLON,
+	SLCONFIG_TOKEN_ASSIGN,
+	SLCONFIG_TOKEN_ERROR,
+	SLCONFIG_TOKEN_TILDE,
+	SLCONFIG_TOKEN_COMMENT,
+	SLCONFIG_TOKEN_HASH,
+	SLCONFIG_TOKEN_EOF,
+	SLCONFIG_NUM_TOKEN_TYPES
+} SLCONFIG_TOKEN_TYPE;
+
+typedef struct
+{
+	SLCONFIG_STRING filename;
+	size_t include_depth;
+	size_t bytes_read;
+	size_t num_tokens[SLCONFIG_NUM_TOKEN_TYPES];
+	size_t nodes_created;
+	size_t expansions;
+	size_t nodes_copied;
+	size_t allocations;
+	size_t allocated_bytes;
+	uint64_t load_ns;
+	uint64_t tokenize_ns;
+	uint64_t parse_ns;
+} SLCONFIG_LOAD_STATS;
+
+typedef struct
+{
+	size_t nodes;
+	size_t children;
+	size_t types;
+	size_t names;
+	size_t values;
+	size_t comments;
+	size_t files;
+	size_t shared_strings;
+	size_t bookkeeping;
+	size_t total;
+} SLCONFIG_MEMORY_STATS;
+
+typedef struct
+{
+	SLCONFIG_NODE* node;
+	SLCONFIG_STRING name;
+	SLCONFIG_STRING type;
+	SLCONFIG_STRING value;
+	bool is_aggregate;
+	size_t index;
+	
+	/* Private */
+	SLCONFIG_NODE* aggregate;
+	size_t next;
+} SLCONFIG_ITER;
+
+typedef enum
+{
+	SLCONFIG_WALK_ENTER,
+	SLCONFIG_WALK_LEAVE,
+	SLCONFIG_WALK_VALUE
+} SLCONFIG_WALK_EVENT;
+
+/* Number of levels a walker can descend before it needs to allocate */
+#define SLCONFIG_WALK_INLINE_DEPTH (32)
+
+typedef struct
+{
+	SLCONFIG_NODE* aggregate;
+	size_t next;
+} SLCONFIG_WALK_FRAME;
+
+typedef struct
+{
+	SLCONFIG_WALK_EVENT event;
+	SLCONFIG_NODE* node;
+	SLCONFIG_STRING name;
+	SLCONFIG_STRING type;
+	SLCONFIG_STRING value;
+	bool is_aggregate;
+	size_t depth;
+	
+	/* Private */
+	SLCONFIG_NODE* start;
+	bool started;
+	size_t num_frames;
+	size_t frames_capacity;
+	SLCONFIG_WALK_FRAME* heap_frames;
+	SLCONFIG_WALK_FRAME inline_frames[SLCONFIG_WALK_INLINE_DEPTH];
+} SLCONFIG_WALKER;
+
+typedef enum
+{
+	SLCONFIG_CHANGE_VALUE,
+	SLCONFIG_CHANGE_COMMENT,
+	SLCONFIG_CHANGE_ADD,
+	SLCONFIG_CHANGE_REMOVE,
+	SLCONFIG_CHANGE_LOAD
+} SLCONFIG_CHANGE_EVENT;
+
 /* Node IO */
 SLCONFIG_NODE* slc_create_root_node(const SLCONFIG_VTABLE* vtable);
+SLCONFIG_NODE* slc_create_overlay_root(SLCONFIG_NODE* base, const SLCONFIG_VTABLE* vtable);
+SLCONFIG_NODE* slc_fork_root(SLCONFIG_NODE* node);
 void slc_add_search_directory(SLCONFIG_NODE* node, SLCONFIG_STRING directory, bool copy);
 void slc_clear_search_directories(SLCONFIG_NODE* node);
+void slc_set_max_depth(SLCONFIG_NODE* node, size_t max_depth);
+void slc_set_max_errors(SLCONFIG_NODE* node, size_t max_errors);
+bool slc_set_load_filter(SLCONFIG_NODE* node, const SLCONFIG_STRING* paths, size_t num_paths);
 bool slc_load_nodes(SLCONFIG_NODE* aggregate, SLCONFIG_STRING filename);
 bool slc_load_nodes_string(SLCONFIG_NODE* aggregate, SLCONFIG_STRING filename, SLCONFIG_STRING file, bool copy);
+bool slc_load_many(SLCONFIG_NODE* const* aggregates, const SLCONFIG_STRING* filenames, size_t num_files, size_t num_threads, SLCONFIG_FILE_CACHE* file_cache, bool dedupe);
 bool slc_save_node(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation);
 SLCONFIG_STRING slc_save_node_string(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation);
+bool slc_save_node_compact(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, bool canonical);
+SLCONFIG_STRING slc_save_node_compact_string(const SLCONFIG_NODE* node, bool canonical);
+uint64_t slc_hash_node(const SLCONFIG_NODE* node);
+bool slc_save_node_parallel(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, size_t num_threads);
+SLCONFIG_STRING slc_save_node_string_parallel(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, size_t num_threads);
+
+/* Streaming output */
+SLCONFIG_WRITER* slc_create_writer(SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, const SLCONFIG_VTABLE* vtable);
+bool slc_destroy_writer(SLCONFIG_WRITER* writer);
+bool slc_writer_begin_aggregate(SLCONFIG_WRITER* writer, SLCONFIG_STRING type, SLCONFIG_STRING name);
+bool slc_writer_end_aggregate(SLCONFIG_WRITER* writer);
+bool slc_writer_string_node(SLCONFIG_WRITER* writer, SLCONFIG_STRING type, SLCONFIG_STRING name, SLCONFIG_STRING value);
+bool slc_writer_comment(SLCONFIG_WRITER* writer, SLCONFIG_STRING comment);
+
+/* File cache */
+SLCONFIG_FILE_CACHE* slc_create_file_cache(const SLCONFIG_VTABLE* vtable);
+void slc_destroy_file_cache(SLCONFIG_FILE_CACHE* cache);
+void slc_set_file_cache(SLCONFIG_NODE* node, SLCONFIG_FILE_CACHE* cache);
+size_t slc_get_num_cached_files(const SLCONFIG_FILE_CACHE* cache);
+
+/* Load statistics */
+void slc_enable_load_stats(SLCONFIG_NODE* node, bool enable);
+const SLCONFIG_LOAD_STATS* slc_get_load_stats(const SLCONFIG_NODE* node, size_t* num_stats);
+void slc_clear_load_stats(SLCONFIG_NODE* node);
 
 /* Node creation/destruction */
 SLCONFIG_NODE* slc_add_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool copy_type, SLCONFIG_STRING name, bool copy_name, bool is_aggregate);
@@ -41,11 +241,21 @@ void slc_destroy_node(SLCONFIG_NODE* node);
 SLCONFIG_NODE* slc_get_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name);
 SLCONFIG_NODE* slc_get_node_by_index(SLCONFIG_NODE* aggregate, size_t idx);
 SLCONFIG_NODE* slc_get_node_by_reference(SLCONFIG_NODE* aggregate, SLCONFIG_STRING reference);
+SLCONFIG_NODE* slc_get_writable_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING reference);
+
+/* Iteration */
+void slc_iter_begin(SLCONFIG_ITER* iter, SLCONFIG_NODE* aggregate);
+bool slc_iter_next(SLCONFIG_ITER* iter);
+void slc_walk_begin(SLCONFIG_WALKER* walker, SLCONFIG_NODE* node);
+bool slc_walk_next(SLCONFIG_WALKER* walker);
+void slc_walk_skip(SLCONFIG_WALKER* walker);
+void slc_walk_end(SLCONFIG_WALKER* walker);
 
 /* Node properties */
 SLCONFIG_STRING slc_get_name(const SLCONFIG_NODE* node);
 SLCONFIG_STRING slc_get_type(const SLCONFIG_NODE* node);
 SLCONFIG_STRING slc_get_full_name(const SLCONFIG_NODE* node);
+size_t slc_format_full_name(const SLCONFIG_NODE* node, char* buf, size_t capacity);
 bool slc_is_aggregate(const SLCONFIG_NODE* node);
 size_t slc_get_num_children(const SLCONFIG_NODE* node);
 SLCONFIG_STRING slc_get_value(const SLCONFIG_NODE* string_node);
@@ -53,7 +263,52 @@ bool slc_set_value(SLCONFIG_NODE* node, SLCONFIG_STRING string_node, bool copy);
 intptr_t slc_get_user_data(SLCONFIG_NODE* node);
 void slc_set_user_data(SLCONFIG_NODE* node, intptr_t data, void (*user_destructor)(intptr_t));
 SLCONFIG_STRING slc_get_comment(const SLCONFIG_NODE* node);
-void slc_set_comment(SLCONFIG_NODE* node, SLCONFIG_STRING comment, bool copy);
+bool slc_set_comment(SLCONFIG_NODE* node, SLCONFIG_STRING comment, bool copy);
+
+/* Change tracking */
+uint64_t slc_get_generation(const SLCONFIG_NODE* node);
+void slc_add_observer(SLCONFIG_NODE* node, void (*observer)(SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event, void* data), void* data);
+bool slc_remove_observer(SLCONFIG_NODE* node, void (*observer)(SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event, void* data), void* data);
+
+/* Typed values */
+bool slc_get_int64(const SLCONFIG_NODE* string_node, int64_t* value);
+bool slc_get_double(const SLCONFIG_NODE* string_node, double* value);
+bool slc_get_bool(const SLCONFIG_NODE* string_node, bool* value);
+bool slc_set_int64(SLCONFIG_NODE* string_node, int64_t value);
+bool slc_set_double(SLCONFIG_NODE* string_node, double value);
+bool slc_set_bool(SLCONFIG_NODE* string_node, bool value);
+
+/* Bulk access */
+size_t slc_get_values(const SLCONFIG_NODE* aggregate, SLCONFIG_STRING* values, size_t capacity);
+size_t slc_get_int64s(const SLCONFIG_NODE* aggregate, int64_t* values, size_t capacity);
+size_t slc_get_doubles(const SLCONFIG_NODE* aggregate, double* values, size_t capacity);
+
+/* Struct binding */
+SLCONFIG_BIND_PLAN* slc_create_bind_plan(const SLCONFIG_BINDING* bindings, size_t num_bindings, const SLCONFIG_VTABLE* vtable);
+void slc_destroy_bind_plan(SLCONFIG_BIND_PLAN* plan);
+bool slc_bind(SLCONFIG_NODE* aggregate, const SLCONFIG_BIND_PLAN* plan, void* dest);
+
+/* Schema validation */
+SLCONFIG_SCHEMA* slc_create_schema(const SLCONFIG_NODE* aggregate);
+void slc_destroy_schema(SLCONFIG_SCHEMA* schema);
+size_t slc_validate(const SLCONFIG_SCHEMA* schema, const SLCONFIG_NODE* node);
+
+/* Queries */
+SLCONFIG_QUERY* slc_query_compile(SLCONFIG_STRING query, const SLCONFIG_VTABLE* vtable);
+void slc_destroy_query(SLCONFIG_QUERY* query);
+size_t slc_query_exec(const SLCONFIG_QUERY* query, SLCONFIG_NODE* aggregate, bool (*callback)(SLCONFIG_NODE* node, void* data), void* data);
+
+/* Memory */
+size_t slc_dedupe(SLCONFIG_NODE* node);
+size_t slc_compact(SLCONFIG_NODE* node, bool intern);
+SLCONFIG_MEMORY_STATS slc_get_memory_stats(const SLCONFIG_NODE* node);
+SLCONFIG_MEMORY_STATS slc_get_node_memory_stats(const SLCONFIG_NODE* node);
+
+/* Concurrency */
+bool slc_set_concurrent(SLCONFIG_NODE* node, bool concurrent);
+void slc_reclaim(SLCONFIG_NODE* node);
+bool slc_begin_read(SLCONFIG_NODE* node);
+void slc_end_read(SLCONFIG_NODE* node);
 
 /* String handling */
 size_t slc_string_length(SLCONFIG_STRING str);
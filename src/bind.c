@@ -0,0 +1,533 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "slconfig/slconfig.h"
+#include "slconfig/internal/slconfig.h"
+#include "slconfig/internal/tokenizer.h"
+#include "slconfig/internal/number.h"
+#include "slconfig/internal/utils.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define NO_NODE ((size_t)-1)
+
+/*
+ * A plan is a trie of the binding paths. The children of every trie node are stored contiguously and sorted by name
+ * so that they can be matched against the children of an aggregate with a binary search.
+ */
+typedef struct
+{
+	SLCONFIG_STRING name;
+	size_t first_child;
+	size_t num_children;
+	size_t binding;
+} PLAN_NODE;
+
+typedef struct
+{
+	SLCONFIG_BIND_TYPE type;
+	size_t offset;
+	SLCONFIG_STRING path;
+	bool has_default;
+	int64_t int64_default;
+	double double_default;
+	bool bool_default;
+	SLCONFIG_STRING string_default;
+} PLAN_BINDING;
+
+struct SLCONFIG_BIND_PLAN
+{
+	SLCONFIG_VTABLE vtable;
+	
+	PLAN_NODE* nodes;
+	size_t num_nodes;
+	
+	PLAN_BINDING* bindings;
+	size_t num_bindings;
+};
+
+/* The trie while it is being built, before it is flattened into PLAN_NODEs */
+typedef struct
+{
+	SLCONFIG_STRING name;
+	size_t first_child;
+	size_t next_sibling;
+	size_t binding;
+} BUILD_NODE;
+
+static
+int compare_build_nodes(const void* a, const void* b)
+{
+	return _slc_string_compare((*(const BUILD_NODE* const*)a)->name, (*(const BUILD_NODE* const*)b)->name);
+}
+
+static
+const char* type_name(SLCONFIG_BIND_TYPE type)
+{
+	switch(type)
+	{
+		case SLCONFIG_BIND_INT64:
+			return "an integer";
+		case SLCONFIG_BIND_DOUBLE:
+			return "a number";
+		case SLCONFIG_BIND_BOOL:
+			return "a boolean";
+		default:
+			return "a string";
+	}
+}
+
+static
+void binding_error(SLCONFIG_VTABLE* vtable, const char* prefix, SLCONFIG_STRING path, const char* suffix)
+{
+	vtable->error(slc_from_c_str(prefix));
+	vtable->error(path);
+	vtable->error(slc_from_c_str(suffix));
+}
+
+/* Decodes the default value of a binding at plan creation time, so binding never has to */
+static
+bool parse_default(SLCONFIG_VTABLE* vtable, PLAN_BINDING* binding, const char* default_value)
+{
+	binding->has_default = default_value != NULL;
+	if(!binding->has_default)
+		return true;
+	
+	SLCONFIG_STRING str = slc_from_c_str(default_value);
+	bool ret;
+	switch(binding->type)
+	{
+		case SLCONFIG_BIND_INT64:
+			ret = _slc_parse_int64(str, &binding->int64_default);
+			break;
+		case SLCONFIG_BIND_DOUBLE:
+			ret = _slc_parse_double(str, &binding->double_default);
+			break;
+		case SLCONFIG_BIND_BOOL:
+			ret = _slc_parse_bool(str, &binding->bool_default);
+			break;
+		case SLCONFIG_BIND_STRING:
+			binding->string_default = str;
+			ret = true;
+			break;
+		default:
+			vtable->error(slc_from_c_str("Error: Invalid binding type for '"));
+			vtable->error(binding->path);
+			vtable->error(slc_from_c_str("'.\n"));
+			return false;
+	}
+	
+	if(!ret)
+	{
+		vtable->error(slc_from_c_str("Error: Default value '"));
+		vtable->error(str);
+		vtable->error(slc_from_c_str("' of '"));
+		vtable->error(binding->path);
+		vtable->error(slc_from_c_str("' is not "));
+		vtable->error(slc_from_c_str(type_name(binding->type)));
+		vtable->error(slc_from_c_str(".\n"));
+	}
+	return ret;
+}
+
+static
+size_t add_build_node(SLCONFIG_VTABLE* vtable, BUILD_NODE** nodes, size_t* num_nodes, size_t parent, SLCONFIG_STRING name)
+{
+	*nodes = vtable->realloc(*nodes, (*num_nodes + 1) * sizeof(BUILD_NODE));
+	BUILD_NODE* node = &(*nodes)[*num_nodes];
+	node->name.start = node->name.end = NULL;
+	slc_append_to_string(&node->name, name, vtable->realloc);
+	node->first_child = NO_NODE;
+	node->binding = NO_NODE;
+	node->next_sibling = NO_NODE;
+	if(parent != NO_NODE)
+	{
+		node->next_sibling = (*nodes)[parent].first_child;
+		(*nodes)[parent].first_child = *num_nodes;
+	}
+	return (*num_nodes)++;
+}
+
+/*
+ * Inserts a path into the trie. Paths use the reference syntax, except that absolute references are not allowed as
+ * the paths are always relative to the bound aggregate.
+ */
+static
+bool insert_path(SLCONFIG_VTABLE* vtable, BUILD_NODE** nodes, size_t* num_nodes, SLCONFIG_STRING path, size_t binding)
+{
+	TOKENIZER_STATE state;
+	memset(&state, 0, sizeof(TOKENIZER_STATE));
+	state.filename = slc_from_c_str("");
+	state.line = 1;
+	state.vtable = vtable;
+	state.str = path;
+	state.gag_errors = true;
+	
+	size_t cur = 0;
+	bool expect_name = true;
+	while(true)
+	{
+		TOKEN token = _slc_get_next_token(&state);
+		if(expect_name && token.type == TOKEN_STRING)
+		{
+			if((*nodes)[cur].binding != NO_NODE)
+			{
+				binding_error(vtable, "Error: Binding path '", path, "' conflicts with another binding.\n");
+				if(token.own)
+					slc_destroy_string(&token.str, vtable->realloc);
+				return false;
+			}
+			
+			size_t child;
+			for(child = (*nodes)[cur].first_child; child != NO_NODE; child = (*nodes)[child].next_sibling)
+			{
+				if(slc_string_equal((*nodes)[child].name, token.str))
+					break;
+			}
+			if(child == NO_NODE)
+				child = add_build_node(vtable, nodes, num_nodes, cur, token.str);
+			cur = child;
+			
+			if(token.own)
+				slc_destroy_string(&token.str, vtable->realloc);
+			expect_name = false;
+		}
+		else if(!expect_name && token.type == TOKEN_COLON)
+		{
+			expect_name = true;
+		}
+		else if(!expect_name && token.type == TOKEN_EOF)
+		{
+			break;
+		}
+		else
+		{
+			binding_error(vtable, "Error: Invalid binding path '", path, "'.\n");
+			if(token.own)
+				slc_destroy_string(&token.str, vtable->realloc);
+			return false;
+		}
+	}
+	
+	if((*nodes)[cur].binding != NO_NODE)
+	{
+		binding_error(vtable, "Error: Duplicate binding path '", path, "'.\n");
+		return false;
+	}
+	if((*nodes)[cur].first_child != NO_NODE)
+	{
+		binding_error(vtable, "Error: Binding path '", path, "' conflicts with another binding.\n");
+		return false;
+	}
+	
+	(*nodes)[cur].binding = binding;
+	return true;
+}
+
+SLCONFIG_BIND_PLAN* slc_create_bind_plan(const SLCONFIG_BINDING* bindings, size_t num_bindings, const SLCONFIG_VTABLE* vtable_ptr)
+{
+	SLCONFIG_VTABLE vtable;
+	if(vtable_ptr)
+		memcpy(&vtable, vtable_ptr, sizeof(SLCONFIG_VTABLE));
+	else
+		memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	_slc_fill_vtable(&vtable);
+	
+	SLCONFIG_BIND_PLAN* plan = vtable.realloc(0, sizeof(SLCONFIG_BIND_PLAN));
+	memset(plan, 0, sizeof(SLCONFIG_BIND_PLAN));
+	plan->vtable = vtable;
+	plan->num_bindings = num_bindings;
+	if(num_bindings)
+		plan->bindings = vtable.realloc(0, num_bindings * sizeof(PLAN_BINDING));
+	
+	BUILD_NODE* build_nodes = NULL;
+	size_t num_build_nodes = 0;
+	add_build_node(&vtable, &build_nodes, &num_build_nodes, NO_NODE, slc_from_c_str(""));
+	
+	bool ok = true;
+	for(size_t ii = 0; ii < num_bindings && ok; ii++)
+	{
+		PLAN_BINDING* binding = &plan->bindings[ii];
+		binding->type = bindings[ii].type;
+		binding->offset = bindings[ii].offset;
+		binding->path = slc_from_c_str(bindings[ii].path);
+		ok = parse_default(&vtable, binding, bindings[ii].default_value) &&
+		     insert_path(&vtable, &build_nodes, &num_build_nodes, binding->path, ii);
+	}
+	
+	if(ok)
+	{
+		/* Flatten the trie breadth first, so that siblings end up next to each other */
+		const BUILD_NODE** queue = vtable.realloc(0, num_build_nodes * sizeof(BUILD_NODE*));
+		plan->nodes = vtable.realloc(0, num_build_nodes * sizeof(PLAN_NODE));
+		plan->num_nodes = num_build_nodes;
+		
+		size_t queue_size = 1;
+		queue[0] = &build_nodes[0];
+		for(size_t ii = 0; ii < queue_size; ii++)
+		{
+			const BUILD_NODE* build_node = queue[ii];
+			PLAN_NODE* plan_node = &plan->nodes[ii];
+			plan_node->name = build_node->name;
+			plan_node->binding = build_node->binding;
+			plan_node->first_child = queue_size;
+			for(size_t child = build_node->first_child; child != NO_NODE; child = build_nodes[child].next_sibling)
+				queue[queue_size++] = &build_nodes[child];
+			plan_node->num_children = queue_size - plan_node->first_child;
+			qsort(queue + plan_node->first_child, plan_node->num_children, sizeof(BUILD_NODE*), &compare_build_nodes);
+		}
+		
+		vtable.realloc(queue, 0);
+	}
+	else
+	{
+		for(size_t ii = 0; ii < num_build_nodes; ii++)
+			slc_destroy_string(&build_nodes[ii].name, vtable.realloc);
+	}
+	
+	vtable.realloc(build_nodes, 0);
+	
+	if(!ok)
+	{
+		slc_destroy_bind_plan(plan);
+		return NULL;
+	}
+	
+	return plan;
+}
+
+void slc_destroy_bind_plan(SLCONFIG_BIND_PLAN* plan)
+{
+	if(!plan)
+		return;
+	
+	void* (*custom_realloc)(void*, size_t) = plan->vtable.realloc;
+	for(size_t ii = 0; ii < plan->num_nodes; ii++)
+		slc_destroy_string(&plan->nodes[ii].name, custom_realloc);
+	if(plan->nodes)
+		custom_realloc(plan->nodes, 0);
+	if(plan->bindings)
+		custom_realloc(plan->bindings, 0);
+	custom_realloc(plan, 0);
+}
+
+typedef struct
+{
+	const SLCONFIG_BIND_PLAN* plan;
+	char* dest;
+	bool* found;
+	SLCONFIG_NODE* aggregate;
+	CONFIG* config;
+	bool ret;
+} BIND_STATE;
+
+/* Start an error about node, which the caller finishes with _slc_end_error */
+static
+void node_error(BIND_STATE* state, SLCONFIG_ERROR_CODE code, const SLCONFIG_NODE* node, const char* message)
+{
+	_slc_begin_error(state->config, code, slc_from_c_str(""), 0);
+	_slc_error(state->config, slc_from_c_str("Error: '"));
+	_slc_error_full_name(state->config, node);
+	_slc_error(state->config, slc_from_c_str(message));
+	state->ret = false;
+}
+
+static
+void write_default(BIND_STATE* state, const PLAN_BINDING* binding)
+{
+	void* field = state->dest + binding->offset;
+	switch(binding->type)
+	{
+		case SLCONFIG_BIND_INT64:
+			*(int64_t*)field = binding->int64_default;
+			break;
+		case SLCONFIG_BIND_DOUBLE:
+			*(double*)field = binding->double_default;
+			break;
+		case SLCONFIG_BIND_BOOL:
+			*(bool*)field = binding->bool_default;
+			break;
+		case SLCONFIG_BIND_STRING:
+			*(SLCONFIG_STRING*)field = binding->string_default;
+			break;
+	}
+}
+
+/* Fills in the defaults of every binding under a plan node that has no corresponding tree node */
+static
+void bind_missing(BIND_STATE* state, size_t plan_idx, bool report)
+{
+	const PLAN_NODE* plan_node = &state->plan->nodes[plan_idx];
+	if(plan_node->binding != NO_NODE)
+	{
+		const PLAN_BINDING* binding = &state->plan->bindings[plan_node->binding];
+		if(binding->has_default)
+		{
+			write_default(state, binding);
+		}
+		else if(report)
+		{
+			node_error(state, SLCONFIG_ERROR_DOES_NOT_EXIST, state->aggregate, ":");
+			_slc_error(state->config, binding->path);
+			/* The diagnostic is about the missing node, rather than its aggregate */
+			state->config->node_path_end = state->config->error_size;
+			_slc_error(state->config, slc_from_c_str("' does not exist.\n"));
+			_slc_end_error(state->config);
+		}
+		return;
+	}
+	
+	for(size_t ii = 0; ii < plan_node->num_children; ii++)
+		bind_missing(state, plan_node->first_child + ii, report);
+}
+
+static
+void bind_value(BIND_STATE* state, SLCONFIG_NODE* node, const PLAN_BINDING* binding)
+{
+	void* field = state->dest + binding->offset;
+	bool ret = !node->is_aggregate;
+	if(ret)
+	{
+		switch(binding->type)
+		{
+			case SLCONFIG_BIND_INT64:
+				ret = _slc_get_int64(node, (int64_t*)field);
+				break;
+			case SLCONFIG_BIND_DOUBLE:
+				ret = _slc_get_double(node, (double*)field);
+				break;
+			case SLCONFIG_BIND_BOOL:
+				ret = _slc_get_bool(node, (bool*)field);
+				break;
+			case SLCONFIG_BIND_STRING:
+				*(SLCONFIG_STRING*)field = node->value;
+				break;
+		}
+	}
+	
+	if(!ret)
+	{
+		if(node->is_aggregate)
+		{
+			node_error(state, SLCONFIG_ERROR_IS_AGGREGATE, node, "' is an aggregate, expected ");
+		}
+		else
+		{
+			node_error(state, SLCONFIG_ERROR_INVALID_VALUE, node, "' with value '");
+			_slc_error(state->config, node->value);
+			_slc_error(state->config, slc_from_c_str("' is not "));
+		}
+		_slc_error(state->config, slc_from_c_str(type_name(binding->type)));
+		_slc_error(state->config, slc_from_c_str(".\n"));
+		_slc_end_error(state->config);
+		
+		if(binding->has_default)
+			write_default(state, binding);
+	}
+}
+
+static
+size_t find_plan_child(const BIND_STATE* state, const PLAN_NODE* plan_node, SLCONFIG_STRING name)
+{
+	size_t lo = plan_node->first_child;
+	size_t hi = lo + plan_node->num_children;
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = _slc_string_compare(state->plan->nodes[mid].name, name);
+		if(cmp == 0)
+			return mid;
+		else if(cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NO_NODE;
+}
+
+/* Each aggregate is visited at most once, and each of its children is matched against the plan with a binary search */
+static
+void bind_aggregate(BIND_STATE* state, SLCONFIG_NODE* aggregate, size_t plan_idx)
+{
+	const PLAN_NODE* plan_node = &state->plan->nodes[plan_idx];
+	size_t num_found = 0;
+	for(size_t ii = 0; ii < aggregate->num_children && num_found < plan_node->num_children; ii++)
+	{
+		SLCONFIG_NODE* child = aggregate->children[ii];
+		size_t child_idx = find_plan_child(state, plan_node, child->name);
+		if(child_idx == NO_NODE)
+			continue;
+		
+		num_found++;
+		state->found[child_idx] = true;
+		
+		const PLAN_NODE* plan_child = &state->plan->nodes[child_idx];
+		if(plan_child->binding != NO_NODE)
+		{
+			bind_value(state, child, &state->plan->bindings[plan_child->binding]);
+		}
+		else if(child->is_aggregate)
+		{
+			bind_aggregate(state, child, child_idx);
+		}
+		else
+		{
+			node_error(state, SLCONFIG_ERROR_NOT_AGGREGATE, child, "' is not an aggregate.\n");
+			_slc_end_error(state->config);
+			bind_missing(state, child_idx, false);
+		}
+	}
+	
+	if(num_found < plan_node->num_children)
+	{
+		for(size_t ii = 0; ii < plan_node->num_children; ii++)
+		{
+			size_t child_idx = plan_node->first_child + ii;
+			if(!state->found[child_idx])
+				bind_missing(state, child_idx, true);
+		}
+	}
+}
+
+bool slc_bind(SLCONFIG_NODE* aggregate, const SLCONFIG_BIND_PLAN* plan, void* dest)
+{
+	assert(aggregate);
+	assert(plan);
+	assert(aggregate->is_aggregate);
+	if(!aggregate->is_aggregate)
+		return false;
+	
+	BIND_STATE state;
+	state.plan = plan;
+	state.dest = dest;
+	state.aggregate = aggregate;
+	state.config = aggregate->config;
+	state.ret = true;
+	state.found = plan->vtable.realloc(0, plan->num_nodes * sizeof(bool));
+	memset(state.found, 0, plan->num_nodes * sizeof(bool));
+	
+	/* Errors are reported through the config, so the tree is not shared with readers meanwhile */
+	_slc_begin_write(state.config);
+	bind_aggregate(&state, aggregate, 0);
+	_slc_end_write(state.config);
+	
+	plan->vtable.realloc(state.found, 0);
+	return state.ret;
+}
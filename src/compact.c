@@ -0,0 +1,252 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/internal/slconfig.h"
+#include "slconfig/internal/file.h"
+#include "slconfig/internal/utils.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define NO_SLICE ((size_t)-1)
+
+/*
+ * Nodes borrow their names and types, and often their comments, from the loaded files. That keeps every file alive
+ * for as long as the tree, whitespace and all. Compacting copies the borrowed slices into a single pool, which then
+ * replaces the files in CONFIG::files.
+ */
+typedef struct
+{
+	CONFIG* config;
+	/* The files, sorted by their address */
+	SLCONFIG_STRING* files;
+	size_t num_files;
+	/* Every slice that points into one of the files */
+	SLCONFIG_STRING** slices;
+	size_t num_slices;
+	size_t slices_capacity;
+} COMPACTOR;
+
+static
+int compare_files(const void* a, const void* b)
+{
+	uintptr_t a_start = (uintptr_t)((const SLCONFIG_STRING*)a)->start;
+	uintptr_t b_start = (uintptr_t)((const SLCONFIG_STRING*)b)->start;
+	return a_start < b_start ? -1 : a_start > b_start;
+}
+
+static
+bool in_files(const COMPACTOR* compactor, SLCONFIG_STRING str)
+{
+	uintptr_t start = (uintptr_t)str.start;
+	
+	/* Find the last file that starts at or before the slice */
+	size_t lo = 0;
+	size_t hi = compactor->num_files;
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if((uintptr_t)compactor->files[mid].start <= start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	
+	if(lo == 0)
+		return false;
+	return (uintptr_t)str.end <= (uintptr_t)compactor->files[lo - 1].end;
+}
+
+static
+void collect_slice(COMPACTOR* compactor, SLCONFIG_STRING* str, bool own)
+{
+	if(own || !str->start || !in_files(compactor, *str))
+		return;
+	
+	compactor->slices = _slc_grow_stack(compactor->config, compactor->slices, compactor->num_slices, &compactor->slices_capacity, sizeof(SLCONFIG_STRING*));
+	compactor->slices[compactor->num_slices++] = str;
+}
+
+static
+void collect_slices(COMPACTOR* compactor, SLCONFIG_NODE* node)
+{
+	CONFIG* config = compactor->config;
+	SLCONFIG_NODE** stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	
+	stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+	stack[stack_size++] = node;
+	while(stack_size)
+	{
+		SLCONFIG_NODE* cur = stack[--stack_size];
+		collect_slice(compactor, &cur->type, cur->own_type);
+		collect_slice(compactor, &cur->name, cur->own_name);
+		collect_slice(compactor, &cur->value, cur->own_value);
+		collect_slice(compactor, &cur->comment, cur->own_comment);
+		
+		for(size_t ii = 0; ii < cur->num_children; ii++)
+		{
+			/* Nodes of the base of an overlay point into the files of the base */
+			if(cur->children[ii]->parent != cur)
+				continue;
+			stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+			stack[stack_size++] = cur->children[ii];
+		}
+	}
+	_slc_free(config, stack);
+}
+
+/*
+ * Finds the first slice with the same contents as each slice, so that they can share their bytes in the pool.
+ * Returns the size of the pool.
+ */
+static
+size_t intern_slices(COMPACTOR* compactor, size_t* first_slices)
+{
+	CONFIG* config = compactor->config;
+	size_t capacity = 16;
+	while(capacity < 2 * compactor->num_slices)
+		capacity *= 2;
+	size_t mask = capacity - 1;
+	size_t* table = _slc_realloc(config, NULL, capacity * sizeof(size_t));
+	for(size_t ii = 0; ii < capacity; ii++)
+		table[ii] = NO_SLICE;
+	
+	size_t pool_size = 0;
+	for(size_t ii = 0; ii < compactor->num_slices; ii++)
+	{
+		SLCONFIG_STRING str = *compactor->slices[ii];
+		size_t slot = _slc_hash_string(HASH_SEED, str) & mask;
+		for(; table[slot] != NO_SLICE; slot = (slot + 1) & mask)
+		{
+			if(slc_string_equal(*compactor->slices[table[slot]], str))
+				break;
+		}
+		
+		if(table[slot] == NO_SLICE)
+		{
+			table[slot] = ii;
+			pool_size += slc_string_length(str);
+		}
+		first_slices[ii] = table[slot];
+	}
+	
+	_slc_free(config, table);
+	return pool_size;
+}
+
+static
+size_t compact_tree(SLCONFIG_NODE* node, bool intern)
+{
+	CONFIG* config = node->config;
+	
+	/* The nodes shared with the forks and overlays of this tree point into the files, and cannot be rewritten */
+	if(config->refcount > 1)
+		return 0;
+	
+	COMPACTOR compactor;
+	compactor.config = config;
+	compactor.files = NULL;
+	compactor.num_files = 0;
+	compactor.slices = NULL;
+	compactor.num_slices = 0;
+	compactor.slices_capacity = 0;
+	
+	size_t file_bytes = 0;
+	if(config->num_files)
+		compactor.files = _slc_realloc(config, NULL, config->num_files * sizeof(SLCONFIG_STRING));
+	for(size_t ii = 0; ii < config->num_files; ii++)
+	{
+		file_bytes += slc_string_length(config->files[ii]);
+		if(config->files[ii].start)
+			compactor.files[compactor.num_files++] = config->files[ii];
+	}
+	if(compactor.num_files)
+		qsort(compactor.files, compactor.num_files, sizeof(SLCONFIG_STRING), &compare_files);
+	
+	collect_slices(&compactor, config->root);
+	for(size_t ii = 0; ii < config->num_frozen_nodes; ii++)
+		collect_slices(&compactor, config->frozen_nodes[ii]);
+	
+	size_t* first_slices = NULL;
+	size_t pool_size = 0;
+	if(intern && compactor.num_slices)
+	{
+		first_slices = _slc_realloc(config, NULL, compactor.num_slices * sizeof(size_t));
+		pool_size = intern_slices(&compactor, first_slices);
+	}
+	else
+	{
+		for(size_t ii = 0; ii < compactor.num_slices; ii++)
+			pool_size += slc_string_length(*compactor.slices[ii]);
+	}
+	
+	char* pool = pool_size ? _slc_realloc(config, NULL, pool_size) : NULL;
+	char* pos = pool;
+	for(size_t ii = 0; ii < compactor.num_slices; ii++)
+	{
+		SLCONFIG_STRING* str = compactor.slices[ii];
+		/* The first slice with the same contents has already been moved */
+		if(first_slices && first_slices[ii] != ii)
+		{
+			*str = *compactor.slices[first_slices[ii]];
+			continue;
+		}
+		
+		size_t length = slc_string_length(*str);
+		if(length)
+			memcpy(pos, str->start, length);
+		str->start = pos;
+		str->end = pos + length;
+		pos += length;
+	}
+	
+	for(size_t ii = 0; ii < config->num_files; ii++)
+	{
+		if(config->file_caches[ii])
+			_slc_release_cached_file(config->file_caches[ii], config->files[ii]);
+		else
+			slc_destroy_string(&config->files[ii], config->vtable.realloc);
+	}
+	
+	/* The pool takes the place of the files */
+	config->num_files = 0;
+	if(pool)
+	{
+		SLCONFIG_STRING pool_str = {pool, pool + pool_size};
+		config->files[config->num_files] = pool_str;
+		config->file_caches[config->num_files] = NULL;
+		config->num_files++;
+	}
+	
+	_slc_free(config, first_slices);
+	_slc_free(config, compactor.slices);
+	_slc_free(config, compactor.files);
+	return file_bytes > pool_size ? file_bytes - pool_size : 0;
+}
+
+size_t slc_compact(SLCONFIG_NODE* node, bool intern)
+{
+	assert(node);
+	_slc_begin_write(node->config);
+	size_t ret = compact_tree(node, intern);
+	_slc_end_write(node->config);
+	return ret;
+}
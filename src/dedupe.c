@@ -0,0 +1,261 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/internal/slconfig.h"
+#include "slconfig/internal/utils.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define NO_STRING ((size_t)-1)
+
+/*
+ * Only the contents of identical subtrees are shared, not their nodes: merging the nodes would free the ones callers
+ * hold pointers to, and would leave the rest read only, like the nodes shared with a fork. What is deduplicated is the
+ * strings, as every expanded or copied value is a separate allocation. The owned strings are moved into a pool kept by
+ * the config, and duplicates are freed in favour of the pooled copy. The nodes do not own the pooled strings, so
+ * setting a string replaces it rather than modifying it, and appending to a comment copies it first. The pooled
+ * strings that no node uses any more are released when the root is deduplicated.
+ */
+typedef struct
+{
+	CONFIG* config;
+	/* Open addressing table of indices into CONFIG::shared_strings */
+	size_t* table;
+	size_t mask;
+	size_t bytes_saved;
+} DEDUPER;
+
+static
+void insert_shared_string(DEDUPER* deduper, size_t idx)
+{
+	SLCONFIG_STRING str = deduper->config->shared_strings[idx];
+	size_t slot = _slc_hash_string(HASH_SEED, str) & deduper->mask;
+	while(deduper->table[slot] != NO_STRING)
+		slot = (slot + 1) & deduper->mask;
+	deduper->table[slot] = idx;
+}
+
+static
+void rebuild_table(DEDUPER* deduper, size_t capacity)
+{
+	CONFIG* config = deduper->config;
+	deduper->table = config->vtable.realloc(deduper->table, capacity * sizeof(size_t));
+	deduper->mask = capacity - 1;
+	for(size_t ii = 0; ii < capacity; ii++)
+		deduper->table[ii] = NO_STRING;
+	
+	for(size_t ii = 0; ii < config->num_shared_strings; ii++)
+		insert_shared_string(deduper, ii);
+}
+
+/* Replace an owned string with the pooled one with the same contents, moving it into the pool if there is none */
+static
+void share_string(DEDUPER* deduper, SLCONFIG_STRING* str, bool* own)
+{
+	if(!*own || slc_string_length(*str) == 0)
+		return;
+	
+	CONFIG* config = deduper->config;
+	
+	/* Keep the table at most half full */
+	if(2 * (config->num_shared_strings + 1) > deduper->mask + 1)
+		rebuild_table(deduper, 2 * (deduper->mask + 1));
+	
+	size_t slot = _slc_hash_string(HASH_SEED, *str) & deduper->mask;
+	for(; deduper->table[slot] != NO_STRING; slot = (slot + 1) & deduper->mask)
+	{
+		SLCONFIG_STRING shared = config->shared_strings[deduper->table[slot]];
+		if(slc_string_equal(shared, *str))
+		{
+			deduper->bytes_saved += slc_string_length(*str);
+			slc_destroy_string(str, config->vtable.realloc);
+			*str = shared;
+			*own = false;
+			return;
+		}
+	}
+	
+	config->shared_strings = _slc_grow_stack(config, config->shared_strings, config->num_shared_strings, &config->shared_strings_capacity, sizeof(SLCONFIG_STRING));
+	config->shared_strings[config->num_shared_strings] = *str;
+	deduper->table[slot] = config->num_shared_strings;
+	config->num_shared_strings++;
+	*own = false;
+}
+
+static
+int compare_shared_strings(const void* a, const void* b)
+{
+	const char* a_start = ((const SLCONFIG_STRING*)a)->start;
+	const char* b_start = ((const SLCONFIG_STRING*)b)->start;
+	return (a_start > b_start) - (a_start < b_start);
+}
+
+/* Marks the pooled string (if any) that str points to as used, the pool being sorted by the start pointer */
+static
+void mark_shared_string(CONFIG* config, bool* used, SLCONFIG_STRING str, bool own)
+{
+	if(own || str.start == NULL)
+		return;
+	
+	size_t lo = 0;
+	size_t hi = config->num_shared_strings;
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		const char* start = config->shared_strings[mid].start;
+		if(start == str.start)
+		{
+			used[mid] = true;
+			return;
+		}
+		else if(start < str.start)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+}
+
+static
+void mark_tree(CONFIG* config, bool* used, SLCONFIG_NODE*** stack, size_t* stack_capacity, SLCONFIG_NODE* node)
+{
+	size_t stack_size = 0;
+	*stack = _slc_grow_stack(config, *stack, stack_size, stack_capacity, sizeof(SLCONFIG_NODE*));
+	(*stack)[stack_size++] = node;
+	while(stack_size)
+	{
+		SLCONFIG_NODE* cur = (*stack)[--stack_size];
+		mark_shared_string(config, used, cur->type, cur->own_type);
+		mark_shared_string(config, used, cur->name, cur->own_name);
+		mark_shared_string(config, used, cur->value, cur->own_value);
+		mark_shared_string(config, used, cur->comment, cur->own_comment);
+		
+		for(size_t ii = 0; ii < cur->num_children; ii++)
+		{
+			/* Shared children are marked through the tree that holds them */
+			if(cur->children[ii]->parent != cur)
+				continue;
+			*stack = _slc_grow_stack(config, *stack, stack_size, stack_capacity, sizeof(SLCONFIG_NODE*));
+			(*stack)[stack_size++] = cur->children[ii];
+		}
+	}
+}
+
+/* Setters replace pooled strings without freeing them, so the ones no node uses any more are released here */
+static
+size_t release_unused_strings(CONFIG* config)
+{
+	if(config->num_shared_strings == 0)
+		return 0;
+	
+	qsort(config->shared_strings, config->num_shared_strings, sizeof(SLCONFIG_STRING), compare_shared_strings);
+	bool* used = _slc_realloc(config, NULL, config->num_shared_strings * sizeof(bool));
+	for(size_t ii = 0; ii < config->num_shared_strings; ii++)
+		used[ii] = false;
+	
+	SLCONFIG_NODE** stack = NULL;
+	size_t stack_capacity = 0;
+	mark_tree(config, used, &stack, &stack_capacity, config->root);
+	for(size_t ii = 0; ii < config->num_frozen_nodes; ii++)
+		mark_tree(config, used, &stack, &stack_capacity, config->frozen_nodes[ii]);
+	for(size_t ii = 0; ii < config->num_retired_nodes; ii++)
+		mark_tree(config, used, &stack, &stack_capacity, config->retired_nodes[ii]);
+	_slc_free(config, stack);
+	
+	size_t bytes_released = 0;
+	size_t num_used = 0;
+	for(size_t ii = 0; ii < config->num_shared_strings; ii++)
+	{
+		if(used[ii])
+		{
+			config->shared_strings[num_used++] = config->shared_strings[ii];
+		}
+		else
+		{
+			bytes_released += slc_string_length(config->shared_strings[ii]);
+			_slc_retire_string(config, &config->shared_strings[ii]);
+		}
+	}
+	config->num_shared_strings = num_used;
+	
+	_slc_free(config, used);
+	return bytes_released;
+}
+
+static
+size_t dedupe_tree(SLCONFIG_NODE* node)
+{
+	CONFIG* config = node->config;
+	
+	DEDUPER deduper;
+	deduper.config = config;
+	deduper.table = NULL;
+	deduper.bytes_saved = 0;
+	
+	/* Forks and overlays might still use the pooled strings through the nodes they copied */
+	if(node == config->root && config->refcount == 1)
+		deduper.bytes_saved += release_unused_strings(config);
+	
+	size_t capacity = 16;
+	while(capacity < 2 * config->num_shared_strings)
+		capacity *= 2;
+	rebuild_table(&deduper, capacity);
+	
+	SLCONFIG_NODE** stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	
+	stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+	stack[stack_size++] = node;
+	while(stack_size)
+	{
+		SLCONFIG_NODE* cur = stack[--stack_size];
+		share_string(&deduper, &cur->type, &cur->own_type);
+		share_string(&deduper, &cur->name, &cur->own_name);
+		share_string(&deduper, &cur->value, &cur->own_value);
+		share_string(&deduper, &cur->comment, &cur->own_comment);
+		
+		for(size_t ii = 0; ii < cur->num_children; ii++)
+		{
+			/* Strings of the base of an overlay are left alone */
+			if(cur->children[ii]->parent != cur)
+				continue;
+			stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+			stack[stack_size++] = cur->children[ii];
+		}
+	}
+	
+	_slc_free(config, stack);
+	_slc_free(config, deduper.table);
+	return deduper.bytes_saved;
+}
+
+size_t slc_dedupe(SLCONFIG_NODE* node)
+{
+	assert(node);
+	_slc_begin_write(node->config);
+	/* A frozen node is shared with other trees, which might hold on to its strings */
+	size_t ret = _slc_is_frozen(node) ? 0 : dedupe_tree(node);
+	_slc_end_write(node->config);
+	return ret;
+}
@@ -0,0 +1,292 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/internal/file.h"
+#include "slconfig/internal/thread.h"
+#include "slconfig/internal/utils.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Roots that load the same files can share a single copy of each of them. A loaded file is looked up by the path it
+ * was opened with and the hash of its contents, and the contents are compared before the cached copy is used, so a
+ * file that changed on disk gets a new entry. The entries, and the cache itself, are reference counted: every config
+ * that holds a file or uses the cache keeps it alive. The cache has a lock of its own, so that roots used from
+ * different threads can share it.
+ */
+
+#define NO_FILE ((size_t)-1)
+/* Left in the tables by a removed file, so that the probes that went past it still do */
+#define REMOVED_FILE ((size_t)-2)
+
+typedef struct
+{
+	SLCONFIG_STRING path;
+	uint64_t hash;
+	SLCONFIG_STRING contents;
+	size_t refcount;
+} CACHED_FILE;
+
+struct SLCONFIG_FILE_CACHE
+{
+	SLCONFIG_VTABLE vtable;
+	
+	CACHED_FILE* files;
+	size_t num_files;
+	/*
+	 * Open addressing tables of indices into files, keyed by the path and the hash for the loads and by the address of
+	 * the contents for the releases. Both have mask + 1 slots, num_used of which are not NO_FILE
+	 */
+	size_t* by_key;
+	size_t* by_contents;
+	size_t mask;
+	size_t num_used;
+	
+	size_t refcount;
+	/* Guards everything above */
+	MUTEX* mutex;
+};
+
+SLCONFIG_FILE_CACHE* slc_create_file_cache(const SLCONFIG_VTABLE* vtable_ptr)
+{
+	SLCONFIG_VTABLE vtable;
+	if(vtable_ptr)
+		memcpy(&vtable, vtable_ptr, sizeof(SLCONFIG_VTABLE));
+	else
+		memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	_slc_fill_vtable(&vtable);
+	
+	SLCONFIG_FILE_CACHE* cache = vtable.realloc(0, sizeof(SLCONFIG_FILE_CACHE));
+	if(!cache)
+		return NULL;
+	cache->vtable = vtable;
+	cache->files = NULL;
+	cache->num_files = 0;
+	cache->by_key = NULL;
+	cache->by_contents = NULL;
+	cache->mask = 0;
+	cache->num_used = 0;
+	cache->refcount = 1;
+	cache->mutex = _slc_create_mutex(vtable.realloc);
+	if(!cache->mutex)
+	{
+		vtable.realloc(cache, 0);
+		return NULL;
+	}
+	return cache;
+}
+
+void _slc_retain_file_cache(SLCONFIG_FILE_CACHE* cache)
+{
+	_slc_lock_mutex(cache->mutex);
+	cache->refcount++;
+	_slc_unlock_mutex(cache->mutex);
+}
+
+/* Drops a reference while the lock is held, and returns whether it was the last one. The lock is released either way */
+static
+bool release_locked(SLCONFIG_FILE_CACHE* cache)
+{
+	bool last = --cache->refcount == 0;
+	_slc_unlock_mutex(cache->mutex);
+	return last;
+}
+
+static
+void destroy_cache(SLCONFIG_FILE_CACHE* cache)
+{
+	/* Every file holds a reference, so there are none left by now */
+	assert(cache->num_files == 0);
+	if(cache->files)
+		cache->vtable.realloc(cache->files, 0);
+	if(cache->by_key)
+	{
+		cache->vtable.realloc(cache->by_key, 0);
+		cache->vtable.realloc(cache->by_contents, 0);
+	}
+	_slc_destroy_mutex(cache->mutex, cache->vtable.realloc);
+	cache->vtable.realloc(cache, 0);
+}
+
+void _slc_release_file_cache(SLCONFIG_FILE_CACHE* cache)
+{
+	_slc_lock_mutex(cache->mutex);
+	if(release_locked(cache))
+		destroy_cache(cache);
+}
+
+void slc_destroy_file_cache(SLCONFIG_FILE_CACHE* cache)
+{
+	if(!cache)
+		return;
+	_slc_release_file_cache(cache);
+}
+
+size_t slc_get_num_cached_files(const SLCONFIG_FILE_CACHE* cache)
+{
+	assert(cache);
+	_slc_lock_mutex(cache->mutex);
+	size_t ret = cache->num_files;
+	_slc_unlock_mutex(cache->mutex);
+	return ret;
+}
+
+static
+size_t key_slot(const SLCONFIG_FILE_CACHE* cache, SLCONFIG_STRING path, uint64_t hash)
+{
+	return (size_t)_slc_hash_string(hash, path) & cache->mask;
+}
+
+static
+size_t contents_slot(const SLCONFIG_FILE_CACHE* cache, const char* start)
+{
+	SLCONFIG_STRING address = {(const char*)&start, (const char*)&start + sizeof(start)};
+	return (size_t)_slc_hash_string(HASH_SEED, address) & cache->mask;
+}
+
+/* Returns the slot holding the index, which has to be in the table */
+static
+size_t* find_index(size_t* table, size_t mask, size_t slot, size_t idx)
+{
+	while(table[slot] != idx)
+		slot = (slot + 1) & mask;
+	return &table[slot];
+}
+
+static
+void insert_file(SLCONFIG_FILE_CACHE* cache, size_t idx)
+{
+	CACHED_FILE* entry = &cache->files[idx];
+	*find_index(cache->by_key, cache->mask, key_slot(cache, entry->path, entry->hash), NO_FILE) = idx;
+	*find_index(cache->by_contents, cache->mask, contents_slot(cache, entry->contents.start), NO_FILE) = idx;
+	cache->num_used++;
+}
+
+/* Sized for the files there are and one more, which also clears out the removed ones */
+static
+void rebuild_tables(SLCONFIG_FILE_CACHE* cache)
+{
+	size_t capacity = 16;
+	while(capacity < 2 * (cache->num_files + 1))
+		capacity *= 2;
+	
+	cache->by_key = cache->vtable.realloc(cache->by_key, capacity * sizeof(size_t));
+	cache->by_contents = cache->vtable.realloc(cache->by_contents, capacity * sizeof(size_t));
+	cache->mask = capacity - 1;
+	cache->num_used = 0;
+	for(size_t ii = 0; ii < capacity; ii++)
+		cache->by_key[ii] = cache->by_contents[ii] = NO_FILE;
+	
+	for(size_t ii = 0; ii < cache->num_files; ii++)
+		insert_file(cache, ii);
+}
+
+/* The last file takes the place of the removed one */
+static
+void remove_file(SLCONFIG_FILE_CACHE* cache, size_t idx)
+{
+	CACHED_FILE* entry = &cache->files[idx];
+	*find_index(cache->by_key, cache->mask, key_slot(cache, entry->path, entry->hash), idx) = REMOVED_FILE;
+	*find_index(cache->by_contents, cache->mask, contents_slot(cache, entry->contents.start), idx) = REMOVED_FILE;
+	
+	size_t last = --cache->num_files;
+	if(idx != last)
+	{
+		CACHED_FILE* moved = &cache->files[last];
+		*find_index(cache->by_key, cache->mask, key_slot(cache, moved->path, moved->hash), last) = idx;
+		*find_index(cache->by_contents, cache->mask, contents_slot(cache, moved->contents.start), last) = idx;
+		*entry = *moved;
+	}
+}
+
+SLCONFIG_STRING _slc_cache_file(SLCONFIG_FILE_CACHE* cache, CONFIG* config, SLCONFIG_STRING path, SLCONFIG_STRING file)
+{
+	uint64_t hash = _slc_hash_string(HASH_SEED, file);
+	_slc_lock_mutex(cache->mutex);
+	
+	/* Keep the tables at most half full, counting the removed files */
+	if(2 * (cache->num_used + 1) > cache->mask + 1)
+		rebuild_tables(cache);
+	
+	for(size_t slot = key_slot(cache, path, hash); cache->by_key[slot] != NO_FILE; slot = (slot + 1) & cache->mask)
+	{
+		if(cache->by_key[slot] == REMOVED_FILE)
+			continue;
+		CACHED_FILE* entry = &cache->files[cache->by_key[slot]];
+		if(entry->hash == hash && slc_string_equal(entry->path, path) && slc_string_equal(entry->contents, file))
+		{
+			entry->refcount++;
+			cache->refcount++;
+			SLCONFIG_STRING contents = entry->contents;
+			_slc_unlock_mutex(cache->mutex);
+			slc_destroy_string(&file, config->vtable.realloc);
+			return contents;
+		}
+	}
+	
+	cache->files = cache->vtable.realloc(cache->files, (cache->num_files + 1) * sizeof(CACHED_FILE));
+	CACHED_FILE* entry = &cache->files[cache->num_files];
+	entry->path.start = entry->path.end = NULL;
+	slc_append_to_string(&entry->path, path, cache->vtable.realloc);
+	entry->hash = hash;
+	entry->refcount = 1;
+	cache->refcount++;
+	
+	/* The cache outlives the config, so the file has to come from its allocator */
+	if(cache->vtable.realloc == config->vtable.realloc)
+	{
+		entry->contents = file;
+	}
+	else
+	{
+		entry->contents.start = entry->contents.end = NULL;
+		slc_append_to_string(&entry->contents, file, cache->vtable.realloc);
+		slc_destroy_string(&file, config->vtable.realloc);
+	}
+	insert_file(cache, cache->num_files++);
+	SLCONFIG_STRING contents = entry->contents;
+	_slc_unlock_mutex(cache->mutex);
+	return contents;
+}
+
+void _slc_release_cached_file(SLCONFIG_FILE_CACHE* cache, SLCONFIG_STRING file)
+{
+	_slc_lock_mutex(cache->mutex);
+	size_t slot = contents_slot(cache, file.start);
+	for(; cache->by_contents[slot] != NO_FILE; slot = (slot + 1) & cache->mask)
+	{
+		size_t idx = cache->by_contents[slot];
+		if(idx != REMOVED_FILE && cache->files[idx].contents.start == file.start)
+			break;
+	}
+	assert(cache->by_contents[slot] != NO_FILE);
+	
+	size_t idx = cache->by_contents[slot];
+	CACHED_FILE* entry = &cache->files[idx];
+	if(--entry->refcount == 0)
+	{
+		CACHED_FILE removed = *entry;
+		remove_file(cache, idx);
+		slc_destroy_string(&removed.path, cache->vtable.realloc);
+		slc_destroy_string(&removed.contents, cache->vtable.realloc);
+	}
+	if(release_locked(cache))
+		destroy_cache(cache);
+}
@@ -0,0 +1,166 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/slconfig.h"
+#include "slconfig/internal/slconfig.h"
+
+#include <string.h>
+#include <assert.h>
+
+static
+void fill_node(SLCONFIG_NODE* node, SLCONFIG_NODE** dest_node, SLCONFIG_STRING* name, SLCONFIG_STRING* type, SLCONFIG_STRING* value, bool* is_aggregate)
+{
+	*dest_node = node;
+	*name = node->name;
+	*type = node->type;
+	*value = node->value;
+	*is_aggregate = node->is_aggregate;
+}
+
+void slc_iter_begin(SLCONFIG_ITER* iter, SLCONFIG_NODE* aggregate)
+{
+	assert(iter);
+	assert(aggregate);
+	memset(iter, 0, sizeof(SLCONFIG_ITER));
+	/* String nodes have no children to iterate over */
+	iter->aggregate = aggregate->is_aggregate ? aggregate : NULL;
+}
+
+bool slc_iter_next(SLCONFIG_ITER* iter)
+{
+	SLCONFIG_NODE* aggregate = iter->aggregate;
+	if(!aggregate)
+		return false;
+	
+	_slc_begin_read(aggregate->config);
+	bool ret = iter->next < aggregate->num_children;
+	if(ret)
+	{
+		iter->index = iter->next++;
+		fill_node(aggregate->children[iter->index], &iter->node, &iter->name, &iter->type, &iter->value, &iter->is_aggregate);
+	}
+	_slc_end_read(aggregate->config);
+	return ret;
+}
+
+static
+SLCONFIG_WALK_FRAME* get_frames(SLCONFIG_WALKER* walker)
+{
+	return walker->heap_frames ? walker->heap_frames : walker->inline_frames;
+}
+
+/* Only trees deeper than the inline frames allocate, doubling the frames each time */
+static
+void push_frame(SLCONFIG_WALKER* walker, SLCONFIG_NODE* aggregate)
+{
+	if(walker->num_frames == walker->frames_capacity)
+	{
+		CONFIG* config = walker->start->config;
+		size_t new_capacity = walker->frames_capacity * 2;
+		SLCONFIG_WALK_FRAME* frames = _slc_realloc(config, walker->heap_frames, new_capacity * sizeof(SLCONFIG_WALK_FRAME));
+		if(!walker->heap_frames)
+			memcpy(frames, walker->inline_frames, walker->num_frames * sizeof(SLCONFIG_WALK_FRAME));
+		walker->heap_frames = frames;
+		walker->frames_capacity = new_capacity;
+	}
+	
+	SLCONFIG_WALK_FRAME* frame = &get_frames(walker)[walker->num_frames++];
+	frame->aggregate = aggregate;
+	frame->next = 0;
+}
+
+void slc_walk_begin(SLCONFIG_WALKER* walker, SLCONFIG_NODE* node)
+{
+	assert(walker);
+	assert(node);
+	memset(walker, 0, sizeof(SLCONFIG_WALKER));
+	walker->start = node;
+	walker->frames_capacity = SLCONFIG_WALK_INLINE_DEPTH;
+}
+
+bool slc_walk_next(SLCONFIG_WALKER* walker)
+{
+	CONFIG* config = walker->start->config;
+	SLCONFIG_NODE* node;
+	_slc_begin_read(config);
+	
+	if(!walker->started)
+	{
+		walker->started = true;
+		node = walker->start;
+	}
+	else if(walker->num_frames)
+	{
+		SLCONFIG_WALK_FRAME* frame = &get_frames(walker)[walker->num_frames - 1];
+		if(frame->next < frame->aggregate->num_children)
+		{
+			node = frame->aggregate->children[frame->next++];
+		}
+		else
+		{
+			walker->num_frames--;
+			walker->event = SLCONFIG_WALK_LEAVE;
+			walker->depth = walker->num_frames;
+			fill_node(frame->aggregate, &walker->node, &walker->name, &walker->type, &walker->value, &walker->is_aggregate);
+			_slc_end_read(config);
+			return true;
+		}
+	}
+	else
+	{
+		_slc_end_read(config);
+		slc_walk_end(walker);
+		return false;
+	}
+	
+	walker->depth = walker->num_frames;
+	if(node->is_aggregate)
+	{
+		walker->event = SLCONFIG_WALK_ENTER;
+		push_frame(walker, node);
+	}
+	else
+	{
+		walker->event = SLCONFIG_WALK_VALUE;
+	}
+	fill_node(node, &walker->node, &walker->name, &walker->type, &walker->value, &walker->is_aggregate);
+	_slc_end_read(config);
+	return true;
+}
+
+void slc_walk_skip(SLCONFIG_WALKER* walker)
+{
+	assert(walker->num_frames);
+	assert(walker->event == SLCONFIG_WALK_ENTER);
+	if(walker->event != SLCONFIG_WALK_ENTER || !walker->num_frames)
+		return;
+	
+	/* The aggregate was just entered, so it is on top of the frames */
+	SLCONFIG_WALK_FRAME* frame = &get_frames(walker)[walker->num_frames - 1];
+	frame->next = (size_t)-1;
+}
+
+void slc_walk_end(SLCONFIG_WALKER* walker)
+{
+	if(walker->heap_frames)
+		_slc_free(walker->start->config, walker->heap_frames);
+	walker->heap_frames = NULL;
+	walker->num_frames = 0;
+	walker->frames_capacity = SLCONFIG_WALK_INLINE_DEPTH;
+}
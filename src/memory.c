@@ -0,0 +1,136 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/internal/slconfig.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Memory usage is worked out from the tree on demand rather than tracked as it is allocated, so nothing is paid for
+ * it until it is asked for. The sizes are those requested from the vtable, without the overhead of the allocator.
+ */
+
+static
+size_t owned_length(SLCONFIG_STRING str, bool own)
+{
+	return own ? slc_string_length(str) : 0;
+}
+
+static
+void add_node_memory(const CONFIG* config, const SLCONFIG_NODE* node, SLCONFIG_MEMORY_STATS* stats)
+{
+	const SLCONFIG_NODE** stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	
+	stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+	stack[stack_size++] = node;
+	while(stack_size)
+	{
+		const SLCONFIG_NODE* cur = stack[--stack_size];
+		stats->nodes += sizeof(SLCONFIG_NODE);
+		stats->children += cur->num_children * sizeof(SLCONFIG_NODE*);
+		stats->types += owned_length(cur->type, cur->own_type);
+		stats->names += owned_length(cur->name, cur->own_name);
+		stats->values += owned_length(cur->value, cur->own_value);
+		stats->comments += owned_length(cur->comment, cur->own_comment);
+		
+		for(size_t ii = 0; ii < cur->num_children; ii++)
+		{
+			/* Nodes shared with the base of an overlay are accounted for by the base */
+			if(cur->children[ii]->parent != cur)
+				continue;
+			stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+			stack[stack_size++] = cur->children[ii];
+		}
+	}
+	config->vtable.realloc(stack, 0);
+}
+
+static
+void sum_memory(SLCONFIG_MEMORY_STATS* stats)
+{
+	stats->total = stats->nodes + stats->children + stats->types + stats->names + stats->values + stats->comments
+	             + stats->files + stats->shared_strings + stats->bookkeeping;
+}
+
+SLCONFIG_MEMORY_STATS slc_get_memory_stats(const SLCONFIG_NODE* node)
+{
+	assert(node);
+	const CONFIG* config = node->config;
+	SLCONFIG_MEMORY_STATS stats;
+	memset(&stats, 0, sizeof(SLCONFIG_MEMORY_STATS));
+	_slc_begin_read(config);
+	
+	add_node_memory(config, config->root, &stats);
+	for(size_t ii = 0; ii < config->num_frozen_nodes; ii++)
+		add_node_memory(config, config->frozen_nodes[ii], &stats);
+	for(size_t ii = 0; ii < config->num_retired_nodes; ii++)
+		add_node_memory(config, config->retired_nodes[ii], &stats);
+	
+	for(size_t ii = 0; ii < config->num_files; ii++)
+		stats.files += slc_string_length(config->files[ii]);
+	
+	stats.shared_strings += config->shared_strings_capacity * sizeof(SLCONFIG_STRING);
+	for(size_t ii = 0; ii < config->num_shared_strings; ii++)
+		stats.shared_strings += slc_string_length(config->shared_strings[ii]);
+	
+	stats.bookkeeping += sizeof(CONFIG);
+	stats.bookkeeping += config->num_files * (sizeof(SLCONFIG_STRING) + sizeof(SLCONFIG_FILE_CACHE*));
+	stats.bookkeeping += config->num_frozen_nodes * sizeof(SLCONFIG_NODE*);
+	stats.bookkeeping += config->num_observers * sizeof(OBSERVER);
+	stats.bookkeeping += config->error_capacity;
+	stats.bookkeeping += config->num_includes * (sizeof(SLCONFIG_STRING) + sizeof(size_t) + sizeof(bool));
+	for(size_t ii = 0; ii < config->num_includes; ii++)
+		stats.bookkeeping += owned_length(config->include_list[ii], config->include_ownerships[ii]);
+	stats.bookkeeping += config->num_search_dirs * (sizeof(SLCONFIG_STRING) + sizeof(bool));
+	for(size_t ii = 0; ii < config->num_search_dirs; ii++)
+		stats.bookkeeping += owned_length(config->search_dirs[ii], config->search_dir_ownerships[ii]);
+	if(config->num_filter_paths)
+	{
+		size_t num_filter_names = config->filter_starts[config->num_filter_paths];
+		stats.bookkeeping += num_filter_names * sizeof(SLCONFIG_STRING) + (config->num_filter_paths + 1) * sizeof(size_t);
+		for(size_t ii = 0; ii < num_filter_names; ii++)
+			stats.bookkeeping += slc_string_length(config->filter_names[ii]);
+	}
+	stats.bookkeeping += config->num_load_stats * sizeof(SLCONFIG_LOAD_STATS);
+	for(size_t ii = 0; ii < config->num_load_stats; ii++)
+		stats.bookkeeping += slc_string_length(config->load_stats[ii].filename);
+	stats.bookkeeping += config->num_retired_nodes * sizeof(SLCONFIG_NODE*);
+	stats.bookkeeping += config->num_retired_strings * sizeof(SLCONFIG_STRING);
+	for(size_t ii = 0; ii < config->num_retired_strings; ii++)
+		stats.bookkeeping += slc_string_length(config->retired_strings[ii]);
+	
+	_slc_end_read(config);
+	sum_memory(&stats);
+	return stats;
+}
+
+SLCONFIG_MEMORY_STATS slc_get_node_memory_stats(const SLCONFIG_NODE* node)
+{
+	assert(node);
+	SLCONFIG_MEMORY_STATS stats;
+	memset(&stats, 0, sizeof(SLCONFIG_MEMORY_STATS));
+	_slc_begin_read(node->config);
+	add_node_memory(node->config, node, &stats);
+	_slc_end_read(node->config);
+	sum_memory(&stats);
+	return stats;
+}
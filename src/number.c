@@ -0,0 +1,776 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "slconfig/internal/number.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Every power of ten up to this one is exactly representable as a double */
+#define MAX_EXACT_POWER (22)
+/* Largest integer such that it and every smaller integer is exactly representable as a double */
+#define MAX_EXACT_MANTISSA ((uint64_t)1 << 53)
+/* Number of decimal digits that always fit into a uint64_t */
+#define MAX_MANTISSA_DIGITS (19)
+/* Number of decimal digits that always fit into an int64_t */
+#define MAX_INT64_DIGITS (18)
+
+static const double powers_of_ten[MAX_EXACT_POWER + 1] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static
+bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static
+bool equal_ignore_case(const char* str, size_t len, const char* lower)
+{
+	if(strlen(lower) != len)
+		return false;
+	for(size_t ii = 0; ii < len; ii++)
+	{
+		char c = str[ii];
+		if(c >= 'A' && c <= 'Z')
+			c = c - 'A' + 'a';
+		if(c != lower[ii])
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Loads 8 characters so that the first one ends up in the lowest byte, regardless of the endianness. Compilers turn
+ * this into a single load on little endian machines.
+ */
+static
+uint64_t load_8_chars(const char* p)
+{
+	uint64_t ret = 0;
+	for(size_t ii = 0; ii < 8; ii++)
+		ret |= (uint64_t)(unsigned char)p[ii] << (8 * ii);
+	return ret;
+}
+
+static
+bool are_8_digits(uint64_t chars)
+{
+	/* The high nibble of every byte must be 3, and adding 6 to the low nibble must not carry out of it */
+	return (chars & 0xF0F0F0F0F0F0F0F0ull) == 0x3030303030303030ull
+	    && ((chars + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) == 0x3030303030303030ull;
+}
+
+/*
+ * Converts 8 digits in a register by combining adjacent pairs of digits, then of pairs, then of quads
+ */
+static
+uint64_t parse_8_digits(uint64_t chars)
+{
+	uint64_t val = chars - 0x3030303030303030ull;
+	val = (val * 10 + (val >> 8)) & 0x00FF00FF00FF00FFull;
+	val = (val * 100 + (val >> 16)) & 0x0000FFFF0000FFFFull;
+	return (val * 10000 + (val >> 32)) & 0xFFFFFFFFull;
+}
+
+bool _slc_parse_int64(SLCONFIG_STRING str, int64_t* value)
+{
+	const char* p = str.start;
+	bool negative = false;
+	
+	if(p < str.end && (*p == '+' || *p == '-'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+	
+	if(p >= str.end)
+		return false;
+	
+	uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+	uint64_t ret = 0;
+	
+	/* Eight digits at a time, while the result is too short to overflow */
+	const char* digits_start = p;
+	while(str.end - p >= 8 && p - digits_start + 8 <= MAX_INT64_DIGITS)
+	{
+		uint64_t chars = load_8_chars(p);
+		if(!are_8_digits(chars))
+			break;
+		ret = ret * 100000000 + parse_8_digits(chars);
+		p += 8;
+	}
+	
+	for(; p < str.end; p++)
+	{
+		unsigned digit = (unsigned)(unsigned char)*p - '0';
+		if(digit > 9)
+			return false;
+		if(ret > (limit - digit) / 10)
+			return false;
+		ret = ret * 10 + digit;
+	}
+	
+	if(negative)
+		*value = ret == 0 ? 0 : -(int64_t)(ret - 1) - 1;
+	else
+		*value = (int64_t)ret;
+	return true;
+}
+
+/*
+ * Exact decimal arithmetic for the cases the fast paths cannot round correctly. The digits are kept most significant
+ * first, and the value is 0.d[0]d[1]... * 10^decimal_point. Multiplying and dividing by powers of two is exact as long
+ * as the digits fit, and the digits of any double do. This does not depend on the locale, unlike strtod and printf.
+ */
+#define MAX_DECIMAL_DIGITS (800)
+/* Largest shift done at once, so that the shifted digits fit into a uint64_t along with the carry */
+#define MAX_SHIFT (60)
+#define MANTISSA_BITS (52)
+#define EXPONENT_BITS (11)
+#define EXPONENT_BIAS (-1023)
+
+typedef struct
+{
+	char digits[MAX_DECIMAL_DIGITS];
+	int num_digits;
+	int decimal_point;
+	/* Whether non-zero digits past the last kept one were dropped */
+	bool truncated;
+} DECIMAL;
+
+static
+void trim_decimal(DECIMAL* decimal)
+{
+	while(decimal->num_digits > 0 && decimal->digits[decimal->num_digits - 1] == '0')
+		decimal->num_digits--;
+	if(decimal->num_digits == 0)
+		decimal->decimal_point = 0;
+}
+
+static
+void assign_decimal(DECIMAL* decimal, uint64_t value)
+{
+	char buf[NUMBER_BUFFER_SIZE];
+	int len = 0;
+	for(; value; value /= 10)
+		buf[len++] = '0' + value % 10;
+	
+	decimal->num_digits = 0;
+	while(len)
+		decimal->digits[decimal->num_digits++] = buf[--len];
+	decimal->decimal_point = decimal->num_digits;
+	decimal->truncated = false;
+	trim_decimal(decimal);
+}
+
+static
+void left_shift(DECIMAL* decimal, unsigned shift)
+{
+	/* The carry out of the top digit tells how many digits are added */
+	uint64_t carry = 0;
+	for(int ii = decimal->num_digits - 1; ii >= 0; ii--)
+		carry = (carry + ((uint64_t)(decimal->digits[ii] - '0') << shift)) / 10;
+	int num_new_digits = 0;
+	for(; carry; carry /= 10)
+		num_new_digits++;
+	
+	int write = decimal->num_digits + num_new_digits;
+	uint64_t n = 0;
+	for(int ii = decimal->num_digits - 1; ii >= 0; ii--)
+	{
+		n += (uint64_t)(decimal->digits[ii] - '0') << shift;
+		write--;
+		if(write < MAX_DECIMAL_DIGITS)
+			decimal->digits[write] = '0' + n % 10;
+		else if(n % 10)
+			decimal->truncated = true;
+		n /= 10;
+	}
+	for(; n; n /= 10)
+	{
+		write--;
+		if(write < MAX_DECIMAL_DIGITS)
+			decimal->digits[write] = '0' + n % 10;
+		else if(n % 10)
+			decimal->truncated = true;
+	}
+	
+	decimal->num_digits += num_new_digits;
+	if(decimal->num_digits > MAX_DECIMAL_DIGITS)
+		decimal->num_digits = MAX_DECIMAL_DIGITS;
+	decimal->decimal_point += num_new_digits;
+	trim_decimal(decimal);
+}
+
+static
+void right_shift(DECIMAL* decimal, unsigned shift)
+{
+	int read = 0;
+	int write = 0;
+	uint64_t n = 0;
+	
+	/* Read digits until the result has its first one */
+	for(; (n >> shift) == 0; read++)
+	{
+		if(read >= decimal->num_digits)
+		{
+			if(n == 0)
+			{
+				decimal->num_digits = 0;
+				return;
+			}
+			while((n >> shift) == 0)
+			{
+				n *= 10;
+				read++;
+			}
+			break;
+		}
+		n = n * 10 + (decimal->digits[read] - '0');
+	}
+	decimal->decimal_point -= read - 1;
+	
+	uint64_t mask = ((uint64_t)1 << shift) - 1;
+	for(; read < decimal->num_digits; read++)
+	{
+		decimal->digits[write++] = '0' + (char)(n >> shift);
+		n = (n & mask) * 10 + (decimal->digits[read] - '0');
+	}
+	for(; n; n = (n & mask) * 10)
+	{
+		if(write < MAX_DECIMAL_DIGITS)
+			decimal->digits[write++] = '0' + (char)(n >> shift);
+		else if(n >> shift)
+			decimal->truncated = true;
+	}
+	
+	decimal->num_digits = write;
+	trim_decimal(decimal);
+}
+
+/* Multiplies by 2^shift, dividing if it is negative */
+static
+void shift_decimal(DECIMAL* decimal, int shift)
+{
+	if(decimal->num_digits == 0)
+		return;
+	for(; shift > MAX_SHIFT; shift -= MAX_SHIFT)
+		left_shift(decimal, MAX_SHIFT);
+	for(; shift < -MAX_SHIFT; shift += MAX_SHIFT)
+		right_shift(decimal, MAX_SHIFT);
+	if(shift > 0)
+		left_shift(decimal, shift);
+	else if(shift < 0)
+		right_shift(decimal, -shift);
+}
+
+/* Whether keeping the first num_digits digits rounds up, with ties going to the even digit */
+static
+bool should_round_up(const DECIMAL* decimal, int num_digits)
+{
+	if(num_digits < 0 || num_digits >= decimal->num_digits)
+		return false;
+	if(decimal->digits[num_digits] == '5' && num_digits + 1 == decimal->num_digits)
+	{
+		if(decimal->truncated)
+			return true;
+		return num_digits > 0 && (decimal->digits[num_digits - 1] - '0') % 2 == 1;
+	}
+	return decimal->digits[num_digits] >= '5';
+}
+
+static
+void round_decimal(DECIMAL* decimal, int num_digits)
+{
+	if(num_digits < 0 || num_digits >= decimal->num_digits)
+		return;
+	
+	if(!should_round_up(decimal, num_digits))
+	{
+		decimal->num_digits = num_digits;
+		trim_decimal(decimal);
+		return;
+	}
+	
+	for(int ii = num_digits - 1; ii >= 0; ii--)
+	{
+		if(decimal->digits[ii] < '9')
+		{
+			decimal->digits[ii]++;
+			decimal->num_digits = ii + 1;
+			return;
+		}
+	}
+	/* All nines */
+	decimal->digits[0] = '1';
+	decimal->num_digits = 1;
+	decimal->decimal_point++;
+}
+
+/* The integer part, rounded to nearest. The caller makes sure it fits */
+static
+uint64_t rounded_integer(const DECIMAL* decimal)
+{
+	uint64_t ret = 0;
+	int ii = 0;
+	for(; ii < decimal->decimal_point && ii < decimal->num_digits; ii++)
+		ret = ret * 10 + (decimal->digits[ii] - '0');
+	for(; ii < decimal->decimal_point; ii++)
+		ret *= 10;
+	if(should_round_up(decimal, decimal->decimal_point))
+		ret++;
+	return ret;
+}
+
+/* Scales the decimal into [1/2, 1) by powers of two, up to 2^27 at a time */
+static
+int get_power_of_two_shift(int decimal_point)
+{
+	static const int shifts[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+	return decimal_point < (int)(sizeof(shifts) / sizeof(shifts[0])) ? shifts[decimal_point] : 27;
+}
+
+/* Returns false if the value is too large for a double */
+static
+bool decimal_to_double(DECIMAL* decimal, bool negative, double* value)
+{
+	uint64_t mantissa = 0;
+	int exponent = EXPONENT_BIAS;
+	bool overflow = false;
+	
+	if(decimal->num_digits == 0 || decimal->decimal_point < -330)
+		goto done;
+	if(decimal->decimal_point > 310)
+	{
+		overflow = true;
+		goto done;
+	}
+	
+	exponent = 0;
+	while(decimal->decimal_point > 0)
+	{
+		int shift = get_power_of_two_shift(decimal->decimal_point);
+		shift_decimal(decimal, -shift);
+		exponent += shift;
+	}
+	while(decimal->decimal_point < 0 || (decimal->decimal_point == 0 && decimal->digits[0] < '5'))
+	{
+		int shift = get_power_of_two_shift(-decimal->decimal_point);
+		shift_decimal(decimal, shift);
+		exponent -= shift;
+	}
+	
+	/* The value is in [1/2, 1), so the exponent of the leading bit is one less */
+	exponent--;
+	if(exponent < EXPONENT_BIAS + 1)
+	{
+		/* Denormal, the missing bits are shifted out */
+		int shift = EXPONENT_BIAS + 1 - exponent;
+		shift_decimal(decimal, -shift);
+		exponent += shift;
+	}
+	if(exponent - EXPONENT_BIAS >= (1 << EXPONENT_BITS) - 1)
+	{
+		overflow = true;
+		goto done;
+	}
+	
+	shift_decimal(decimal, 1 + MANTISSA_BITS);
+	mantissa = rounded_integer(decimal);
+	/* Rounding up can carry into a new bit */
+	if(mantissa == (uint64_t)2 << MANTISSA_BITS)
+	{
+		mantissa >>= 1;
+		exponent++;
+		if(exponent - EXPONENT_BIAS >= (1 << EXPONENT_BITS) - 1)
+		{
+			overflow = true;
+			goto done;
+		}
+	}
+	if(!(mantissa & ((uint64_t)1 << MANTISSA_BITS)))
+		exponent = EXPONENT_BIAS;
+	
+done:
+	if(overflow)
+		return false;
+	
+	uint64_t bits = mantissa & (((uint64_t)1 << MANTISSA_BITS) - 1);
+	bits |= (uint64_t)((exponent - EXPONENT_BIAS) & ((1 << EXPONENT_BITS) - 1)) << MANTISSA_BITS;
+	if(negative)
+		bits |= (uint64_t)1 << (MANTISSA_BITS + EXPONENT_BITS);
+	memcpy(value, &bits, sizeof(double));
+	return true;
+}
+
+/*
+ * Handles everything the fast path in _slc_parse_double cannot do exactly. The input has already been validated.
+ */
+static
+bool parse_double_slow(SLCONFIG_STRING str, double* value)
+{
+	const char* p = str.start;
+	bool negative = false;
+	if(*p == '+' || *p == '-')
+	{
+		negative = *p == '-';
+		p++;
+	}
+	
+	DECIMAL decimal;
+	decimal.num_digits = 0;
+	decimal.decimal_point = 0;
+	decimal.truncated = false;
+	bool seen_point = false;
+	for(; p < str.end && (is_digit(*p) || *p == '.'); p++)
+	{
+		if(*p == '.')
+		{
+			seen_point = true;
+			decimal.decimal_point = decimal.num_digits;
+		}
+		else if(*p == '0' && decimal.num_digits == 0)
+		{
+			/* Leading zeros only move the decimal point */
+			decimal.decimal_point--;
+		}
+		else if(decimal.num_digits < MAX_DECIMAL_DIGITS)
+		{
+			decimal.digits[decimal.num_digits++] = *p;
+		}
+		else if(*p != '0')
+		{
+			decimal.truncated = true;
+		}
+	}
+	if(!seen_point)
+		decimal.decimal_point = decimal.num_digits;
+	
+	if(p < str.end)
+	{
+		/* The exponent */
+		p++;
+		bool negative_exponent = false;
+		if(*p == '+' || *p == '-')
+		{
+			negative_exponent = *p == '-';
+			p++;
+		}
+		int exponent = 0;
+		for(; p < str.end; p++)
+		{
+			/* Anything this large is going to over/underflow anyway */
+			if(exponent < 100000)
+				exponent = exponent * 10 + (*p - '0');
+		}
+		decimal.decimal_point += negative_exponent ? -exponent : exponent;
+	}
+	trim_decimal(&decimal);
+	
+	return decimal_to_double(&decimal, negative, value);
+}
+
+bool _slc_parse_double(SLCONFIG_STRING str, double* value)
+{
+	const char* p = str.start;
+	const char* end = str.end;
+	bool negative = false;
+	
+	if(p < end && (*p == '+' || *p == '-'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+	
+	if(p >= end)
+		return false;
+	
+	if(!is_digit(*p) && *p != '.')
+	{
+		double special;
+		if(equal_ignore_case(p, end - p, "inf") || equal_ignore_case(p, end - p, "infinity"))
+			special = HUGE_VAL;
+		else if(equal_ignore_case(p, end - p, "nan"))
+			special = NAN;
+		else
+			return false;
+		
+		*value = negative ? -special : special;
+		return true;
+	}
+	
+	uint64_t mantissa = 0;
+	int num_digits = 0;
+	int exponent = 0;
+	bool truncated = false;
+	bool seen_digit = false;
+	
+	for(; p < end && is_digit(*p); p++)
+	{
+		seen_digit = true;
+		if(num_digits < MAX_MANTISSA_DIGITS)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if(mantissa)
+				num_digits++;
+		}
+		else
+		{
+			exponent++;
+			truncated |= *p != '0';
+		}
+	}
+	
+	if(p < end && *p == '.')
+	{
+		p++;
+		for(; p < end && is_digit(*p); p++)
+		{
+			seen_digit = true;
+			if(num_digits < MAX_MANTISSA_DIGITS)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if(mantissa)
+					num_digits++;
+				exponent--;
+			}
+			else
+			{
+				truncated |= *p != '0';
+			}
+		}
+	}
+	
+	if(!seen_digit)
+		return false;
+	
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negative_exponent = false;
+		if(p < end && (*p == '+' || *p == '-'))
+		{
+			negative_exponent = *p == '-';
+			p++;
+		}
+		
+		if(p >= end || !is_digit(*p))
+			return false;
+		
+		int explicit_exponent = 0;
+		for(; p < end && is_digit(*p); p++)
+		{
+			/* Anything this large is going to over/underflow anyway */
+			if(explicit_exponent < 100000)
+				explicit_exponent = explicit_exponent * 10 + (*p - '0');
+		}
+		
+		exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+	}
+	
+	if(p != end)
+		return false;
+	
+	if(mantissa == 0 && !truncated)
+	{
+		*value = negative ? -0.0 : 0.0;
+		return true;
+	}
+	
+	/* Both the mantissa and the power of ten are exact, so a single operation rounds correctly */
+	if(!truncated && mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER)
+	{
+		double ret = (double)mantissa;
+		if(exponent < 0)
+			ret /= powers_of_ten[-exponent];
+		else
+			ret *= powers_of_ten[exponent];
+		
+		*value = negative ? -ret : ret;
+		return true;
+	}
+	
+	return parse_double_slow(str, value);
+}
+
+bool _slc_parse_bool(SLCONFIG_STRING str, bool* value)
+{
+	if(slc_string_equal(str, slc_from_c_str("true")))
+	{
+		*value = true;
+		return true;
+	}
+	else if(slc_string_equal(str, slc_from_c_str("false")))
+	{
+		*value = false;
+		return true;
+	}
+	return false;
+}
+
+size_t _slc_format_int64(int64_t value, char* buf)
+{
+	char digits[NUMBER_BUFFER_SIZE];
+	size_t num_digits = 0;
+	/* Avoids overflow when negating INT64_MIN */
+	uint64_t magnitude = value < 0 ? (uint64_t)-(value + 1) + 1 : (uint64_t)value;
+	
+	do
+	{
+		digits[num_digits++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while(magnitude);
+	
+	size_t len = 0;
+	if(value < 0)
+		buf[len++] = '-';
+	while(num_digits)
+		buf[len++] = digits[--num_digits];
+	buf[len] = '\0';
+	return len;
+}
+
+/* The exact decimal value of a finite, non-zero double */
+static
+void double_to_decimal(double value, DECIMAL* decimal)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(double));
+	int exponent = (int)(bits >> MANTISSA_BITS) & ((1 << EXPONENT_BITS) - 1);
+	uint64_t mantissa = bits & (((uint64_t)1 << MANTISSA_BITS) - 1);
+	if(exponent == 0)
+		exponent++;
+	else
+		mantissa |= (uint64_t)1 << MANTISSA_BITS;
+	exponent += EXPONENT_BIAS;
+	
+	assign_decimal(decimal, mantissa);
+	shift_decimal(decimal, exponent - MANTISSA_BITS);
+}
+
+static
+size_t format_exponent(int exponent, char* buf)
+{
+	size_t len = 0;
+	buf[len++] = 'e';
+	buf[len++] = exponent < 0 ? '-' : '+';
+	if(exponent < 0)
+		exponent = -exponent;
+	/* At least two digits, like printf */
+	if(exponent < 10)
+		buf[len++] = '0';
+	char digits[NUMBER_BUFFER_SIZE];
+	size_t num_digits = 0;
+	do
+	{
+		digits[num_digits++] = '0' + exponent % 10;
+		exponent /= 10;
+	} while(exponent);
+	while(num_digits)
+		buf[len++] = digits[--num_digits];
+	return len;
+}
+
+/*
+ * Formats like printf's %.*g in the C locale: the decimal is rounded to the precision, and written without an exponent
+ * if that is between -4 and the precision. Trailing zeros are dropped, which trimming the decimal has done already
+ */
+static
+size_t format_decimal(DECIMAL decimal, bool negative, int precision, char* buf)
+{
+	round_decimal(&decimal, precision);
+	size_t len = 0;
+	if(negative)
+		buf[len++] = '-';
+	
+	int exponent = decimal.decimal_point - 1;
+	if(exponent < -4 || exponent >= precision)
+	{
+		buf[len++] = decimal.digits[0];
+		if(decimal.num_digits > 1)
+		{
+			buf[len++] = '.';
+			memcpy(buf + len, decimal.digits + 1, decimal.num_digits - 1);
+			len += decimal.num_digits - 1;
+		}
+		len += format_exponent(exponent, buf + len);
+	}
+	else if(decimal.decimal_point <= 0)
+	{
+		buf[len++] = '0';
+		buf[len++] = '.';
+		for(int ii = decimal.decimal_point; ii < 0; ii++)
+			buf[len++] = '0';
+		memcpy(buf + len, decimal.digits, decimal.num_digits);
+		len += decimal.num_digits;
+	}
+	else
+	{
+		for(int ii = 0; ii < decimal.decimal_point; ii++)
+			buf[len++] = ii < decimal.num_digits ? decimal.digits[ii] : '0';
+		if(decimal.num_digits > decimal.decimal_point)
+		{
+			buf[len++] = '.';
+			memcpy(buf + len, decimal.digits + decimal.decimal_point, decimal.num_digits - decimal.decimal_point);
+			len += decimal.num_digits - decimal.decimal_point;
+		}
+	}
+	buf[len] = '\0';
+	return len;
+}
+
+static
+size_t format_special(const char* str, bool negative, char* buf)
+{
+	size_t len = 0;
+	if(negative)
+		buf[len++] = '-';
+	size_t str_len = strlen(str);
+	memcpy(buf + len, str, str_len + 1);
+	return len + str_len;
+}
+
+size_t _slc_format_double(double value, char* buf)
+{
+	bool negative = signbit(value) != 0;
+	if(isnan(value))
+		return format_special("nan", negative, buf);
+	if(isinf(value))
+		return format_special("inf", negative, buf);
+	if(value == 0)
+		return format_special("0", negative, buf);
+	
+	DECIMAL decimal;
+	double_to_decimal(value, &decimal);
+	
+	/* Use the shortest representation that survives the round trip */
+	for(int precision = 15; precision < 17; precision++)
+	{
+		size_t len = format_decimal(decimal, negative, precision, buf);
+		SLCONFIG_STRING str = {buf, buf + len};
+		double parsed;
+		if(_slc_parse_double(str, &parsed) && parsed == value)
+			return len;
+	}
+	return format_decimal(decimal, negative, 17, buf);
+}
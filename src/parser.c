@@ -17,6 +17,7 @@
  */
 
 #include "slconfig/internal/parser.h"
+#include "slconfig/internal/number.h"
 #include "slconfig/internal/tokenizer.h"
 #include "slconfig/internal/utils.h"
 #include "slconfig/internal/slconfig.h"
@@ -26,6 +27,11 @@
 #include <string.h>
 #include <assert.h>
 
+/* At most this many paths are kept by a load filter, so that the ones an aggregate is on fit into a mask */
+#define MAX_FILTER_PATHS (64)
+/* Marks the end of a list of skipped statements */
+#define NO_STATEMENT ((size_t)-1)
+
 /* A wrapper around TOKENIZER_STATE to additionally hold machinery that chomps up the docstrings */
 typedef struct
 {
@@ -40,24 +46,125 @@ typedef struct
 	TOKEN cur_token;
 	SLCONFIG_VTABLE* vtable;
 	bool free_token;
+	
+	/* Input before the current token and its line, where a statement starts if it is skipped */
+	const char* token_start;
+	size_t token_line;
+	/* Whether statements outside of the paths of the load filter are skipped */
+	bool filter;
+	/* The last statement that was skipped, which takes the docstrings after it that are on the line it ends on */
+	size_t last_skipped;
+	size_t last_skipped_line;
+	/* Starts of the statements known not to be skippable, the earliest one last, so that they are not scanned again */
+	const char** unskippable;
+	size_t num_unskippable;
+	size_t unskippable_capacity;
+	/* Starts of the statements opening the blocks that skip_statement is in */
+	const char** scan_starts;
+	size_t scan_starts_capacity;
 } PARSER_STATE;
 
-static bool parse_aggregate(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_STATE* state);
+/*
+ * A statement skipped by a filtered load, which is replayed if its node turns out to be needed after all
+ */
+typedef struct
+{
+	SLCONFIG_STRING name;
+	SLCONFIG_STRING text;
+	SLCONFIG_STRING filename;
+	size_t line;
+	/* Docstring before the statement */
+	SLCONFIG_STRING comment;
+	/* Next statement of the same name in the same aggregate */
+	size_t next;
+	/* Next statement of any name in the same aggregate */
+	size_t next_in_aggregate;
+} SKIPPED_STATEMENT;
+
+/* The statements skipped for a name in an aggregate, in the order they appear in. Pending while first is not NO_STATEMENT */
+typedef struct
+{
+	SLCONFIG_NODE* aggregate;
+	SLCONFIG_STRING name;
+	size_t first;
+	size_t last;
+} SKIPPED_NAME;
+
+/* All the statements skipped in an aggregate, in the order they appear in */
+typedef struct
+{
+	SLCONFIG_NODE* aggregate;
+	size_t first;
+	size_t last;
+} SKIPPED_AGGREGATE;
+
+struct SKIPPED_STATEMENTS
+{
+	SKIPPED_STATEMENT* statements;
+	size_t num_statements;
+	size_t statements_capacity;
+	/* Hash table with linear probing, unused slots have no aggregate. Entries are never removed, only emptied */
+	SKIPPED_NAME* names;
+	size_t names_capacity;
+	size_t num_names;
+	size_t num_pending;
+	/* Hash table like the one of the names */
+	SKIPPED_AGGREGATE* aggregates;
+	size_t aggregates_capacity;
+	size_t num_aggregates;
+	/* Whether a replayed statement failed to parse */
+	bool failed;
+};
+
+/* Where an aggregate is relative to the paths kept by the load filter */
+typedef struct
+{
+	/* The aggregate is on or below a kept path, so nothing in it is skipped */
+	bool keep_all;
+	size_t depth;
+	/* The kept paths going through the aggregate */
+	uint64_t candidates;
+} FILTER_STATUS;
+
+/* The token counts in SLCONFIG_LOAD_STATS are indexed by TOKEN_TYPE */
+typedef char token_types_match[TOKEN_EOF + 1 == SLCONFIG_NUM_TOKEN_TYPES ? 1 : -1];
+
+static
+TOKEN next_token(TOKENIZER_STATE* state)
+{
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(state->config);
+	if(!stats)
+		return _slc_get_next_token(state);
+	
+	uint64_t start_ns = _slc_get_time_ns();
+	TOKEN token = _slc_get_next_token(state);
+	stats->tokenize_ns += _slc_get_time_ns() - start_ns;
+	stats->num_tokens[token.type]++;
+	return token;
+}
 
 /* Wrapper around _slc_get_next_token to chomp up the docstrings and ignore comments. */
 static
 bool advance(PARSER_STATE* state)
 {
-	TOKEN token = _slc_get_next_token(state->state);
+	const char* token_start = state->state->str.start;
+	size_t token_line = state->state->line;
+	TOKEN token = next_token(state->state);
 	while(token.type == TOKEN_COMMENT)
 	{
-		if(token.str.start[0] == '*')
+		if(token.str.start[0] == '*' && state->last_skipped != NO_STATEMENT && state->state->line == state->last_skipped_line)
 		{
+			/* Replaying the statement picks the docstring up, as if it was never skipped */
+			state->state->config->skipped_statements->statements[state->last_skipped].text.end = state->state->str.start;
+		}
+		else if(token.str.start[0] == '*')
+		{
+			state->last_skipped = NO_STATEMENT;
 			SLCONFIG_STRING* str_ptr;
 			if(state->last_node && state->state->line == state->last_node_line)
 			{
 				str_ptr = &state->last_node->comment;
-				state->last_node->own_comment = true;
+				_slc_own_string(state->state->config, str_ptr, &state->last_node->own_comment);
 			}
 			else
 			{
@@ -66,12 +173,16 @@ bool advance(PARSER_STATE* state)
 			}
 			
 			if(slc_string_length(*str_ptr) > 0)
-				slc_append_to_string(str_ptr, slc_from_c_str("\n"), state->vtable->realloc);
+				_slc_append_to_string(state->state->config, str_ptr, slc_from_c_str("\n"));
 			token.str.start++;
-			slc_append_to_string(str_ptr, token.str, state->vtable->realloc);
+			_slc_append_to_string(state->state->config, str_ptr, token.str);
+			if(state->last_node)
+				_slc_touch_node(state->last_node);
 		}
 		
-		token = _slc_get_next_token(state->state);
+		token_start = state->state->str.start;
+		token_line = state->state->line;
+		token = next_token(state->state);
 	}
 	
 	if(state->free_token)
@@ -80,6 +191,8 @@ bool advance(PARSER_STATE* state)
 	state->cur_token = token;
 	state->line = state->state->line;
 	state->free_token = token.own;
+	state->token_start = token_start;
+	state->token_line = token_line;
 
 	if(token.type == TOKEN_ERROR)
 		return false;
@@ -97,43 +210,317 @@ void set_new_node(PARSER_STATE* state, SLCONFIG_NODE* node, size_t line)
 	if(slc_string_length(state->comment))
 	{
 		SLCONFIG_STRING* str_ptr = &node->comment;
-		node->own_comment = true;
+		_slc_own_string(state->state->config, str_ptr, &node->own_comment);
 		if(slc_string_length(*str_ptr) > 0)
-			slc_append_to_string(str_ptr, slc_from_c_str("\n"), state->vtable->realloc);
+			_slc_append_to_string(state->state->config, str_ptr, slc_from_c_str("\n"));
 		
-		slc_append_to_string(str_ptr, state->comment, state->vtable->realloc);
+		_slc_append_to_string(state->state->config, str_ptr, state->comment);
 		state->comment.end = state->comment.start;
+		_slc_touch_node(node);
 	}
 	
 	state->last_node = node;
 	state->last_node_line = line;
+	state->last_skipped = NO_STATEMENT;
+}
+
+static
+bool parse_string(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filename, SLCONFIG_STRING file, size_t line, SLCONFIG_STRING comment, bool filter);
+
+static
+uint64_t hash_aggregate(const SLCONFIG_NODE* aggregate)
+{
+	SLCONFIG_STRING pointer = {(const char*)&aggregate, (const char*)&aggregate + sizeof(aggregate)};
+	return _slc_hash_string(HASH_SEED, pointer);
+}
+
+static
+size_t find_skipped_name(const struct SKIPPED_STATEMENTS* skipped, const SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+{
+	size_t mask = skipped->names_capacity - 1;
+	size_t slot = (size_t)_slc_hash_string(hash_aggregate(aggregate), name) & mask;
+	while(true)
+	{
+		const SKIPPED_NAME* entry = &skipped->names[slot];
+		if(!entry->aggregate || (entry->aggregate == aggregate && slc_string_equal(entry->name, name)))
+			return slot;
+		slot = (slot + 1) & mask;
+	}
+}
+
+/* Make sure there is room for the number of names, without the table being more than half full */
+static
+void reserve_skipped_names(CONFIG* config, struct SKIPPED_STATEMENTS* skipped, size_t num_names)
+{
+	if(2 * num_names <= skipped->names_capacity)
+		return;
+	
+	SKIPPED_NAME* old_names = skipped->names;
+	size_t old_capacity = skipped->names_capacity;
+	size_t new_capacity = old_capacity ? old_capacity : 16;
+	while(2 * num_names > new_capacity)
+		new_capacity *= 2;
+	
+	skipped->names = _slc_realloc(config, NULL, new_capacity * sizeof(SKIPPED_NAME));
+	memset(skipped->names, 0, new_capacity * sizeof(SKIPPED_NAME));
+	skipped->names_capacity = new_capacity;
+	skipped->num_names = 0;
+	/* The emptied entries are left behind */
+	for(size_t ii = 0; ii < old_capacity; ii++)
+	{
+		if(!old_names[ii].aggregate || old_names[ii].first == NO_STATEMENT)
+			continue;
+		skipped->names[find_skipped_name(skipped, old_names[ii].aggregate, old_names[ii].name)] = old_names[ii];
+		skipped->num_names++;
+	}
+	_slc_free(config, old_names);
+}
+
+static
+size_t find_skipped_aggregate(const struct SKIPPED_STATEMENTS* skipped, const SLCONFIG_NODE* aggregate)
+{
+	size_t mask = skipped->aggregates_capacity - 1;
+	size_t slot = (size_t)hash_aggregate(aggregate) & mask;
+	while(skipped->aggregates[slot].aggregate && skipped->aggregates[slot].aggregate != aggregate)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+/* Append a list of skipped statements, linked by next_in_aggregate, to the ones of the aggregate */
+static
+void add_skipped_aggregate(CONFIG* config, SLCONFIG_NODE* aggregate, size_t first, size_t last)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	if(2 * (skipped->num_aggregates + 1) > skipped->aggregates_capacity)
+	{
+		SKIPPED_AGGREGATE* old_aggregates = skipped->aggregates;
+		size_t old_capacity = skipped->aggregates_capacity;
+		skipped->aggregates_capacity = old_capacity ? 2 * old_capacity : 16;
+		skipped->aggregates = _slc_realloc(config, NULL, skipped->aggregates_capacity * sizeof(SKIPPED_AGGREGATE));
+		memset(skipped->aggregates, 0, skipped->aggregates_capacity * sizeof(SKIPPED_AGGREGATE));
+		skipped->num_aggregates = 0;
+		for(size_t ii = 0; ii < old_capacity; ii++)
+		{
+			if(!old_aggregates[ii].aggregate || old_aggregates[ii].first == NO_STATEMENT)
+				continue;
+			skipped->aggregates[find_skipped_aggregate(skipped, old_aggregates[ii].aggregate)] = old_aggregates[ii];
+			skipped->num_aggregates++;
+		}
+		_slc_free(config, old_aggregates);
+	}
+	
+	SKIPPED_AGGREGATE* entry = &skipped->aggregates[find_skipped_aggregate(skipped, aggregate)];
+	if(!entry->aggregate)
+	{
+		entry->aggregate = aggregate;
+		entry->first = NO_STATEMENT;
+		skipped->num_aggregates++;
+	}
+	
+	if(entry->first == NO_STATEMENT)
+		entry->first = first;
+	else
+		skipped->statements[entry->last].next_in_aggregate = first;
+	entry->last = last;
+}
+
+/* Append a list of skipped statements to the ones of the name in the aggregate */
+static
+void add_skipped_statements(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRING name, size_t first, size_t last)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	reserve_skipped_names(config, skipped, skipped->num_names + 1);
+	
+	SKIPPED_NAME* entry = &skipped->names[find_skipped_name(skipped, aggregate, name)];
+	if(!entry->aggregate)
+	{
+		entry->aggregate = aggregate;
+		entry->name = name;
+		entry->first = NO_STATEMENT;
+		skipped->num_names++;
+	}
+	
+	if(entry->first == NO_STATEMENT)
+	{
+		entry->first = first;
+		skipped->num_pending++;
+	}
+	else
+	{
+		skipped->statements[entry->last].next = first;
+	}
+	entry->last = last;
+}
+
+/*
+ * Parse the statements skipped for the name in the aggregate, before the parser looks at the name, so that the parsed
+ * nodes end up as if nothing was skipped
+ */
+static
+void replay_skipped_statements(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	if(!skipped || !skipped->num_pending)
+		return;
+	
+	SKIPPED_NAME* entry = &skipped->names[find_skipped_name(skipped, aggregate, name)];
+	if(!entry->aggregate || entry->first == NO_STATEMENT)
+		return;
+	
+	/* Emptied first, as the replayed statements look their own name up */
+	size_t idx = entry->first;
+	entry->first = NO_STATEMENT;
+	skipped->num_pending--;
+	
+	/* Nothing is skipped while replaying, so the statements stay where they are */
+	for(; idx != NO_STATEMENT; idx = skipped->statements[idx].next)
+	{
+		SKIPPED_STATEMENT* statement = &skipped->statements[idx];
+		SLCONFIG_STRING comment = statement->comment;
+		statement->comment.start = statement->comment.end = NULL;
+		if(!parse_string(config, aggregate, statement->filename, statement->text, statement->line, comment, false))
+			skipped->failed = true;
+	}
+}
+
+/* Forget the skipped statements of the aggregate and of everything below it, as it is about to lose its children */
+static
+void drop_skipped_statements(CONFIG* config, const SLCONFIG_NODE* aggregate)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	if(!skipped || !skipped->num_pending)
+		return;
+	
+	for(size_t ii = 0; ii < skipped->names_capacity; ii++)
+	{
+		SKIPPED_NAME* entry = &skipped->names[ii];
+		if(!entry->aggregate || entry->first == NO_STATEMENT)
+			continue;
+		
+		for(const SLCONFIG_NODE* node = entry->aggregate; node; node = node->parent)
+		{
+			if(node == aggregate)
+			{
+				entry->first = NO_STATEMENT;
+				skipped->num_pending--;
+				break;
+			}
+		}
+	}
+}
+
+/* Move the skipped statements of a temporary node over to the aggregate that took over its children */
+static
+void move_skipped_statements(CONFIG* config, const SLCONFIG_NODE* from, SLCONFIG_NODE* to)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	if(!skipped || !skipped->num_pending)
+		return;
+	
+	SKIPPED_AGGREGATE* entry = &skipped->aggregates[find_skipped_aggregate(skipped, from)];
+	if(!entry->aggregate || entry->first == NO_STATEMENT)
+		return;
+	size_t first = entry->first;
+	size_t last = entry->last;
+	entry->first = NO_STATEMENT;
+	
+	/* Adding to the tables can rebuild them, so their entries are looked up again every time */
+	for(size_t idx = first; idx != NO_STATEMENT; idx = skipped->statements[idx].next_in_aggregate)
+	{
+		SKIPPED_NAME* name = &skipped->names[find_skipped_name(skipped, from, skipped->statements[idx].name)];
+		if(!name->aggregate || name->first == NO_STATEMENT)
+			continue;
+		
+		size_t first_of_name = name->first;
+		name->first = NO_STATEMENT;
+		skipped->num_pending--;
+		add_skipped_statements(config, to, skipped->statements[first_of_name].name, first_of_name, name->last);
+	}
+	add_skipped_aggregate(config, to, first, last);
+}
+
+/* Replay the skipped statements anywhere below the aggregate, before all of it is copied */
+static
+void replay_all_skipped_statements(CONFIG* config, SLCONFIG_NODE* aggregate)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	if(!skipped || !skipped->num_pending)
+		return;
+	
+	SLCONFIG_NODE** stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+	stack[stack_size++] = aggregate;
+	while(stack_size && skipped->num_pending)
+	{
+		SLCONFIG_NODE* node = stack[--stack_size];
+		SKIPPED_AGGREGATE* entry = &skipped->aggregates[find_skipped_aggregate(skipped, node)];
+		if(entry->aggregate && entry->first != NO_STATEMENT)
+		{
+			size_t idx = entry->first;
+			entry->first = NO_STATEMENT;
+			for(; idx != NO_STATEMENT; idx = skipped->statements[idx].next_in_aggregate)
+				replay_skipped_statements(config, node, skipped->statements[idx].name);
+		}
+		
+		for(size_t ii = 0; ii < node->num_children; ii++)
+		{
+			if(!node->children[ii]->is_aggregate)
+				continue;
+			stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+			stack[stack_size++] = node->children[ii];
+		}
+	}
+	_slc_free(config, stack);
+}
+
+/* Lookups done by the parser, which replay the skipped statements of the name first */
+static
+SLCONFIG_NODE* get_node(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRING name, bool writable)
+{
+	replay_skipped_statements(config, aggregate, name);
+	return writable ? _slc_get_own_node(aggregate, name) : _slc_get_node(aggregate, name);
+}
+
+static
+SLCONFIG_NODE* search_node(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRING name, bool writable)
+{
+	for(; aggregate; aggregate = aggregate->parent)
+	{
+		SLCONFIG_NODE* ret = get_node(config, aggregate, name, writable);
+		if(ret)
+			return ret;
+	}
+	return NULL;
 }
 
 /*
- * Parse a node reference statement given the first name in the refence statement
+ * Parse a node reference statement given the first name in the refence statement. If the node is going to be modified,
+ * every node along the way is made to belong to the config being parsed, rather than the base of an overlay
  */
 static
-bool parse_node_ref_name(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRING name, size_t name_line, SLCONFIG_NODE** ref_node, PARSER_STATE* state)
+bool parse_node_ref_name(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRING name, size_t name_line, bool writable, SLCONFIG_NODE** ref_node, PARSER_STATE* state)
 {
-	(void)config;
 	SLCONFIG_NODE* ret = NULL;
 	while(true)
 	{
 		/* The idea here is to prevent going up the hierarchy once we went down one step in it */
 		if(!ret)
-			ret = _slc_search_node(aggregate, name);
+			ret = search_node(config, aggregate, name, writable);
 		else
-			ret = slc_get_node(aggregate, name);
+			ret = get_node(config, aggregate, name, writable);
 		if(!ret)
 		{
-			_slc_print_error_prefix(config, state->filename, name_line, state->vtable);
-			state->vtable->error(slc_from_c_str("Error: '"));
-			SLCONFIG_STRING full_name = slc_get_full_name(aggregate);
-			state->vtable->error(full_name);
-			slc_destroy_string(&full_name, config->vtable.realloc);
-			state->vtable->error(slc_from_c_str(":"));
-			state->vtable->error(name);
-			state->vtable->error(slc_from_c_str("' does not exist.\n"));
+			_slc_begin_error(config, SLCONFIG_ERROR_DOES_NOT_EXIST, state->filename, name_line);
+			_slc_error(config, slc_from_c_str("Error: '"));
+			_slc_error_full_name(config, aggregate);
+			_slc_error(config, slc_from_c_str(":"));
+			_slc_error(config, name);
+			/* The diagnostic is about the missing node, rather than its aggregate */
+			config->node_path_end = config->error_size;
+			_slc_error(config, slc_from_c_str("' does not exist.\n"));
+			_slc_end_error(config);
 			return false;
 		}
 		
@@ -141,14 +528,13 @@ bool parse_node_ref_name(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRI
 		{
 			if(!ret->is_aggregate)
 			{
-				_slc_print_error_prefix(config, state->filename, name_line, state->vtable);
-				state->vtable->error(slc_from_c_str("Error: '"));
-				SLCONFIG_STRING full_name = slc_get_full_name(ret);
-				state->vtable->error(full_name);
-				slc_destroy_string(&full_name, config->vtable.realloc);
-				state->vtable->error(slc_from_c_str("' of type '"));
-				state->vtable->error(ret->type);
-				state->vtable->error(slc_from_c_str("' is not an aggregate.\n"));
+				_slc_begin_error(config, SLCONFIG_ERROR_NOT_AGGREGATE, state->filename, name_line);
+				_slc_error(config, slc_from_c_str("Error: '"));
+				_slc_error_full_name(config, ret);
+				_slc_error(config, slc_from_c_str("' of type '"));
+				_slc_error(config, ret->type);
+				_slc_error(config, slc_from_c_str("' is not an aggregate.\n"));
+				_slc_end_error(config);
 				return false;
 			}
 			aggregate = ret;
@@ -176,7 +562,7 @@ bool parse_node_ref_name(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_STRI
  * Parse a node reference statement
  */
 static
-bool parse_node_ref(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NODE** ref_node, PARSER_STATE* state)
+bool parse_node_ref(CONFIG* config, SLCONFIG_NODE* aggregate, bool writable, SLCONFIG_NODE** ref_node, PARSER_STATE* state)
 {
 	SLCONFIG_STRING name;
 	size_t name_line;
@@ -210,7 +596,7 @@ bool parse_node_ref(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NODE** re
 	if(!advance(state))
 		return false;
 	
-	return parse_node_ref_name(config, aggregate, name, name_line, ref_node, state);
+	return parse_node_ref_name(config, aggregate, name, name_line, writable, ref_node, state);
 }
 
 /* Get the string value of a single expression on the right hand side of a string assign statement and append it to the current rhs string */
@@ -240,19 +626,22 @@ bool parse_right_hand_side(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_ST
 		}
 		
 		SLCONFIG_NODE* ref_node;
-		if(!parse_node_ref(config, aggregate, &ref_node, state))
+		if(!parse_node_ref(config, aggregate, false, &ref_node, state))
 			return false;
 		
+		SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+		if(stats)
+			stats->expansions++;
+		
 		if(ref_node->is_aggregate)
 		{
-			_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-			state->vtable->error(slc_from_c_str("Error: Trying to extract a string from '"));
-			SLCONFIG_STRING full_name = slc_get_full_name(ref_node);
-			state->vtable->error(full_name);
-			slc_destroy_string(&full_name, config->vtable.realloc);
-			state->vtable->error(slc_from_c_str("' of type '"));
-			state->vtable->error(ref_node->type);
-			state->vtable->error(slc_from_c_str("' which is an aggregate.\n"));
+			_slc_begin_warning(config, SLCONFIG_ERROR_IS_AGGREGATE, state->filename, state->line);
+			_slc_error(config, slc_from_c_str("Error: Trying to extract a string from '"));
+			_slc_error_full_name(config, ref_node);
+			_slc_error(config, slc_from_c_str("' of type '"));
+			_slc_error(config, ref_node->type);
+			_slc_error(config, slc_from_c_str("' which is an aggregate.\n"));
+			_slc_end_error(config);
 		}
 		
 		str = ref_node->value;
@@ -263,7 +652,7 @@ bool parse_right_hand_side(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_ST
 		return false;
 	}
 
-	slc_append_to_string(rhs, str, config->vtable.realloc);
+	_slc_append_to_string(config, rhs, str);
 	
 	if(own_str)
 		slc_destroy_string(&str, config->vtable.realloc);
@@ -303,30 +692,41 @@ bool parse_left_hand_side(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NOD
 			if(!advance(state))
 				return false;
 			bool is_aggregate = state->cur_token.type == TOKEN_LEFT_BRACE;
+			replay_skipped_statements(config, aggregate, name);
 			SLCONFIG_NODE* child = _slc_add_node_no_attach(aggregate, type_or_name, false, name, false, is_aggregate);
 			if(!child)
 			{
-				child = slc_get_node(aggregate, name);
-				_slc_print_error_prefix(config, state->filename, name_line, state->vtable);
-				state->vtable->error(slc_from_c_str("Error: Cannot change the type of '"));
-				SLCONFIG_STRING full_name = slc_get_full_name(child);
-				state->vtable->error(full_name);
-				slc_destroy_string(&full_name, config->vtable.realloc);
-				state->vtable->error(slc_from_c_str("' from '"));
-				state->vtable->error(child->type);
-				state->vtable->error(slc_from_c_str("' ("));
-				state->vtable->error(slc_from_c_str(child->is_aggregate ? "aggregate" : "string"));
-				state->vtable->error(slc_from_c_str(") to "));
-				state->vtable->error(slc_from_c_str("'"));
-				state->vtable->error(type_or_name);
-				state->vtable->error(slc_from_c_str("' ("));
-				state->vtable->error(slc_from_c_str(is_aggregate ? "aggregate" : "string"));
-				state->vtable->error(slc_from_c_str(").\n"));
+				child = _slc_get_node(aggregate, name);
+				_slc_begin_error(config, SLCONFIG_ERROR_TYPE_CONFLICT, state->filename, name_line);
+				_slc_error(config, slc_from_c_str("Error: Cannot change the type of '"));
+				_slc_error_full_name(config, child);
+				_slc_error(config, slc_from_c_str("' from '"));
+				_slc_error(config, child->type);
+				_slc_error(config, slc_from_c_str("' ("));
+				_slc_error(config, slc_from_c_str(child->is_aggregate ? "aggregate" : "string"));
+				_slc_error(config, slc_from_c_str(") to "));
+				_slc_error(config, slc_from_c_str("'"));
+				_slc_error(config, type_or_name);
+				_slc_error(config, slc_from_c_str("' ("));
+				_slc_error(config, slc_from_c_str(is_aggregate ? "aggregate" : "string"));
+				_slc_error(config, slc_from_c_str(").\n"));
+				_slc_end_error(config);
 				return false;
 			}
 			
-			child->own_type = own_type_or_name;
-			child->own_name = own_name;
+			/* An existing node keeps its own strings */
+			if(child->parent == NULL)
+			{
+				child->own_type = own_type_or_name;
+				child->own_name = own_name;
+			}
+			else
+			{
+				if(own_type_or_name)
+					slc_destroy_string(&type_or_name, config->vtable.realloc);
+				if(own_name)
+					slc_destroy_string(&name, config->vtable.realloc);
+			}
 			
 			*lhs_node = child;
 			*expect_assign = state->cur_token.type != TOKEN_SEMICOLON;
@@ -341,9 +741,11 @@ bool parse_left_hand_side(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NOD
 		/* name = */
 		else if(state->cur_token.type == TOKEN_ASSIGN || state->cur_token.type == TOKEN_LEFT_BRACE)
 		{
-			SLCONFIG_NODE* child = slc_get_node(aggregate, type_or_name);
+			SLCONFIG_NODE* child = get_node(config, aggregate, type_or_name, true);
 			if(child)
 			{
+				if(own_type_or_name)
+					slc_destroy_string(&type_or_name, config->vtable.realloc);
 				*lhs_node = child;
 			}
 			else
@@ -359,7 +761,7 @@ bool parse_left_hand_side(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NOD
 		/* name;*/
 		else
 		{
-			SLCONFIG_NODE* child = slc_get_node(aggregate, type_or_name);
+			SLCONFIG_NODE* child = get_node(config, aggregate, type_or_name, false);
 			if(child)
 			{
 				*lhs_node = child;
@@ -400,12 +802,12 @@ bool parse_left_hand_side(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NOD
 	
 	*expect_assign = true;
 	
-	return parse_node_ref_name(config, aggregate, name, name_line, lhs_node, state);
+	return parse_node_ref_name(config, aggregate, name, name_line, true, lhs_node, state);
 }
 
-/* Parse an assign statement */
+/* Parse an assign statement. If it opens an aggregate block, the aggregate is returned in block_lhs and the block is left to the caller */
 static
-bool parse_assign_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_STATE* state)
+bool parse_assign_expression(CONFIG* config, SLCONFIG_NODE* aggregate, SLCONFIG_NODE** block_lhs, PARSER_STATE* state)
 {
 	SLCONFIG_NODE* lhs = NULL;
 	bool is_new = false;
@@ -414,7 +816,6 @@ bool parse_assign_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_ST
 		goto error;
 	if(lhs)
 	{
-		bool was_aggregate = false;
 		is_new = lhs->parent == NULL;
 		if(expect_assign)
 		{
@@ -422,14 +823,13 @@ bool parse_assign_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_ST
 			{
 				if(lhs->is_aggregate)
 				{
-					_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-					state->vtable->error(slc_from_c_str("Error: Trying to assign a string to '"));
-					SLCONFIG_STRING full_name = slc_get_full_name(lhs);
-					state->vtable->error(full_name);
-					slc_destroy_string(&full_name, config->vtable.realloc);
-					state->vtable->error(slc_from_c_str("' of type '"));
-					state->vtable->error(lhs->type);
-					state->vtable->error(slc_from_c_str("' which is an aggregate.\n"));
+					_slc_begin_error(config, SLCONFIG_ERROR_IS_AGGREGATE, state->filename, state->line);
+					_slc_error(config, slc_from_c_str("Error: Trying to assign a string to '"));
+					_slc_error_full_name(config, lhs);
+					_slc_error(config, slc_from_c_str("' of type '"));
+					_slc_error(config, lhs->type);
+					_slc_error(config, slc_from_c_str("' which is an aggregate.\n"));
+					_slc_end_error(config);
 					goto error;
 				}
 				
@@ -440,59 +840,38 @@ bool parse_assign_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_ST
 				do
 				{
 					if(!parse_right_hand_side(config, aggregate, &rhs, state))
+					{
+						slc_destroy_string(&rhs, config->vtable.realloc);
 						goto error;
+					}
 				} while(state->cur_token.type != TOKEN_SEMICOLON);
 				
 				if(lhs->own_value)
 					slc_destroy_string(&lhs->value, config->vtable.realloc);
 				lhs->value = rhs;
 				lhs->own_value = true;
+				lhs->value_cache = 0;
+				_slc_touch_node(lhs);
 			}
 			else if(state->cur_token.type == TOKEN_LEFT_BRACE)
 			{
 				if(!lhs->is_aggregate)
 				{
-					_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-					state->vtable->error(slc_from_c_str("Error: Trying to assign an aggregate to '"));
-					SLCONFIG_STRING full_name = slc_get_full_name(lhs);
-					state->vtable->error(full_name);
-					slc_destroy_string(&full_name, config->vtable.realloc);
-					state->vtable->error(slc_from_c_str("' of type '"));
-					state->vtable->error(lhs->type);
-					state->vtable->error(slc_from_c_str("' which is not an aggregate.\n"));
+					_slc_begin_error(config, SLCONFIG_ERROR_NOT_AGGREGATE, state->filename, state->line);
+					_slc_error(config, slc_from_c_str("Error: Trying to assign an aggregate to '"));
+					_slc_error_full_name(config, lhs);
+					_slc_error(config, slc_from_c_str("' of type '"));
+					_slc_error(config, lhs->type);
+					_slc_error(config, slc_from_c_str("' which is not an aggregate.\n"));
+					_slc_end_error(config);
 					goto error;
 				}
 				
 				set_new_node(state, lhs, state->line);
-				was_aggregate = true;
-				
-				/* A temporary is created so that we can keep referencing the original node before it gets overwritten */
-				SLCONFIG_NODE temp_node;
-				memset(&temp_node, 0, sizeof(SLCONFIG_NODE));
-				temp_node.parent = aggregate;
-				temp_node.is_aggregate = true;
-				temp_node.config = config;
-				temp_node.type = lhs->type;
-				temp_node.own_type = lhs->own_type;
-				temp_node.name = lhs->name;
-				temp_node.own_name = lhs->own_name;
-				temp_node.comment = lhs->comment;
-				temp_node.own_comment = lhs->own_comment;
-				temp_node.user_data = lhs->user_data;
-				temp_node.user_destructor = lhs->user_destructor;
-				
-				if(!parse_aggregate(config, &temp_node, state))
-					goto error;
 				
-				for(size_t ii = 0; ii < lhs->num_children; ii++)
-					_slc_destroy_node(lhs->children[ii], false);
-				_slc_free(config, lhs->children);
-				
-				memcpy(lhs, &temp_node, sizeof(SLCONFIG_NODE));
-				if(is_new)
-					lhs->parent = NULL; /* So the attach code below works */
-				for(size_t ii = 0; ii < lhs->num_children; ii++)
-					lhs->children[ii]->parent = lhs;
+				/* The caller parses the block, and attaches the node once it is done */
+				*block_lhs = lhs;
+				return true;
 			}
 			else
 			{
@@ -501,26 +880,26 @@ bool parse_assign_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_ST
 			}
 		}
 
-		if(!was_aggregate)
+		if(state->cur_token.type == TOKEN_SEMICOLON)
 		{
-			if(state->cur_token.type == TOKEN_SEMICOLON)
-			{
-				/* Right before we get to the semi-colon */
-				set_new_node(state, lhs, state->line);
-			}
-			else
-			{
-				_slc_expected_error(config, state->state, state->line, slc_from_c_str(";"), state->cur_token.str);
-				goto error;
-			}
+			/* Right before we get to the semi-colon */
+			set_new_node(state, lhs, state->line);
+		}
+		else
+		{
+			_slc_expected_error(config, state->state, state->line, slc_from_c_str(";"), state->cur_token.str);
+			goto error;
 		}
 	}
 	if(is_new)
+	{
 		_slc_attach_node(aggregate, lhs);
+		_slc_touch_node(lhs);
+	}
 	return true;
 error:
 	if(is_new)
-		slc_destroy_node(lhs);
+		_slc_destroy_node(lhs, true);
 	return false;
 }
 
@@ -534,10 +913,14 @@ bool parse_remove(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_STATE* state)
 			return false;
 		
 		SLCONFIG_NODE* ref_node;
-		if(!parse_node_ref(config, aggregate, &ref_node, state))
+		if(!parse_node_ref(config, aggregate, true, &ref_node, state))
 			return false;
 		
-		slc_destroy_node(ref_node);
+		if(ref_node->is_aggregate)
+			drop_skipped_statements(config, ref_node);
+		if(ref_node->parent)
+			_slc_touch_node(ref_node->parent);
+		_slc_destroy_node(ref_node, true);
 		
 		if(state->cur_token.type != TOKEN_SEMICOLON)
 		{
@@ -558,74 +941,72 @@ bool parse_expand_aggregate(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_STA
 			return false;
 		
 		SLCONFIG_NODE* ref_node;
-		if(!parse_node_ref(config, aggregate, &ref_node, state))
+		if(!parse_node_ref(config, aggregate, false, &ref_node, state))
 			return false;
 		
 		if(!ref_node->is_aggregate)
 		{
-			_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-			state->vtable->error(slc_from_c_str("Error: Trying to expand '"));
-			SLCONFIG_STRING full_name = slc_get_full_name(ref_node);
-			state->vtable->error(full_name);
-			slc_destroy_string(&full_name, config->vtable.realloc);
-			state->vtable->error(slc_from_c_str("' of type '"));
-			state->vtable->error(ref_node->type);
-			state->vtable->error(slc_from_c_str("' which is not an aggregate.\n"));
+			_slc_begin_error(config, SLCONFIG_ERROR_NOT_AGGREGATE, state->filename, state->line);
+			_slc_error(config, slc_from_c_str("Error: Trying to expand '"));
+			_slc_error_full_name(config, ref_node);
+			_slc_error(config, slc_from_c_str("' of type '"));
+			_slc_error(config, ref_node->type);
+			_slc_error(config, slc_from_c_str("' which is not an aggregate.\n"));
+			_slc_end_error(config);
 			return false;
 		}
 		
+		SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+		if(stats)
+			stats->expansions++;
+		
+		replay_all_skipped_statements(config, ref_node);
 		for(size_t ii = 0; ii < ref_node->num_children; ii++)
 		{
 			SLCONFIG_NODE* child = ref_node->children[ii];
-			SLCONFIG_NODE* new_node = slc_add_node(aggregate, child->type, false, child->name, false, child->is_aggregate);
+			replay_skipped_statements(config, aggregate, child->name);
+			SLCONFIG_NODE* new_node = _slc_add_node(aggregate, child->type, child->own_type, child->name, child->own_name, child->is_aggregate);
 			if(!new_node)
 			{
-				SLCONFIG_NODE* old_node = slc_get_node(aggregate, child->name);
-				SLCONFIG_STRING full_name;
-				
-				_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-				state->vtable->error(slc_from_c_str("Error: Cannot expand '"));
+				SLCONFIG_NODE* old_node = _slc_get_node(aggregate, child->name);
+				_slc_begin_error(config, SLCONFIG_ERROR_TYPE_CONFLICT, state->filename, state->line);
+				_slc_error(config, slc_from_c_str("Error: Cannot expand '"));
 				
-				full_name = slc_get_full_name(ref_node);
-				state->vtable->error(full_name);
-				slc_destroy_string(&full_name, config->vtable.realloc);
+				_slc_error_full_name(config, ref_node);
 				
-				state->vtable->error(slc_from_c_str("' of type '"));
-				state->vtable->error(ref_node->type);
-				state->vtable->error(slc_from_c_str("'. Its child '"));
+				_slc_error(config, slc_from_c_str("' of type '"));
+				_slc_error(config, ref_node->type);
+				_slc_error(config, slc_from_c_str("'. Its child '"));
 				
-				full_name = slc_get_full_name(child);
-				state->vtable->error(full_name);
-				slc_destroy_string(&full_name, config->vtable.realloc);
+				_slc_error_full_name(config, child);
 				
-				state->vtable->error(slc_from_c_str("' of type '"));
-				state->vtable->error(child->type);
-				state->vtable->error(slc_from_c_str("' ("));
-				state->vtable->error(slc_from_c_str(child->is_aggregate ? "aggregate" : "string"));
-				state->vtable->error(slc_from_c_str(") conflicts with '"));
+				_slc_error(config, slc_from_c_str("' of type '"));
+				_slc_error(config, child->type);
+				_slc_error(config, slc_from_c_str("' ("));
+				_slc_error(config, slc_from_c_str(child->is_aggregate ? "aggregate" : "string"));
+				_slc_error(config, slc_from_c_str(") conflicts with '"));
 				
-				full_name = slc_get_full_name(old_node);
-				state->vtable->error(full_name);
-				slc_destroy_string(&full_name, config->vtable.realloc);
+				_slc_error_full_name(config, old_node);
 				
-				state->vtable->error(slc_from_c_str("' of type '"));
-				state->vtable->error(old_node->type);
-				state->vtable->error(slc_from_c_str("' ("));
-				state->vtable->error(slc_from_c_str(old_node->is_aggregate ? "aggregate" : "string"));
-				state->vtable->error(slc_from_c_str(").\n"));
+				_slc_error(config, slc_from_c_str("' of type '"));
+				_slc_error(config, old_node->type);
+				_slc_error(config, slc_from_c_str("' ("));
+				_slc_error(config, slc_from_c_str(old_node->is_aggregate ? "aggregate" : "string"));
+				_slc_error(config, slc_from_c_str(").\n"));
+				_slc_end_error(config);
 				
 				return false;
 			}
 			
-			for(size_t ii = 0; ii < new_node->num_children; ii++)
-				_slc_destroy_node(new_node->children[ii], false);
-			
-			_slc_free(config, new_node->children);
+			if(new_node->is_aggregate)
+				drop_skipped_statements(config, new_node);
+			_slc_destroy_children(new_node);
 			
 			if(new_node->own_value)
 				slc_destroy_string(&new_node->value, config->vtable.realloc);
 			
 			_slc_copy_into(new_node, child);
+			_slc_touch_node(new_node);
 		}
 		
 		if(state->cur_token.type != TOKEN_SEMICOLON)
@@ -669,35 +1050,47 @@ bool parse_include_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_S
 		
 		if(!_slc_add_include(config, filename, false, state->line))
 		{
-			_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-			state->vtable->error(slc_from_c_str("Error: Circular include.\n"));
+			_slc_begin_error(config, SLCONFIG_ERROR_CIRCULAR_INCLUDE, state->filename, state->line);
+			_slc_error(config, slc_from_c_str("Error: Circular include.\n"));
+			_slc_end_error(config);
 			return false;
 		}
 		
+		uint64_t start_ns = config->collect_stats ? _slc_get_time_ns() : 0;
+		size_t outer_stats = _slc_begin_load_stats(config, filename);
+		
 		SLCONFIG_STRING file = {0, 0};
-		if(!_slc_load_file(config, filename, &file))
+		bool loaded = _slc_load_file(config, filename, &file);
+		bool parsed = loaded && _slc_parse_file(config, aggregate, filename, file);
+		
+		/* Even a failed include is unwound, so that the rest of the including file can still be checked */
+		config->cur_stats = outer_stats;
+		if(config->collect_stats)
+			config->nested_ns += _slc_get_time_ns() - start_ns;
+		
+		_slc_pop_include(config);
+		
+		if(!loaded)
 		{
-			_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-			state->vtable->error(slc_from_c_str("Error: File '"));
-			state->vtable->error(filename);
-			state->vtable->error(slc_from_c_str("' does not exist.\n"));
+			_slc_begin_error(config, SLCONFIG_ERROR_MISSING_FILE, state->filename, state->line);
+			_slc_error(config, slc_from_c_str("Error: File '"));
+			_slc_error(config, filename);
+			_slc_error(config, slc_from_c_str("' does not exist.\n"));
 			if(config->num_search_dirs)
 			{
-				state->vtable->error(slc_from_c_str("Search directories:\n"));
+				_slc_error(config, slc_from_c_str("Search directories:\n"));
 				for(size_t ii = 0; ii < config->num_search_dirs; ii++)
 				{
-					state->vtable->error(config->search_dirs[ii]);
-					state->vtable->error(slc_from_c_str("\n"));
+					_slc_error(config, config->search_dirs[ii]);
+					_slc_error(config, slc_from_c_str("\n"));
 				}
 			}
-			return false;
+			_slc_end_error(config);
 		}
 		
-		if(!_slc_parse_file(config, aggregate, filename, file))
+		if(!parsed)
 			return false;
 		
-		_slc_pop_include(config);
-		
 		if(!advance(state))
 			return false;
 		
@@ -710,68 +1103,581 @@ bool parse_include_expression(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_S
 	return true;
 }
 
-/* Chomp up the statements in the root, or between braces in an aggregate. The braces are taken care of by this function */
+/*
+ * An aggregate block being parsed. The statements are parsed into a temporary node, so that they can keep
+ * referencing the original contents of the aggregate until the block ends
+ */
+typedef struct
+{
+	SLCONFIG_NODE temp_node;
+	SLCONFIG_NODE* lhs;
+	size_t start_line;
+	FILTER_STATUS filter;
+} BLOCK_FRAME;
+
 static
-bool parse_aggregate(CONFIG* config, SLCONFIG_NODE* aggregate, PARSER_STATE* state)
+SLCONFIG_STRING get_filter_name(const CONFIG* config, size_t path, size_t idx)
 {
-	TOKEN tok = state->cur_token;
-	size_t start_line = state->line;
-	TOKEN_TYPE end_token = tok.type == TOKEN_LEFT_BRACE ? TOKEN_RIGHT_BRACE : TOKEN_EOF;
-	if(end_token == TOKEN_RIGHT_BRACE)
+	return config->filter_names[config->filter_starts[path] + idx];
+}
+
+static
+size_t get_filter_path_length(const CONFIG* config, size_t path)
+{
+	return config->filter_starts[path + 1] - config->filter_starts[path];
+}
+
+/* Status of a child of an aggregate with the given status */
+static
+FILTER_STATUS get_child_filter_status(const CONFIG* config, const FILTER_STATUS* status, SLCONFIG_STRING name)
+{
+	FILTER_STATUS ret = {status->keep_all, status->depth + 1, 0};
+	if(ret.keep_all)
+		return ret;
+	
+	for(size_t ii = 0; ii < config->num_filter_paths; ii++)
+	{
+		if(!(status->candidates & ((uint64_t)1 << ii)))
+			continue;
+		if(!slc_string_equal(get_filter_name(config, ii, status->depth), name))
+			continue;
+		
+		if(get_filter_path_length(config, ii) == ret.depth)
+			ret.keep_all = true;
+		else
+			ret.candidates |= (uint64_t)1 << ii;
+	}
+	return ret;
+}
+
+/* Status of an aggregate from its path, comparing the names up the tree with each kept path */
+static
+FILTER_STATUS get_filter_status(const CONFIG* config, const SLCONFIG_NODE* aggregate, bool filter)
+{
+	FILTER_STATUS ret = {true, 0, 0};
+	for(const SLCONFIG_NODE* node = aggregate; node->parent; node = node->parent)
+		ret.depth++;
+	if(!filter || config->num_filter_paths == 0)
+		return ret;
+	
+	ret.keep_all = false;
+	for(size_t ii = 0; ii < config->num_filter_paths; ii++)
 	{
+		size_t length = get_filter_path_length(config, ii);
+		const SLCONFIG_NODE* node = aggregate;
+		size_t depth = ret.depth;
+		for(; depth > length; depth--)
+			node = node->parent;
+		
+		bool matches = true;
+		for(; depth > 0 && matches; depth--, node = node->parent)
+			matches = slc_string_equal(node->name, get_filter_name(config, ii, depth - 1));
+		if(!matches)
+			continue;
+		
+		if(length <= ret.depth)
+			ret.keep_all = true;
+		else
+			ret.candidates |= (uint64_t)1 << ii;
+	}
+	return ret;
+}
+
+/* Start parsing the block of lhs, the current token being its opening brace */
+static
+bool open_block(CONFIG* config, SLCONFIG_NODE* aggregate, const FILTER_STATUS* filter, SLCONFIG_NODE* lhs, size_t depth, BLOCK_FRAME* frame, PARSER_STATE* state)
+{
+	if(config->max_depth && depth > config->max_depth)
+	{
+		char buf[NUMBER_BUFFER_SIZE];
+		size_t len = _slc_format_int64((int64_t)config->max_depth, buf);
+		SLCONFIG_STRING max_depth = {buf, buf + len};
+		
+		_slc_begin_error(config, SLCONFIG_ERROR_MAX_DEPTH, state->filename, state->line);
+		_slc_error(config, slc_from_c_str("Error: '"));
+		_slc_error_full_name(config, lhs);
+		_slc_error(config, slc_from_c_str("' exceeds the maximum nesting depth of "));
+		_slc_error(config, max_depth);
+		_slc_error(config, slc_from_c_str(".\n"));
+		_slc_end_error(config);
+		return false;
+	}
+	
+	memset(&frame->temp_node, 0, sizeof(SLCONFIG_NODE));
+	frame->temp_node.parent = aggregate;
+	frame->temp_node.is_aggregate = true;
+	frame->temp_node.config = config;
+	frame->temp_node.type = lhs->type;
+	frame->temp_node.name = lhs->name;
+	frame->lhs = lhs;
+	frame->start_line = state->line;
+	
+	/* A block opened through a reference is not a child of the aggregate */
+	if(lhs->parent == NULL || lhs->parent == aggregate)
+		frame->filter = get_child_filter_status(config, filter, lhs->name);
+	else
+		frame->filter = get_filter_status(config, lhs, state->filter);
+	
+	return advance(state);
+}
+
+/* Replace the children of the block's aggregate with the ones that were parsed, and attach it if it is new */
+static
+void close_block(CONFIG* config, SLCONFIG_NODE* aggregate, BLOCK_FRAME* frame)
+{
+	SLCONFIG_NODE* lhs = frame->lhs;
+	
+	if(lhs->parent)
+		drop_skipped_statements(config, lhs);
+	move_skipped_statements(config, &frame->temp_node, lhs);
+	_slc_destroy_children(lhs);
+	
+	lhs->children = frame->temp_node.children;
+	lhs->num_children = frame->temp_node.num_children;
+	for(size_t ii = 0; ii < lhs->num_children; ii++)
+		lhs->children[ii]->parent = lhs;
+	
+	if(lhs->parent == NULL)
+		_slc_attach_node(aggregate, lhs);
+	_slc_touch_node(lhs);
+}
+
+/* Destroy what was parsed of a block that failed */
+static
+void abandon_block(CONFIG* config, BLOCK_FRAME* frame)
+{
+	drop_skipped_statements(config, &frame->temp_node);
+	for(size_t ii = 0; ii < frame->temp_node.num_children; ii++)
+		_slc_destroy_node(frame->temp_node.children[ii], false);
+	_slc_free(config, frame->temp_node.children);
+	
+	if(frame->lhs->parent == NULL)
+		_slc_destroy_node(frame->lhs, true);
+}
+
+/* Whether to carry on parsing after an error, to report the errors in the rest of the input as well */
+static
+bool can_recover(CONFIG* config)
+{
+	return config->max_errors == 0 || config->num_errors < config->max_errors;
+}
+
+/*
+ * Skip the rest of a statement that failed to parse: up to and including its ';' or its whole block, or up to the
+ * '}' that closes the enclosing block. Returns false if parsing cannot go on.
+ */
+static
+bool recover(CONFIG* config, PARSER_STATE* state)
+{
+	if(!can_recover(config))
+		return false;
+	
+	size_t depth = 0;
+	while(true)
+	{
+		switch(state->cur_token.type)
+		{
+			case TOKEN_ERROR:
+				return false;
+			case TOKEN_EOF:
+				return true;
+			case TOKEN_SEMICOLON:
+				if(depth == 0)
+					return advance(state);
+				break;
+			case TOKEN_LEFT_BRACE:
+				depth++;
+				break;
+			case TOKEN_RIGHT_BRACE:
+				if(depth == 0)
+					return true;
+				if(--depth == 0)
+					return advance(state);
+				break;
+			default:
+				break;
+		}
+		
 		if(!advance(state))
 			return false;
 	}
-	do
+}
+
+/* Where skip_statement is in a statement it is scanning */
+typedef enum
+{
+	SCAN_STATEMENT,
+	SCAN_AFTER_FIRST,
+	SCAN_AFTER_NAME,
+	SCAN_FIRST_VALUE,
+	SCAN_VALUES
+} SCAN_STATE;
+
+/* Remember a statement that was skipped, so that it can be replayed if its node is needed */
+static
+void add_skipped_statement(CONFIG* config, SLCONFIG_NODE* aggregate, const SKIPPED_STATEMENT* statement, PARSER_STATE* state)
+{
+	if(!config->skipped_statements)
 	{
-		if(!parse_include_expression(config, aggregate, state))
-			return false;
-		if(!parse_assign_expression(config, aggregate, state))
-			return false;
-		if(!parse_remove(config, aggregate, state))
-			return false;
-		if(!parse_expand_aggregate(config, aggregate, state))
-			return false;
+		config->skipped_statements = _slc_realloc(config, NULL, sizeof(struct SKIPPED_STATEMENTS));
+		memset(config->skipped_statements, 0, sizeof(struct SKIPPED_STATEMENTS));
+	}
+	
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	skipped->statements = _slc_grow_stack(config, skipped->statements, skipped->num_statements, &skipped->statements_capacity, sizeof(SKIPPED_STATEMENT));
+	size_t idx = skipped->num_statements++;
+	skipped->statements[idx] = *statement;
+	skipped->statements[idx].next = NO_STATEMENT;
+	skipped->statements[idx].next_in_aggregate = NO_STATEMENT;
+	add_skipped_statements(config, aggregate, skipped->statements[idx].name, idx, idx);
+	add_skipped_aggregate(config, aggregate, idx, idx);
+	
+	state->last_skipped = idx;
+}
 
-		tok = state->cur_token;
-		if(tok.type == TOKEN_SEMICOLON)
+/*
+ * Skip the statement starting at the current token if the load filter does not keep it. Only plain definitions of
+ * new nodes are skipped: a name, possibly with a type, followed by nothing, by strings or by a block of such definitions.
+ * Anything else can affect other nodes or depend on them, so the input is rewound and the statement is parsed as usual,
+ * which also takes care of reporting the errors. Returns false if the input after a skipped statement is malformed.
+ */
+static
+bool skip_statement(CONFIG* config, SLCONFIG_NODE* aggregate, const FILTER_STATUS* filter, PARSER_STATE* state, bool* skipped)
+{
+	*skipped = false;
+	
+	const char* start = state->token_start;
+	while(state->num_unskippable && state->unskippable[state->num_unskippable - 1] < start)
+		state->num_unskippable--;
+	if(state->num_unskippable && state->unskippable[state->num_unskippable - 1] == start)
+	{
+		state->num_unskippable--;
+		return true;
+	}
+	
+	/* Everything needed to rewind to the current token */
+	TOKENIZER_STATE tokenizer_state = *state->state;
+	TOKEN first_token = state->cur_token;
+	bool own_first_token = state->free_token;
+	size_t first_line = state->line;
+	size_t start_line = state->token_line;
+	SLCONFIG_NODE* last_node = state->last_node;
+	size_t last_skipped = state->last_skipped;
+	size_t comment_length = slc_string_length(state->comment);
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+	size_t num_tokens[SLCONFIG_NUM_TOKEN_TYPES];
+	if(stats)
+		memcpy(num_tokens, stats->num_tokens, sizeof(num_tokens));
+	
+	/* The docstrings inside of the statement must not go to the nodes before it */
+	state->free_token = false;
+	state->last_node = NULL;
+	state->last_skipped = NO_STATEMENT;
+	state->state->gag_errors = true;
+	
+	SLCONFIG_STRING name = {0, 0};
+	bool skip = advance(state);
+	if(skip)
+	{
+		SLCONFIG_STRING name_token = state->cur_token.type == TOKEN_STRING ? state->cur_token.str : first_token.str;
+		FILTER_STATUS child_filter = get_child_filter_status(config, filter, name_token);
+		/* Existing nodes are left alone, as later statements modify them */
+		skip = !child_filter.keep_all && !child_filter.candidates && !_slc_get_node(aggregate, name_token);
+		if(skip)
+			_slc_append_to_string(config, &name, name_token);
+	}
+	
+	SCAN_STATE scan = SCAN_AFTER_FIRST;
+	size_t depth = 0;
+	const char* statement_start = start;
+	/* Line of the last node the statement defines, which takes the docstrings after the statement on the same line */
+	size_t node_line = 0;
+	while(skip)
+	{
+		TOKEN_TYPE type = state->cur_token.type;
+		if(type == TOKEN_STRING && scan == SCAN_STATEMENT)
 		{
-			if(!advance(state))
-				return false;
+			statement_start = state->token_start;
+			scan = SCAN_AFTER_FIRST;
+		}
+		else if(type == TOKEN_STRING && scan == SCAN_AFTER_FIRST)
+		{
+			scan = SCAN_AFTER_NAME;
+		}
+		else if(type == TOKEN_STRING && (scan == SCAN_FIRST_VALUE || scan == SCAN_VALUES))
+		{
+			scan = SCAN_VALUES;
+		}
+		else if(type == TOKEN_ASSIGN && (scan == SCAN_AFTER_FIRST || scan == SCAN_AFTER_NAME))
+		{
+			scan = SCAN_FIRST_VALUE;
+		}
+		else if(type == TOKEN_LEFT_BRACE && (scan == SCAN_AFTER_FIRST || scan == SCAN_AFTER_NAME))
+		{
+			state->scan_starts = _slc_grow_stack(config, state->scan_starts, depth, &state->scan_starts_capacity, sizeof(const char*));
+			state->scan_starts[depth++] = statement_start;
+			node_line = state->line;
+			scan = SCAN_STATEMENT;
+			/* Too deep blocks are left for the parser to report */
+			if(config->max_depth && filter->depth + depth > config->max_depth)
+				skip = false;
+		}
+		else if(type == TOKEN_SEMICOLON && scan != SCAN_FIRST_VALUE)
+		{
+			if(scan != SCAN_STATEMENT)
+				node_line = state->line;
+			if(depth == 0)
+				break;
+			scan = SCAN_STATEMENT;
+		}
+		else if(type == TOKEN_RIGHT_BRACE && scan == SCAN_STATEMENT)
+		{
+			if(--depth == 0)
+				break;
+		}
+		else
+		{
+			skip = false;
 		}
 		
-		tok = state->cur_token;
-		if(tok.type != end_token && tok.type == TOKEN_RIGHT_BRACE)
+		if(skip)
+			skip = advance(state);
+	}
+	
+	state->state->gag_errors = tokenizer_state.gag_errors;
+	
+	if(!skip)
+	{
+		/* The statements the scan stopped inside of cannot be skipped either */
+		if(depth > 0 && scan != SCAN_STATEMENT)
+		{
+			state->unskippable = _slc_grow_stack(config, state->unskippable, state->num_unskippable, &state->unskippable_capacity, sizeof(const char*));
+			state->unskippable[state->num_unskippable++] = statement_start;
+		}
+		for(size_t ii = depth; ii > 1; ii--)
+		{
+			state->unskippable = _slc_grow_stack(config, state->unskippable, state->num_unskippable, &state->unskippable_capacity, sizeof(const char*));
+			state->unskippable[state->num_unskippable++] = state->scan_starts[ii - 1];
+		}
+		
+		if(state->free_token)
+			slc_destroy_string(&state->cur_token.str, state->vtable->realloc);
+		*state->state = tokenizer_state;
+		state->cur_token = first_token;
+		state->free_token = own_first_token;
+		state->line = first_line;
+		state->token_start = start;
+		state->token_line = start_line;
+		state->last_node = last_node;
+		state->last_skipped = last_skipped;
+		if(state->comment.start)
+			state->comment.end = state->comment.start + comment_length;
+		if(stats)
+			memcpy(stats->num_tokens, num_tokens, sizeof(num_tokens));
+		slc_destroy_string(&name, config->vtable.realloc);
+		return true;
+	}
+	
+	SKIPPED_STATEMENT statement;
+	statement.name = name;
+	statement.text.start = start;
+	statement.text.end = state->state->str.start;
+	statement.filename = state->filename;
+	statement.line = start_line;
+	statement.comment.start = statement.comment.end = NULL;
+	if(comment_length)
+	{
+		SLCONFIG_STRING comment = {state->comment.start, state->comment.start + comment_length};
+		_slc_append_to_string(config, &statement.comment, comment);
+	}
+	if(state->comment.start)
+		state->comment.end = state->comment.start;
+	add_skipped_statement(config, aggregate, &statement, state);
+	state->last_skipped_line = node_line;
+	
+	if(own_first_token)
+		slc_destroy_string(&first_token.str, config->vtable.realloc);
+	*skipped = true;
+	
+	/* The closing brace is consumed, so that the statement ends up where a parsed block would */
+	if(state->cur_token.type == TOKEN_RIGHT_BRACE)
+		return advance(state);
+	return true;
+}
+
+/*
+ * Chomp up the statements in the root, or between braces in an aggregate. The braces are taken care of by this function.
+ * Nested blocks are kept on an explicit stack, so that deeply nested files cannot overflow the call stack.
+ */
+static
+bool parse_aggregate(CONFIG* config, SLCONFIG_NODE* root, PARSER_STATE* state)
+{
+	size_t start_line = state->line;
+	TOKEN_TYPE end_token = state->cur_token.type == TOKEN_LEFT_BRACE ? TOKEN_RIGHT_BRACE : TOKEN_EOF;
+	if(end_token == TOKEN_RIGHT_BRACE)
+	{
+		if(!advance(state))
+			return false;
+	}
+	
+	/* Nesting depth of the root, which is not 0 for included files */
+	size_t base_depth = 0;
+	for(SLCONFIG_NODE* node = root->parent; node; node = node->parent)
+		base_depth++;
+	
+	/* The frames are allocated individually and reused, as the parsed children point to their temporary nodes */
+	BLOCK_FRAME** blocks = NULL;
+	size_t num_blocks = 0;
+	size_t num_allocated_blocks = 0;
+	size_t blocks_capacity = 0;
+	
+	FILTER_STATUS root_filter = get_filter_status(config, root, state->filter);
+	
+	SLCONFIG_NODE* aggregate = root;
+	bool block_closed = false;
+	/* Whether a statement failed, but parsing went on */
+	bool failed = false;
+	bool ret = false;
+	while(true)
+	{
+		/* Remaining input before the statement, to detect tokens that no statement accepts */
+		const char* statement_start = state->state->str.start;
+		bool finishing_block = block_closed;
+		
+		/* A closed block finishes the assign statement that opened it */
+		if(!finishing_block)
 		{
-			if(tok.type == TOKEN_RIGHT_BRACE)
+			FILTER_STATUS* filter = num_blocks > 0 ? &blocks[num_blocks - 1]->filter : &root_filter;
+			if(!filter->keep_all && state->cur_token.type == TOKEN_STRING)
 			{
-				_slc_print_error_prefix(config, state->filename, state->line, state->vtable);
-				state->vtable->error(slc_from_c_str("Error: Unpaired '}'.\n"));
-				return false;
+				bool skipped;
+				if(!skip_statement(config, aggregate, filter, state, &skipped))
+					goto exit;
+				if(skipped)
+				{
+					/* Finished like a block, the semicolon being optional */
+					block_closed = true;
+					continue;
+				}
 			}
-			else if(tok.type == TOKEN_EOF)
+			
+			if(!parse_include_expression(config, aggregate, state))
+				goto skip_statement;
+			
+			SLCONFIG_NODE* block_lhs = NULL;
+			if(!parse_assign_expression(config, aggregate, &block_lhs, state))
+				goto skip_statement;
+			
+			if(block_lhs)
 			{
-				_slc_print_error_prefix(config, state->filename, start_line, state->vtable);
-				state->vtable->error(slc_from_c_str("Error: Unpaired '{'.\n"));
-				return false;
+				if(num_blocks == num_allocated_blocks)
+				{
+					blocks = _slc_grow_stack(config, blocks, num_allocated_blocks, &blocks_capacity, sizeof(BLOCK_FRAME*));
+					blocks[num_allocated_blocks++] = _slc_realloc(config, NULL, sizeof(BLOCK_FRAME));
+				}
+				
+				BLOCK_FRAME* frame = blocks[num_blocks];
+				FILTER_STATUS* filter = num_blocks > 0 ? &blocks[num_blocks - 1]->filter : &root_filter;
+				if(!open_block(config, aggregate, filter, block_lhs, base_depth + num_blocks + 1, frame, state))
+				{
+					if(block_lhs->parent == NULL)
+						_slc_destroy_node(block_lhs, true);
+					goto skip_statement;
+				}
+				
+				num_blocks++;
+				aggregate = &frame->temp_node;
+				continue;
 			}
 		}
-	} while(tok.type != end_token);
+		block_closed = false;
+		
+		if(!parse_remove(config, aggregate, state))
+			goto skip_statement;
+		if(!parse_expand_aggregate(config, aggregate, state))
+			goto skip_statement;
+		
+		if(state->cur_token.type == TOKEN_SEMICOLON)
+		{
+			if(!advance(state))
+				goto exit;
+		}
+		
+		TOKEN_TYPE type = state->cur_token.type;
+		if(num_blocks > 0 && type == TOKEN_RIGHT_BRACE)
+		{
+			if(!advance(state))
+				goto exit;
+			
+			num_blocks--;
+			aggregate = num_blocks > 0 ? &blocks[num_blocks - 1]->temp_node : root;
+			close_block(config, aggregate, blocks[num_blocks]);
+			block_closed = true;
+		}
+		else if(num_blocks == 0 && type == end_token)
+		{
+			break;
+		}
+		else if(type == TOKEN_RIGHT_BRACE)
+		{
+			_slc_begin_error(config, SLCONFIG_ERROR_UNPAIRED_BRACE, state->filename, state->line);
+			_slc_error(config, slc_from_c_str("Error: Unpaired '}'.\n"));
+			_slc_end_error(config);
+			if(!can_recover(config) || !advance(state))
+				goto exit;
+			failed = true;
+		}
+		else if(type == TOKEN_EOF)
+		{
+			size_t line = num_blocks > 0 ? blocks[num_blocks - 1]->start_line : start_line;
+			_slc_begin_error(config, SLCONFIG_ERROR_UNPAIRED_BRACE, state->filename, line);
+			_slc_error(config, slc_from_c_str("Error: Unpaired '{'.\n"));
+			_slc_end_error(config);
+			goto exit;
+		}
+		else if(!finishing_block && state->state->str.start == statement_start)
+		{
+			_slc_begin_error(config, SLCONFIG_ERROR_UNEXPECTED_TOKEN, state->filename, state->line);
+			_slc_error(config, slc_from_c_str("Error: Unexpected '"));
+			_slc_error(config, state->cur_token.str);
+			_slc_error(config, slc_from_c_str("'.\n"));
+			_slc_end_error(config);
+			goto skip_statement;
+		}
+		continue;
+		
+	skip_statement:
+		/* Skip to the next statement, to collect as many errors as allowed in one pass */
+		failed = true;
+		if(!recover(config, state))
+			goto exit;
+	}
 	
 	if(end_token == TOKEN_RIGHT_BRACE)
 	{
 		if(!advance(state))
-			return false;
+			goto exit;
 	}
 	
-	return true;
+	ret = !failed;
+exit:
+	while(num_blocks > 0)
+		abandon_block(config, blocks[--num_blocks]);
+	
+	for(size_t ii = 0; ii < num_allocated_blocks; ii++)
+		_slc_free(config, blocks[ii]);
+	_slc_free(config, blocks);
+	
+	return ret;
 }
 
-bool _slc_parse_file(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filename, SLCONFIG_STRING file)
-{	
+/* Parse the statements in a string starting at the line, the comment being a docstring before them that is taken over */
+static
+bool parse_string(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filename, SLCONFIG_STRING file, size_t line, SLCONFIG_STRING comment, bool filter)
+{
 	TOKENIZER_STATE state;
 	state.filename = filename;
-	state.line = 1;
+	state.line = line;
 	state.vtable = &config->vtable;
 	state.str = file;
 	state.config = config;
@@ -779,11 +1685,14 @@ bool _slc_parse_file(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filena
 	
 	PARSER_STATE parser_state;
 	memset(&parser_state, 0, sizeof(PARSER_STATE));
+	parser_state.comment = comment;
 	parser_state.state = &state;
-	parser_state.line = 1;
+	parser_state.line = line;
 	parser_state.filename = filename;
 	parser_state.vtable = &config->vtable;
 	parser_state.free_token = false;
+	parser_state.filter = filter;
+	parser_state.last_skipped = NO_STATEMENT;
 	
 	bool ret;
 	if(advance(&parser_state))
@@ -792,15 +1701,195 @@ bool _slc_parse_file(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filena
 		ret = false;
 	
 	slc_destroy_string(&parser_state.comment, config->vtable.realloc);
+	_slc_free(config, parser_state.unskippable);
+	_slc_free(config, parser_state.scan_starts);
+	return ret;
+}
+
+bool _slc_parse_file(CONFIG* config, SLCONFIG_NODE* root, SLCONFIG_STRING filename, SLCONFIG_STRING file)
+{	
+	/* Parse time excludes the tokenizer and the included files, which are accounted for separately */
+	size_t stats_index = config->cur_stats;
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+	uint64_t outer_nested_ns = config->nested_ns;
+	uint64_t start_ns = 0;
+	uint64_t start_tokenize_ns = 0;
+	if(stats)
+	{
+		config->nested_ns = 0;
+		start_ns = _slc_get_time_ns();
+		start_tokenize_ns = stats->tokenize_ns;
+	}
+	
+	SLCONFIG_STRING comment = {0, 0};
+	bool ret = parse_string(config, root, filename, file, 1, comment, true);
+	
+	if(stats)
+	{
+		/* The stats array may have been reallocated by the includes, and a failed include leaves its own entry current */
+		config->cur_stats = stats_index;
+		stats = _slc_get_cur_stats(config);
+		uint64_t elapsed_ns = _slc_get_time_ns() - start_ns;
+		uint64_t excluded_ns = config->nested_ns + stats->tokenize_ns - start_tokenize_ns;
+		stats->parse_ns += elapsed_ns > excluded_ns ? elapsed_ns - excluded_ns : 0;
+		config->nested_ns = outer_nested_ns;
+	}
 	
 	return ret;
 }
 
-SLCONFIG_NODE* slc_get_node_by_reference(SLCONFIG_NODE* aggregate, SLCONFIG_STRING reference)
+bool _slc_clear_skipped_statements(CONFIG* config)
+{
+	struct SKIPPED_STATEMENTS* skipped = config->skipped_statements;
+	if(!skipped)
+		return true;
+	
+	bool ret = !skipped->failed;
+	for(size_t ii = 0; ii < skipped->num_statements; ii++)
+	{
+		slc_destroy_string(&skipped->statements[ii].name, config->vtable.realloc);
+		slc_destroy_string(&skipped->statements[ii].comment, config->vtable.realloc);
+	}
+	_slc_free(config, skipped->statements);
+	_slc_free(config, skipped->names);
+	_slc_free(config, skipped->aggregates);
+	_slc_free(config, skipped);
+	config->skipped_statements = NULL;
+	return ret;
+}
+
+/* Split a path into its names, appending them to the ones of the previous paths */
+static
+bool parse_filter_path(CONFIG* config, SLCONFIG_STRING path, SLCONFIG_STRING** names, size_t* num_names, size_t* capacity)
+{
+	TOKENIZER_STATE state;
+	state.filename = slc_from_c_str("");
+	state.line = 1;
+	state.vtable = &config->vtable;
+	state.str = path;
+	state.config = config;
+	state.gag_errors = true;
+	
+	_slc_get_next_token(&state);
+	if(state.cur_token.type == TOKEN_DOUBLE_COLON)
+		_slc_get_next_token(&state);
+	
+	while(state.cur_token.type == TOKEN_STRING)
+	{
+		*names = _slc_grow_stack(config, *names, *num_names, capacity, sizeof(SLCONFIG_STRING));
+		SLCONFIG_STRING* name = &(*names)[(*num_names)++];
+		if(state.cur_token.own)
+		{
+			*name = state.cur_token.str;
+		}
+		else
+		{
+			name->start = name->end = NULL;
+			_slc_append_to_string(config, name, state.cur_token.str);
+		}
+		
+		_slc_get_next_token(&state);
+		if(state.cur_token.type == TOKEN_COLON)
+		{
+			_slc_get_next_token(&state);
+		}
+		else if(state.cur_token.type == TOKEN_EOF)
+		{
+			return true;
+		}
+		else
+		{
+			if(state.cur_token.own)
+				slc_destroy_string(&state.cur_token.str, config->vtable.realloc);
+			return false;
+		}
+	}
+	
+	return false;
+}
+
+void _slc_clear_load_filter(CONFIG* config)
+{
+	if(config->num_filter_paths)
+	{
+		for(size_t ii = 0; ii < config->filter_starts[config->num_filter_paths]; ii++)
+			slc_destroy_string(&config->filter_names[ii], config->vtable.realloc);
+	}
+	_slc_free(config, config->filter_names);
+	_slc_free(config, config->filter_starts);
+	config->filter_names = NULL;
+	config->filter_starts = NULL;
+	config->num_filter_paths = 0;
+}
+
+void _slc_copy_load_filter(CONFIG* dest, const CONFIG* src)
+{
+	_slc_clear_load_filter(dest);
+	if(src->num_filter_paths == 0)
+		return;
+	
+	size_t num_names = src->filter_starts[src->num_filter_paths];
+	dest->filter_names = _slc_realloc(dest, NULL, num_names * sizeof(SLCONFIG_STRING));
+	for(size_t ii = 0; ii < num_names; ii++)
+	{
+		dest->filter_names[ii].start = dest->filter_names[ii].end = NULL;
+		_slc_append_to_string(dest, &dest->filter_names[ii], src->filter_names[ii]);
+	}
+	dest->filter_starts = _slc_realloc(dest, NULL, (src->num_filter_paths + 1) * sizeof(size_t));
+	memcpy(dest->filter_starts, src->filter_starts, (src->num_filter_paths + 1) * sizeof(size_t));
+	dest->num_filter_paths = src->num_filter_paths;
+}
+
+bool slc_set_load_filter(SLCONFIG_NODE* node, const SLCONFIG_STRING* paths, size_t num_paths)
+{
+	assert(node);
+	assert(paths || num_paths == 0);
+	if(num_paths > MAX_FILTER_PATHS)
+		return false;
+	
+	CONFIG* config = node->config;
+	_slc_begin_write(config);
+	
+	/* The new paths are parsed on the side, so that the old ones stay if any of them is invalid */
+	SLCONFIG_STRING* names = NULL;
+	size_t num_names = 0;
+	size_t capacity = 0;
+	size_t* starts = NULL;
+	bool ret = true;
+	if(num_paths)
+	{
+		starts = _slc_realloc(config, NULL, (num_paths + 1) * sizeof(size_t));
+		for(size_t ii = 0; ii < num_paths && ret; ii++)
+		{
+			starts[ii] = num_names;
+			ret = parse_filter_path(config, paths[ii], &names, &num_names, &capacity);
+		}
+		starts[num_paths] = num_names;
+	}
+	
+	if(ret)
+	{
+		_slc_clear_load_filter(config);
+		config->filter_names = names;
+		config->filter_starts = starts;
+		config->num_filter_paths = num_paths;
+	}
+	else
+	{
+		for(size_t ii = 0; ii < num_names; ii++)
+			slc_destroy_string(&names[ii], config->vtable.realloc);
+		_slc_free(config, names);
+		_slc_free(config, starts);
+	}
+	
+	_slc_end_write(config);
+	return ret;
+}
+
+/* When writable, the nodes along the way are copied into the tree of the aggregate if they are shared */
+static
+SLCONFIG_NODE* get_node_by_reference(SLCONFIG_NODE* aggregate, SLCONFIG_STRING reference, bool writable)
 {
-	assert(aggregate);
-	if(!aggregate->is_aggregate)
-		return NULL;
 
 	TOKENIZER_STATE state;
 	state.filename = slc_from_c_str("");
@@ -822,9 +1911,9 @@ SLCONFIG_NODE* slc_get_node_by_reference(SLCONFIG_NODE* aggregate, SLCONFIG_STRI
 	while(state.cur_token.type == TOKEN_STRING)
 	{
 		if(!ret)
-			ret = _slc_search_node(aggregate, state.cur_token.str);
+			ret = writable ? _slc_search_own_node(aggregate, state.cur_token.str) : _slc_search_node(aggregate, state.cur_token.str);
 		else
-			ret = slc_get_node(aggregate, state.cur_token.str);
+			ret = writable ? _slc_get_own_node(aggregate, state.cur_token.str) : _slc_get_node(aggregate, state.cur_token.str);
 
 		if(state.cur_token.own)
 			slc_destroy_string(&state.cur_token.str, aggregate->config->vtable.realloc);
@@ -853,3 +1942,28 @@ SLCONFIG_NODE* slc_get_node_by_reference(SLCONFIG_NODE* aggregate, SLCONFIG_STRI
 	
 	return NULL;
 }
+
+SLCONFIG_NODE* slc_get_node_by_reference(SLCONFIG_NODE* aggregate, SLCONFIG_STRING reference)
+{
+	assert(aggregate);
+	if(!aggregate->is_aggregate)
+		return NULL;
+	
+	_slc_begin_read(aggregate->config);
+	SLCONFIG_NODE* ret = get_node_by_reference(aggregate, reference, false);
+	_slc_end_read(aggregate->config);
+	return ret;
+}
+
+SLCONFIG_NODE* slc_get_writable_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING reference)
+{
+	assert(aggregate);
+	if(!aggregate->is_aggregate)
+		return NULL;
+	
+	_slc_begin_write(aggregate->config);
+	/* A shared aggregate cannot tell which tree its copies would belong to */
+	SLCONFIG_NODE* ret = _slc_is_frozen(aggregate) ? NULL : get_node_by_reference(aggregate, reference, true);
+	_slc_end_write(aggregate->config);
+	return ret;
+}
@@ -0,0 +1,533 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/slconfig.h"
+#include "slconfig/internal/slconfig.h"
+#include "slconfig/internal/number.h"
+
+#include <string.h>
+#include <assert.h>
+
+/* The matcher tracks the steps a node is at in a 64 bit set, one of which stands for a complete match */
+#define MAX_STEPS (63)
+
+typedef enum
+{
+	STEP_NAME,
+	STEP_PATTERN,
+	STEP_ANY_DEPTH
+} STEP_KIND;
+
+typedef enum
+{
+	PREDICATE_TYPE,
+	PREDICATE_VALUE
+} PREDICATE_TARGET;
+
+typedef enum
+{
+	OP_EQUAL,
+	OP_NOT_EQUAL,
+	OP_LESS,
+	OP_LESS_EQUAL,
+	OP_GREATER,
+	OP_GREATER_EQUAL
+} PREDICATE_OP;
+
+typedef struct
+{
+	PREDICATE_TARGET target;
+	PREDICATE_OP op;
+	SLCONFIG_STRING operand;
+	/* The operand parsed as a number, for the ordering operators */
+	double number;
+} PREDICATE;
+
+typedef struct
+{
+	STEP_KIND kind;
+	/* The name to match, which may contain '*' for STEP_PATTERN */
+	SLCONFIG_STRING pattern;
+	size_t first_predicate;
+	size_t num_predicates;
+} STEP;
+
+/*
+ * A compiled query is a list of steps, one per level of the tree, except for '**' which stays at the same step for
+ * any number of levels. It is matched like a non-deterministic automaton: every node gets the set of steps its
+ * children are matched against, so each node of the tree is visited at most once whatever the query.
+ */
+struct SLCONFIG_QUERY
+{
+	SLCONFIG_VTABLE vtable;
+	/* Copy of the query text, which the patterns and operands point into */
+	SLCONFIG_STRING text;
+	
+	STEP* steps;
+	size_t num_steps;
+	PREDICATE* predicates;
+	size_t num_predicates;
+};
+
+typedef struct
+{
+	SLCONFIG_NODE* node;
+	uint64_t states;
+} FRAME;
+
+static
+void query_error(const SLCONFIG_VTABLE* vtable, SLCONFIG_STRING query, const char* message)
+{
+	vtable->error(slc_from_c_str("Error: Invalid query '"));
+	vtable->error(query);
+	vtable->error(slc_from_c_str("': "));
+	vtable->error(slc_from_c_str(message));
+	vtable->error(slc_from_c_str(".\n"));
+}
+
+static
+size_t count_chars(SLCONFIG_STRING str, char c)
+{
+	size_t ret = 0;
+	for(const char* p = str.start; p < str.end; p++)
+		ret += *p == c;
+	return ret;
+}
+
+static
+const char* parse_predicate(SLCONFIG_QUERY* query, const char* p, PREDICATE* predicate, const char** message)
+{
+	const char* end = query->text.end;
+	
+	SLCONFIG_STRING target = {p, p};
+	while(target.end < end && *target.end != '=' && *target.end != '!' && *target.end != '<' && *target.end != '>' && *target.end != ']')
+		target.end++;
+	if(slc_string_equal(target, slc_from_c_str("type")))
+	{
+		predicate->target = PREDICATE_TYPE;
+	}
+	else if(slc_string_equal(target, slc_from_c_str("value")))
+	{
+		predicate->target = PREDICATE_VALUE;
+	}
+	else
+	{
+		*message = "predicates must test the 'type' or the 'value'";
+		return NULL;
+	}
+	
+	p = target.end;
+	if(p < end && *p == '=')
+	{
+		predicate->op = OP_EQUAL;
+	}
+	else if(p + 1 < end && *p == '!' && p[1] == '=')
+	{
+		predicate->op = OP_NOT_EQUAL;
+		p++;
+	}
+	else if(p < end && (*p == '<' || *p == '>'))
+	{
+		bool or_equal = p + 1 < end && p[1] == '=';
+		if(*p == '<')
+			predicate->op = or_equal ? OP_LESS_EQUAL : OP_LESS;
+		else
+			predicate->op = or_equal ? OP_GREATER_EQUAL : OP_GREATER;
+		p += or_equal;
+	}
+	else
+	{
+		*message = "expected '=', '!=', '<', '<=', '>' or '>=' in a predicate";
+		return NULL;
+	}
+	p++;
+	
+	/* Quotes allow the operand to contain ']' */
+	if(p < end && *p == '"')
+	{
+		p++;
+		predicate->operand.start = p;
+		while(p < end && *p != '"')
+			p++;
+		if(p == end)
+		{
+			*message = "unterminated quoted operand";
+			return NULL;
+		}
+		predicate->operand.end = p;
+		p++;
+	}
+	else
+	{
+		predicate->operand.start = p;
+		while(p < end && *p != ']')
+			p++;
+		predicate->operand.end = p;
+	}
+	
+	if(p == end || *p != ']')
+	{
+		*message = "expected ']' after a predicate";
+		return NULL;
+	}
+	
+	if(predicate->op != OP_EQUAL && predicate->op != OP_NOT_EQUAL)
+	{
+		if(predicate->target == PREDICATE_TYPE)
+		{
+			*message = "types can only be compared with '=' and '!='";
+			return NULL;
+		}
+		if(!_slc_parse_double(predicate->operand, &predicate->number))
+		{
+			*message = "values can only be ordered against numbers";
+			return NULL;
+		}
+	}
+	
+	return p + 1;
+}
+
+static
+bool parse_query(SLCONFIG_QUERY* query, const char** message)
+{
+	const char* p = query->text.start;
+	const char* end = query->text.end;
+	
+	while(true)
+	{
+		STEP* step = &query->steps[query->num_steps];
+		step->pattern.start = p;
+		while(p < end && *p != ':' && *p != '[')
+			p++;
+		step->pattern.end = p;
+		step->first_predicate = query->num_predicates;
+		step->num_predicates = 0;
+		
+		if(step->pattern.start == step->pattern.end)
+		{
+			*message = "empty step";
+			return false;
+		}
+		
+		if(slc_string_equal(step->pattern, slc_from_c_str("**")))
+			step->kind = STEP_ANY_DEPTH;
+		else if(memchr(step->pattern.start, '*', slc_string_length(step->pattern)))
+			step->kind = STEP_PATTERN;
+		else
+			step->kind = STEP_NAME;
+		
+		while(p < end && *p == '[')
+		{
+			if(step->kind == STEP_ANY_DEPTH)
+			{
+				*message = "'**' cannot have predicates";
+				return false;
+			}
+			
+			p = parse_predicate(query, p + 1, &query->predicates[query->num_predicates], message);
+			if(!p)
+				return false;
+			query->num_predicates++;
+			step->num_predicates++;
+		}
+		
+		/* Consecutive '**' match the same nodes as a single one */
+		bool redundant = step->kind == STEP_ANY_DEPTH && query->num_steps && step[-1].kind == STEP_ANY_DEPTH;
+		if(!redundant)
+			query->num_steps++;
+		
+		if(p == end)
+			break;
+		if(*p != ':')
+		{
+			*message = "expected ':' between steps";
+			return false;
+		}
+		p++;
+	}
+	
+	/* A trailing '**' matches everything under the node before it, but not that node itself */
+	if(query->steps[query->num_steps - 1].kind == STEP_ANY_DEPTH)
+	{
+		STEP* step = &query->steps[query->num_steps++];
+		step->kind = STEP_PATTERN;
+		step->pattern = slc_from_c_str("*");
+		step->first_predicate = query->num_predicates;
+		step->num_predicates = 0;
+	}
+	
+	if(query->num_steps > MAX_STEPS)
+	{
+		*message = "too many steps";
+		return false;
+	}
+	return true;
+}
+
+SLCONFIG_QUERY* slc_query_compile(SLCONFIG_STRING query_str, const SLCONFIG_VTABLE* vtable_ptr)
+{
+	SLCONFIG_VTABLE vtable;
+	if(vtable_ptr)
+		memcpy(&vtable, vtable_ptr, sizeof(SLCONFIG_VTABLE));
+	else
+		memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	_slc_fill_vtable(&vtable);
+	
+	SLCONFIG_QUERY* query = vtable.realloc(0, sizeof(SLCONFIG_QUERY));
+	memset(query, 0, sizeof(SLCONFIG_QUERY));
+	query->vtable = vtable;
+	
+	/* Every step but the first follows a ':', and a trailing '**' adds one more */
+	size_t len = slc_string_length(query_str);
+	size_t max_steps = count_chars(query_str, ':') + 2;
+	size_t max_predicates = count_chars(query_str, '[');
+	char* text = vtable.realloc(0, len ? len : 1);
+	memcpy(text, query_str.start, len);
+	query->text.start = text;
+	query->text.end = text + len;
+	query->steps = vtable.realloc(0, max_steps * sizeof(STEP));
+	if(max_predicates)
+		query->predicates = vtable.realloc(0, max_predicates * sizeof(PREDICATE));
+	
+	const char* message = NULL;
+	if(!parse_query(query, &message))
+	{
+		query_error(&vtable, query_str, message);
+		slc_destroy_query(query);
+		return NULL;
+	}
+	
+	return query;
+}
+
+void slc_destroy_query(SLCONFIG_QUERY* query)
+{
+	if(!query)
+		return;
+	
+	void* (*custom_realloc)(void*, size_t) = query->vtable.realloc;
+	custom_realloc((char*)query->text.start, 0);
+	custom_realloc(query->steps, 0);
+	if(query->predicates)
+		custom_realloc(query->predicates, 0);
+	custom_realloc(query, 0);
+}
+
+static
+bool match_pattern(SLCONFIG_STRING pattern, SLCONFIG_STRING name)
+{
+	const char* p = pattern.start;
+	const char* s = name.start;
+	/* Where to resume after the last '*' when the rest of the pattern fails to match */
+	const char* star = NULL;
+	const char* resume = NULL;
+	
+	while(s < name.end)
+	{
+		if(p < pattern.end && *p == '*')
+		{
+			star = ++p;
+			resume = s;
+		}
+		else if(p < pattern.end && *p == *s)
+		{
+			p++;
+			s++;
+		}
+		else if(star)
+		{
+			p = star;
+			s = ++resume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	
+	while(p < pattern.end && *p == '*')
+		p++;
+	return p == pattern.end;
+}
+
+static
+bool match_predicate(const PREDICATE* predicate, const SLCONFIG_NODE* node)
+{
+	if(predicate->target == PREDICATE_TYPE)
+		return slc_string_equal(node->type, predicate->operand) == (predicate->op == OP_EQUAL);
+	
+	if(node->is_aggregate)
+		return false;
+	
+	switch(predicate->op)
+	{
+		case OP_EQUAL:
+			return slc_string_equal(node->value, predicate->operand);
+		case OP_NOT_EQUAL:
+			return !slc_string_equal(node->value, predicate->operand);
+		default:
+			break;
+	}
+	
+	double value;
+	if(!_slc_get_double(node, &value))
+		return false;
+	
+	switch(predicate->op)
+	{
+		case OP_LESS:
+			return value < predicate->number;
+		case OP_LESS_EQUAL:
+			return value <= predicate->number;
+		case OP_GREATER:
+			return value > predicate->number;
+		default:
+			return value >= predicate->number;
+	}
+}
+
+static
+bool match_step(const SLCONFIG_QUERY* query, const STEP* step, const SLCONFIG_NODE* node)
+{
+	if(step->kind == STEP_NAME && !slc_string_equal(step->pattern, node->name))
+		return false;
+	if(step->kind == STEP_PATTERN && !match_pattern(step->pattern, node->name))
+		return false;
+	
+	for(size_t ii = 0; ii < step->num_predicates; ii++)
+	{
+		if(!match_predicate(&query->predicates[step->first_predicate + ii], node))
+			return false;
+	}
+	return true;
+}
+
+/* Adds the steps that follow a '**', as it can match no levels at all */
+static
+uint64_t close_states(const SLCONFIG_QUERY* query, uint64_t states)
+{
+	for(size_t ii = 0; ii < query->num_steps; ii++)
+	{
+		if((states & ((uint64_t)1 << ii)) && query->steps[ii].kind == STEP_ANY_DEPTH)
+			states |= (uint64_t)1 << (ii + 1);
+	}
+	return states;
+}
+
+static
+uint64_t advance_states(const SLCONFIG_QUERY* query, uint64_t states, const SLCONFIG_NODE* child)
+{
+	uint64_t ret = 0;
+	for(size_t ii = 0; ii < query->num_steps; ii++)
+	{
+		if(!(states & ((uint64_t)1 << ii)))
+			continue;
+		
+		const STEP* step = &query->steps[ii];
+		if(step->kind == STEP_ANY_DEPTH)
+			ret |= (uint64_t)1 << ii;
+		else if(match_step(query, step, child))
+			ret |= (uint64_t)1 << (ii + 1);
+	}
+	return close_states(query, ret);
+}
+
+/* The step a set of states consists of, or query->num_steps if there are several */
+static
+size_t single_step(const SLCONFIG_QUERY* query, uint64_t states)
+{
+	for(size_t ii = 0; ii < query->num_steps; ii++)
+	{
+		if(states == (uint64_t)1 << ii)
+			return ii;
+	}
+	return query->num_steps;
+}
+
+size_t slc_query_exec(const SLCONFIG_QUERY* query, SLCONFIG_NODE* aggregate, bool (*callback)(SLCONFIG_NODE* node, void* data), void* data)
+{
+	assert(query);
+	assert(aggregate);
+	if(!aggregate->is_aggregate)
+		return 0;
+	
+	CONFIG* config = aggregate->config;
+	_slc_begin_read(config);
+	
+	const uint64_t matched = (uint64_t)1 << query->num_steps;
+	size_t num_matches = 0;
+	FRAME* stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	
+	stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(FRAME));
+	stack[stack_size].node = aggregate;
+	stack[stack_size].states = close_states(query, 1);
+	stack_size++;
+	
+	/* Children are pushed in reverse, so that the matches are reported in the order they appear in the tree */
+	while(stack_size)
+	{
+		FRAME frame = stack[--stack_size];
+		if(frame.states & matched)
+		{
+			num_matches++;
+			if(callback && !callback(frame.node, data))
+				break;
+		}
+		
+		uint64_t pending = frame.states & ~matched;
+		if(!frame.node->is_aggregate || !pending)
+			continue;
+		
+		/* A lone name can only match one child, which can be looked up rather than searched for */
+		size_t step = single_step(query, pending);
+		if(step < query->num_steps && query->steps[step].kind == STEP_NAME)
+		{
+			SLCONFIG_NODE* child = _slc_get_node(frame.node, query->steps[step].pattern);
+			uint64_t states = child ? advance_states(query, pending, child) : 0;
+			if((states & matched) || (child && child->is_aggregate && states))
+			{
+				stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(FRAME));
+				stack[stack_size].node = child;
+				stack[stack_size].states = states;
+				stack_size++;
+			}
+			continue;
+		}
+		
+		for(size_t ii = frame.node->num_children; ii > 0; ii--)
+		{
+			SLCONFIG_NODE* child = frame.node->children[ii - 1];
+			uint64_t states = advance_states(query, pending, child);
+			if((states & matched) || (child->is_aggregate && states))
+			{
+				stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(FRAME));
+				stack[stack_size].node = child;
+				stack[stack_size].states = states;
+				stack_size++;
+			}
+		}
+	}
+	
+	config->vtable.realloc(stack, 0);
+	_slc_end_read(config);
+	return num_matches;
+}
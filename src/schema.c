@@ -0,0 +1,458 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "slconfig/slconfig.h"
+#include "slconfig/internal/slconfig.h"
+#include "slconfig/internal/utils.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define NO_TYPE ((size_t)-1)
+
+typedef enum
+{
+	VALUE_ANY,
+	VALUE_INT64,
+	VALUE_DOUBLE,
+	VALUE_BOOL
+} VALUE_CHECK;
+
+typedef struct
+{
+	SLCONFIG_STRING name;
+	SLCONFIG_STRING type;
+	bool required;
+} FIELD;
+
+typedef struct
+{
+	SLCONFIG_STRING name;
+	bool is_aggregate;
+	VALUE_CHECK value_check;
+	
+	/* Sorted by name */
+	size_t first_field;
+	size_t num_fields;
+	size_t num_required;
+	
+	/* Whether children not in the field list are allowed, and what type they must have (if any) */
+	bool open;
+	SLCONFIG_STRING open_type;
+} TYPE_DEF;
+
+struct SLCONFIG_SCHEMA
+{
+	SLCONFIG_VTABLE vtable;
+	
+	TYPE_DEF* types;
+	size_t num_types;
+	
+	FIELD* fields;
+	size_t num_fields;
+	
+	/* Open addressing hash table of indices into types, keyed on the type name */
+	size_t* table;
+	size_t table_mask;
+};
+
+static
+int compare_fields(const void* a, const void* b)
+{
+	return _slc_string_compare(((const FIELD*)a)->name, ((const FIELD*)b)->name);
+}
+
+static
+SLCONFIG_STRING copy_string(SLCONFIG_SCHEMA* schema, SLCONFIG_STRING str)
+{
+	SLCONFIG_STRING ret = {0, 0};
+	slc_append_to_string(&ret, str, schema->vtable.realloc);
+	return ret;
+}
+
+/* Start a violation diagnostic about node, which the caller can append to before ending it */
+static
+void begin_violation(const SLCONFIG_NODE* node, const char* message, SLCONFIG_STRING detail, const char* suffix)
+{
+	CONFIG* config = node->config;
+	_slc_begin_error(config, SLCONFIG_ERROR_SCHEMA_VIOLATION, slc_from_c_str(""), 0);
+	_slc_error(config, slc_from_c_str("Error: '"));
+	_slc_error_full_name(config, node);
+	_slc_error(config, slc_from_c_str(message));
+	_slc_error(config, detail);
+	_slc_error(config, slc_from_c_str(suffix));
+}
+
+static
+void violation(const SLCONFIG_NODE* node, const char* message, SLCONFIG_STRING detail, const char* suffix)
+{
+	begin_violation(node, message, detail, suffix);
+	_slc_end_error(node->config);
+}
+
+static
+bool compile_fields(SLCONFIG_SCHEMA* schema, const SLCONFIG_NODE* definition, TYPE_DEF* type_def)
+{
+	type_def->first_field = schema->num_fields;
+	
+	for(size_t ii = 0; ii < definition->num_children; ii++)
+	{
+		const SLCONFIG_NODE* field_node = definition->children[ii];
+		bool required = slc_string_equal(field_node->type, slc_from_c_str("required"));
+		if(!required && !slc_string_equal(field_node->type, slc_from_c_str("optional")))
+		{
+			violation(field_node, "' has type '", field_node->type, "', expected 'required' or 'optional'.\n");
+			return false;
+		}
+		if(field_node->is_aggregate)
+		{
+			violation(field_node, "' must be a string node", slc_from_c_str(""), ".\n");
+			return false;
+		}
+		
+		if(slc_string_equal(field_node->name, slc_from_c_str("*")))
+		{
+			if(required)
+			{
+				violation(field_node, "' cannot be required", slc_from_c_str(""), ".\n");
+				return false;
+			}
+			type_def->open = true;
+			type_def->open_type = copy_string(schema, field_node->value);
+			continue;
+		}
+		
+		schema->fields = schema->vtable.realloc(schema->fields, (schema->num_fields + 1) * sizeof(FIELD));
+		FIELD* field = &schema->fields[schema->num_fields++];
+		field->name = copy_string(schema, field_node->name);
+		field->type = copy_string(schema, field_node->value);
+		field->required = required;
+		
+		type_def->num_fields++;
+		if(required)
+			type_def->num_required++;
+	}
+	
+	qsort(schema->fields + type_def->first_field, type_def->num_fields, sizeof(FIELD), &compare_fields);
+	return true;
+}
+
+static
+bool compile_definition(SLCONFIG_SCHEMA* schema, const SLCONFIG_NODE* definition)
+{
+	schema->types = schema->vtable.realloc(schema->types, (schema->num_types + 1) * sizeof(TYPE_DEF));
+	TYPE_DEF* type_def = &schema->types[schema->num_types++];
+	memset(type_def, 0, sizeof(TYPE_DEF));
+	type_def->name = copy_string(schema, definition->name);
+	
+	if(slc_string_equal(definition->type, slc_from_c_str("aggregate")))
+	{
+		type_def->is_aggregate = true;
+		return compile_fields(schema, definition, type_def);
+	}
+	else if(slc_string_equal(definition->type, slc_from_c_str("string")))
+	{
+		if(definition->is_aggregate)
+		{
+			violation(definition, "' must be a string node", slc_from_c_str(""), ".\n");
+			return false;
+		}
+		
+		SLCONFIG_STRING value = definition->value;
+		if(slc_string_length(value) == 0)
+			type_def->value_check = VALUE_ANY;
+		else if(slc_string_equal(value, slc_from_c_str("int64")))
+			type_def->value_check = VALUE_INT64;
+		else if(slc_string_equal(value, slc_from_c_str("double")))
+			type_def->value_check = VALUE_DOUBLE;
+		else if(slc_string_equal(value, slc_from_c_str("bool")))
+			type_def->value_check = VALUE_BOOL;
+		else
+		{
+			violation(definition, "' has value '", value, "', expected 'int64', 'double', 'bool' or nothing.\n");
+			return false;
+		}
+		return true;
+	}
+	else
+	{
+		violation(definition, "' has type '", definition->type, "', expected 'aggregate' or 'string'.\n");
+		return false;
+	}
+}
+
+static
+size_t find_type(const SLCONFIG_SCHEMA* schema, SLCONFIG_STRING name)
+{
+	size_t slot = (size_t)_slc_hash_string(HASH_SEED, name) & schema->table_mask;
+	while(schema->table[slot] != NO_TYPE)
+	{
+		if(slc_string_equal(schema->types[schema->table[slot]].name, name))
+			return schema->table[slot];
+		slot = (slot + 1) & schema->table_mask;
+	}
+	return NO_TYPE;
+}
+
+static
+void build_table(SLCONFIG_SCHEMA* schema)
+{
+	/* Keep the load factor at or below one half */
+	size_t table_size = 2;
+	while(table_size < schema->num_types * 2)
+		table_size *= 2;
+	
+	schema->table = schema->vtable.realloc(0, table_size * sizeof(size_t));
+	schema->table_mask = table_size - 1;
+	for(size_t ii = 0; ii < table_size; ii++)
+		schema->table[ii] = NO_TYPE;
+	
+	for(size_t ii = 0; ii < schema->num_types; ii++)
+	{
+		size_t slot = (size_t)_slc_hash_string(HASH_SEED, schema->types[ii].name) & schema->table_mask;
+		while(schema->table[slot] != NO_TYPE)
+			slot = (slot + 1) & schema->table_mask;
+		schema->table[slot] = ii;
+	}
+}
+
+static
+SLCONFIG_SCHEMA* create_schema(const SLCONFIG_NODE* aggregate)
+{
+	SLCONFIG_VTABLE vtable = aggregate->config->vtable;
+	SLCONFIG_SCHEMA* schema = vtable.realloc(0, sizeof(SLCONFIG_SCHEMA));
+	memset(schema, 0, sizeof(SLCONFIG_SCHEMA));
+	schema->vtable = vtable;
+	
+	for(size_t ii = 0; ii < aggregate->num_children; ii++)
+	{
+		if(!compile_definition(schema, aggregate->children[ii]))
+		{
+			slc_destroy_schema(schema);
+			return NULL;
+		}
+	}
+	
+	build_table(schema);
+	return schema;
+}
+
+SLCONFIG_SCHEMA* slc_create_schema(const SLCONFIG_NODE* aggregate)
+{
+	assert(aggregate);
+	assert(aggregate->is_aggregate);
+	if(!aggregate->is_aggregate)
+		return NULL;
+	
+	/* Errors in the definitions are reported through the config, so the tree is not shared with readers meanwhile */
+	CONFIG* config = aggregate->config;
+	_slc_begin_write(config);
+	SLCONFIG_SCHEMA* schema = create_schema(aggregate);
+	_slc_end_write(config);
+	return schema;
+}
+
+void slc_destroy_schema(SLCONFIG_SCHEMA* schema)
+{
+	if(!schema)
+		return;
+	
+	void* (*custom_realloc)(void*, size_t) = schema->vtable.realloc;
+	for(size_t ii = 0; ii < schema->num_types; ii++)
+	{
+		slc_destroy_string(&schema->types[ii].name, custom_realloc);
+		slc_destroy_string(&schema->types[ii].open_type, custom_realloc);
+	}
+	for(size_t ii = 0; ii < schema->num_fields; ii++)
+	{
+		slc_destroy_string(&schema->fields[ii].name, custom_realloc);
+		slc_destroy_string(&schema->fields[ii].type, custom_realloc);
+	}
+	
+	if(schema->types)
+		custom_realloc(schema->types, 0);
+	if(schema->fields)
+		custom_realloc(schema->fields, 0);
+	if(schema->table)
+		custom_realloc(schema->table, 0);
+	custom_realloc(schema, 0);
+}
+
+static
+const FIELD* find_field(const SLCONFIG_SCHEMA* schema, const TYPE_DEF* type_def, SLCONFIG_STRING name)
+{
+	const FIELD* fields = schema->fields + type_def->first_field;
+	size_t lo = 0;
+	size_t hi = type_def->num_fields;
+	while(lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = _slc_string_compare(fields[mid].name, name);
+		if(cmp == 0)
+			return &fields[mid];
+		else if(cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+static
+bool check_value(const SLCONFIG_NODE* node, VALUE_CHECK value_check)
+{
+	int64_t int64_value;
+	double double_value;
+	bool bool_value;
+	switch(value_check)
+	{
+		case VALUE_INT64:
+			return _slc_get_int64(node, &int64_value);
+		case VALUE_DOUBLE:
+			return _slc_get_double(node, &double_value);
+		case VALUE_BOOL:
+			return _slc_get_bool(node, &bool_value);
+		default:
+			return true;
+	}
+}
+
+/* Checks a single node and its immediate children against the definition of its type */
+static
+size_t validate_node(const SLCONFIG_SCHEMA* schema, const SLCONFIG_NODE* node)
+{
+	size_t type_idx = find_type(schema, node->type);
+	if(type_idx == NO_TYPE)
+		return 0;
+	
+	const TYPE_DEF* type_def = &schema->types[type_idx];
+	if(type_def->is_aggregate != node->is_aggregate)
+	{
+		violation(node, "' of type '", node->type, type_def->is_aggregate ? "' must be an aggregate.\n" : "' must be a string node.\n");
+		return 1;
+	}
+	
+	if(!node->is_aggregate)
+	{
+		if(check_value(node, type_def->value_check))
+			return 0;
+		
+		const char* expected = type_def->value_check == VALUE_INT64 ? "' which is not an integer.\n" :
+		                       type_def->value_check == VALUE_DOUBLE ? "' which is not a number.\n" :
+		                                                               "' which is not a boolean.\n";
+		violation(node, "' has value '", node->value, expected);
+		return 1;
+	}
+	
+	size_t num_violations = 0;
+	size_t num_required = 0;
+	for(size_t ii = 0; ii < node->num_children; ii++)
+	{
+		const SLCONFIG_NODE* child = node->children[ii];
+		const FIELD* field = find_field(schema, type_def, child->name);
+		SLCONFIG_STRING expected_type;
+		if(field)
+		{
+			num_required += field->required;
+			expected_type = field->type;
+		}
+		else if(type_def->open)
+		{
+			expected_type = type_def->open_type;
+		}
+		else
+		{
+			violation(child, "' is not allowed in an aggregate of type '", node->type, "'.\n");
+			num_violations++;
+			continue;
+		}
+		
+		if(slc_string_length(expected_type) && !slc_string_equal(expected_type, child->type))
+		{
+			begin_violation(child, "' has type '", child->type, "', expected '");
+			_slc_error(node->config, expected_type);
+			_slc_error(node->config, slc_from_c_str("'.\n"));
+			_slc_end_error(node->config);
+			num_violations++;
+		}
+	}
+	
+	/* Only look for the names of the missing children when there are some */
+	if(num_required < type_def->num_required)
+	{
+		const FIELD* fields = schema->fields + type_def->first_field;
+		for(size_t ii = 0; ii < type_def->num_fields; ii++)
+		{
+			if(fields[ii].required && !_slc_get_node((SLCONFIG_NODE*)node, fields[ii].name))
+			{
+				violation(node, "' is missing the required child '", fields[ii].name, "'.\n");
+				num_violations++;
+			}
+		}
+	}
+	
+	return num_violations;
+}
+
+static
+size_t validate(const SLCONFIG_SCHEMA* schema, const SLCONFIG_NODE* node)
+{
+	const SLCONFIG_VTABLE* vtable = &node->config->vtable;
+	size_t num_violations = 0;
+	
+	const SLCONFIG_NODE** stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	
+	const SLCONFIG_NODE* cur = node;
+	while(cur)
+	{
+		num_violations += validate_node(schema, cur);
+		
+		if(cur->num_children > stack_capacity - stack_size)
+		{
+			while(cur->num_children > stack_capacity - stack_size)
+				stack_capacity = stack_capacity ? stack_capacity * 2 : 64;
+			stack = vtable->realloc(stack, stack_capacity * sizeof(SLCONFIG_NODE*));
+		}
+		
+		/* Reversed, so that the nodes are visited in document order */
+		for(size_t ii = cur->num_children; ii > 0; ii--)
+			stack[stack_size++] = cur->children[ii - 1];
+		
+		cur = stack_size ? stack[--stack_size] : NULL;
+	}
+	
+	if(stack)
+		vtable->realloc(stack, 0);
+	return num_violations;
+}
+
+size_t slc_validate(const SLCONFIG_SCHEMA* schema, const SLCONFIG_NODE* node)
+{
+	assert(schema);
+	assert(node);
+	
+	/* Violations are reported through the config, so the tree is not shared with readers meanwhile */
+	CONFIG* config = node->config;
+	_slc_begin_write(config);
+	size_t ret = validate(schema, node);
+	_slc_end_write(config);
+	return ret;
+}
@@ -19,7 +19,11 @@
 #include "slconfig/slconfig.h"
 #include "slconfig/internal/slconfig.h"
 #include "slconfig/internal/parser.h"
+#include "slconfig/internal/file.h"
 #include "slconfig/internal/tokenizer.h"
+#include "slconfig/internal/number.h"
+#include "slconfig/internal/thread.h"
+#include "slconfig/internal/utils.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -66,18 +70,18 @@ void* default_realloc(void* buf, size_t size)
 	return realloc(buf, size);
 }
 
-SLCONFIG_VTABLE default_vtable =
+static const SLCONFIG_VTABLE default_vtable =
 {
 	&default_realloc,
 	&default_error,
 	&default_fopen,
 	&default_fclose,
 	&default_fread,
-	&default_fwrite
+	&default_fwrite,
+	NULL
 };
 
-static
-void fill_vtable(SLCONFIG_VTABLE* vtable)
+void _slc_fill_vtable(SLCONFIG_VTABLE* vtable)
 {
 #define FILL(a) if(!vtable->a) vtable->a = default_vtable.a;
 	FILL(realloc);
@@ -96,12 +100,14 @@ SLCONFIG_NODE* slc_create_root_node(const SLCONFIG_VTABLE* vtable_ptr)
 		memcpy(&vtable, vtable_ptr, sizeof(SLCONFIG_VTABLE));
 	else
 		memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
-	fill_vtable(&vtable);
+	_slc_fill_vtable(&vtable);
 	
 	CONFIG* config = vtable.realloc(0, sizeof(CONFIG));
 	config->vtable = vtable;
 	config->files = NULL;
+	config->file_caches = NULL;
 	config->num_files = 0;
+	config->file_cache = NULL;
 	config->root = vtable.realloc(0, sizeof(SLCONFIG_NODE));
 	memset(config->root, 0, sizeof(SLCONFIG_NODE));
 	config->root->is_aggregate = true;
@@ -113,10 +119,161 @@ SLCONFIG_NODE* slc_create_root_node(const SLCONFIG_VTABLE* vtable_ptr)
 	config->num_search_dirs = 0;
 	config->search_dirs = NULL;
 	config->search_dir_ownerships = 0;
+	config->collect_stats = false;
+	config->load_stats = NULL;
+	config->num_load_stats = 0;
+	config->cur_stats = NO_STATS;
+	config->nested_ns = 0;
+	config->max_depth = 0;
+	config->filter_names = NULL;
+	config->filter_starts = NULL;
+	config->num_filter_paths = 0;
+	config->skipped_statements = NULL;
+	memset(&config->diagnostic, 0, sizeof(SLCONFIG_DIAGNOSTIC));
+	config->error_buffer = NULL;
+	config->error_size = 0;
+	config->error_capacity = 0;
+	config->message_start = 0;
+	config->node_path_start = 0;
+	config->node_path_end = 0;
+	config->num_errors = 0;
+	config->max_errors = 1;
+	config->generation = 0;
+	config->loading = false;
+	config->observers = NULL;
+	config->num_observers = 0;
+	config->shared_strings = NULL;
+	config->num_shared_strings = 0;
+	config->shared_strings_capacity = 0;
+	config->refcount = 1;
+	config->base = NULL;
+	config->frozen_nodes = NULL;
+	config->num_frozen_nodes = 0;
+	config->lock = NULL;
+	config->retired_strings = NULL;
+	config->num_retired_strings = 0;
+	config->retired_nodes = NULL;
+	config->num_retired_nodes = 0;
 	
 	return config->root;
 }
 
+/*
+ * The children that the aggregate owns are handed over to a frozen node, after which they are shared by everything
+ * that lists them and nothing may modify them in place. Each tree copies the ones it needs to change.
+ */
+static
+void freeze_children(SLCONFIG_NODE* aggregate)
+{
+	CONFIG* config = aggregate->config;
+	size_t num_owned = 0;
+	for(size_t ii = 0; ii < aggregate->num_children; ii++)
+	{
+		if(aggregate->children[ii]->parent == aggregate)
+			num_owned++;
+	}
+	if(!num_owned)
+		return;
+	
+	SLCONFIG_NODE* frozen = _slc_realloc(config, 0, sizeof(SLCONFIG_NODE));
+	memset(frozen, 0, sizeof(SLCONFIG_NODE));
+	frozen->is_aggregate = true;
+	frozen->config = config;
+	frozen->children = _slc_realloc(config, NULL, aggregate->num_children * sizeof(SLCONFIG_NODE*));
+	memcpy(frozen->children, aggregate->children, aggregate->num_children * sizeof(SLCONFIG_NODE*));
+	frozen->num_children = aggregate->num_children;
+	for(size_t ii = 0; ii < frozen->num_children; ii++)
+	{
+		if(frozen->children[ii]->parent == aggregate)
+			frozen->children[ii]->parent = frozen;
+	}
+	
+	config->frozen_nodes = _slc_realloc(config, config->frozen_nodes, (config->num_frozen_nodes + 1) * sizeof(SLCONFIG_NODE*));
+	config->frozen_nodes[config->num_frozen_nodes++] = frozen;
+}
+
+/* Whether the node hangs off a frozen node rather than a root. Removed nodes that readers might still hold count too */
+bool _slc_is_frozen(const SLCONFIG_NODE* node)
+{
+	while(node->parent)
+		node = node->parent;
+	return node != node->config->root;
+}
+
+/* Reports an attempt to modify a node shared between trees, which has to go through slc_get_writable_node instead */
+static
+bool is_read_only(const SLCONFIG_NODE* node)
+{
+	if(!_slc_is_frozen(node))
+		return false;
+	
+	CONFIG* config = node->config;
+	_slc_begin_error(config, SLCONFIG_ERROR_READ_ONLY, slc_from_c_str(""), 0);
+	_slc_error(config, slc_from_c_str("Error: '"));
+	_slc_error_full_name(config, node);
+	_slc_error(config, slc_from_c_str("' is shared with a fork or an overlay and cannot be modified, get it through slc_get_writable_node first.\n"));
+	_slc_end_error(config);
+	return true;
+}
+
+static
+SLCONFIG_NODE* create_overlay_root(SLCONFIG_NODE* base, const SLCONFIG_VTABLE* vtable)
+{
+	/* The base shares its children from now on. Children of a frozen base are frozen already */
+	if(!_slc_is_frozen(base))
+		freeze_children(base);
+	
+	SLCONFIG_NODE* root = slc_create_root_node(vtable ? vtable : &base->config->vtable);
+	CONFIG* config = root->config;
+	root->generation = base->generation;
+	config->generation = base->config->generation;
+	/* The frozen nodes, and the strings of the shared nodes, belong to the config of the base */
+	config->base = base->config;
+	base->config->refcount++;
+	
+	/* The children stay attached to the frozen node, which is how they are told apart from the nodes the overlay owns */
+	if(base->num_children)
+	{
+		root->children = _slc_realloc(config, NULL, base->num_children * sizeof(SLCONFIG_NODE*));
+		memcpy(root->children, base->children, base->num_children * sizeof(SLCONFIG_NODE*));
+		root->num_children = base->num_children;
+	}
+	
+	return root;
+}
+
+SLCONFIG_NODE* slc_create_overlay_root(SLCONFIG_NODE* base, const SLCONFIG_VTABLE* vtable)
+{
+	assert(base);
+	assert(base->is_aggregate);
+	if(!base->is_aggregate)
+		return NULL;
+	
+	_slc_begin_write(base->config);
+	SLCONFIG_NODE* root = create_overlay_root(base, vtable);
+	_slc_end_write(base->config);
+	return root;
+}
+
+SLCONFIG_NODE* slc_fork_root(SLCONFIG_NODE* node)
+{
+	assert(node);
+	CONFIG* config = node->config;
+	SLCONFIG_NODE* root = config->root;
+	_slc_begin_write(config);
+	SLCONFIG_NODE* fork = create_overlay_root(root, &config->vtable);
+	CONFIG* fork_config = fork->config;
+	fork_config->max_depth = config->max_depth;
+	fork_config->max_errors = config->max_errors;
+	_slc_copy_load_filter(fork_config, config);
+	slc_set_file_cache(fork, config->file_cache);
+	for(size_t ii = 0; ii < config->num_search_dirs; ii++)
+		slc_add_search_directory(fork, config->search_dirs[ii], true);
+	
+	_slc_end_write(config);
+	return fork;
+}
+
 bool _slc_load_file(CONFIG* config, SLCONFIG_STRING filename, SLCONFIG_STRING* file)
 {
 	assert(config);
@@ -125,18 +282,31 @@ bool _slc_load_file(CONFIG* config, SLCONFIG_STRING filename, SLCONFIG_STRING* f
 	size_t total_bytes_read = 0;
 	size_t bytes_read;
 	char* buff = NULL;
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+	uint64_t start_ns = stats ? _slc_get_time_ns() : 0;
+	/* The path the file was found at */
+	SLCONFIG_STRING path = filename;
+	bool own_path = false;
 	void* f = config->vtable.fopen(filename, true);
 	if(!f)
 	{
 		for(size_t ii = 0; ii < config->num_search_dirs && !f; ii++)
 		{
 			SLCONFIG_STRING test_file = {0, 0};
-			slc_append_to_string(&test_file, config->search_dirs[ii], config->vtable.realloc);
-			slc_append_to_string(&test_file, slc_from_c_str("/"), config->vtable.realloc);
-			slc_append_to_string(&test_file, filename, config->vtable.realloc);
+			_slc_append_to_string(config, &test_file, config->search_dirs[ii]);
+			_slc_append_to_string(config, &test_file, slc_from_c_str("/"));
+			_slc_append_to_string(config, &test_file, filename);
 			
 			f = config->vtable.fopen(test_file, true);
-			slc_destroy_string(&test_file, config->vtable.realloc);
+			if(f)
+			{
+				path = test_file;
+				own_path = true;
+			}
+			else
+			{
+				slc_destroy_string(&test_file, config->vtable.realloc);
+			}
 		}
 		
 		if(!f)
@@ -145,7 +315,7 @@ bool _slc_load_file(CONFIG* config, SLCONFIG_STRING filename, SLCONFIG_STRING* f
 	
 	do
 	{
-		buff = config->vtable.realloc(buff, total_bytes_read + BUF_SIZE);
+		buff = _slc_realloc(config, buff, total_bytes_read + BUF_SIZE);
 		bytes_read = config->vtable.fread(buff + total_bytes_read, BUF_SIZE, f);
 		total_bytes_read += bytes_read;
 	} while(bytes_read == BUF_SIZE);
@@ -155,10 +325,25 @@ bool _slc_load_file(CONFIG* config, SLCONFIG_STRING filename, SLCONFIG_STRING* f
 	file->start = buff;
 	file->end = buff + total_bytes_read;
 	
-	_slc_add_file(config, *file);
+	_slc_add_file(config, path, file);
+	if(own_path)
+		slc_destroy_string(&path, config->vtable.realloc);
+	
+	if(stats)
+	{
+		stats->bytes_read += total_bytes_read;
+		stats->load_ns += _slc_get_time_ns() - start_ns;
+	}
 	return true;
 }
 
+static
+void notify_observers(CONFIG* config, SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event)
+{
+	for(size_t ii = 0; ii < config->num_observers; ii++)
+		config->observers[ii].callback(node, event, config->observers[ii].data);
+}
+
 bool slc_load_nodes(SLCONFIG_NODE* aggregate, SLCONFIG_STRING filename)
 {
 	assert(aggregate);
@@ -166,12 +351,30 @@ bool slc_load_nodes(SLCONFIG_NODE* aggregate, SLCONFIG_STRING filename)
 	if(!aggregate->is_aggregate)
 		return false;
 	CONFIG* config = aggregate->config;
+	_slc_begin_write(config);
+	if(is_read_only(aggregate))
+	{
+		_slc_end_write(config);
+		return false;
+	}
+	config->num_errors = 0;
+	uint64_t old_generation = config->root->generation;
+	config->generation++;
+	config->loading = true;
 	_slc_add_include(config, filename, false, 0);
+	size_t outer_stats = _slc_begin_load_stats(config, filename);
 	SLCONFIG_STRING file = {0, 0};
 	bool ret = _slc_load_file(config, filename, &file);
 	if(ret)
 		ret = _slc_parse_file(config, aggregate, filename, file);
+	ret &= _slc_clear_skipped_statements(config);
+	config->cur_stats = outer_stats;
 	_slc_clear_includes(config);
+	config->loading = false;
+	/* A load that fails part way can still change the tree */
+	if(config->root->generation != old_generation)
+		notify_observers(config, aggregate, SLCONFIG_CHANGE_LOAD);
+	_slc_end_write(config);
 	return ret;
 }
 
@@ -182,11 +385,22 @@ bool slc_load_nodes_string(SLCONFIG_NODE* aggregate, SLCONFIG_STRING filename, S
 	if(!aggregate->is_aggregate)
 		return false;
 	CONFIG* config = aggregate->config;
+	_slc_begin_write(config);
+	if(is_read_only(aggregate))
+	{
+		_slc_end_write(config);
+		return false;
+	}
+	config->num_errors = 0;
+	uint64_t old_generation = config->root->generation;
+	config->generation++;
+	config->loading = true;
+	size_t outer_stats = _slc_begin_load_stats(config, filename);
 	SLCONFIG_STRING new_file = {0, 0};
 	if(copy)
 	{
-		slc_append_to_string(&new_file, file, config->vtable.realloc);
-		_slc_add_file(config, new_file);
+		_slc_append_to_string(config, &new_file, file);
+		_slc_add_file(config, filename, &new_file);
 	}
 	else
 	{
@@ -195,29 +409,190 @@ bool slc_load_nodes_string(SLCONFIG_NODE* aggregate, SLCONFIG_STRING filename, S
 	
 	_slc_add_include(config, filename, false, 0);
 	bool ret = _slc_parse_file(config, aggregate, filename, new_file);
+	ret &= _slc_clear_skipped_statements(config);
+	config->cur_stats = outer_stats;
 	_slc_clear_includes(config);
+	config->loading = false;
+	if(config->root->generation != old_generation)
+		notify_observers(config, aggregate, SLCONFIG_CHANGE_LOAD);
+	_slc_end_write(config);
 	return ret;
 }
 
+/* Files being loaded by slc_load_many */
+typedef struct
+{
+	SLCONFIG_NODE* const* aggregates;
+	const SLCONFIG_STRING* filenames;
+	bool* results;
+	bool dedupe;
+} LOAD_MANY;
+
+static
+void load_one(void* arg, size_t task)
+{
+	LOAD_MANY* load = arg;
+	load->results[task] = slc_load_nodes(load->aggregates[task], load->filenames[task]);
+	if(load->dedupe)
+		slc_dedupe(load->aggregates[task]);
+}
+
+bool slc_load_many(SLCONFIG_NODE* const* aggregates, const SLCONFIG_STRING* filenames, size_t num_files, size_t num_threads, SLCONFIG_FILE_CACHE* file_cache, bool dedupe)
+{
+	assert(aggregates || num_files == 0);
+	assert(filenames || num_files == 0);
+	if(num_files == 0)
+		return true;
+	
+	if(file_cache)
+	{
+		for(size_t ii = 0; ii < num_files; ii++)
+			slc_set_file_cache(aggregates[ii], file_cache);
+	}
+	
+	/* The results are kept with the allocator of the first root */
+	void* (*custom_realloc)(void*, size_t) = aggregates[0]->config->vtable.realloc;
+	LOAD_MANY load;
+	load.aggregates = aggregates;
+	load.filenames = filenames;
+	load.results = custom_realloc(0, num_files * sizeof(bool));
+	load.dedupe = dedupe;
+	_slc_parallel_for(num_files, num_threads, &load_one, &load, custom_realloc);
+	
+	bool ret = true;
+	for(size_t ii = 0; ii < num_files; ii++)
+		ret &= load.results[ii];
+	custom_realloc(load.results, 0);
+	return ret;
+}
+
+static
+void reclaim(CONFIG* config)
+{
+	for(size_t ii = 0; ii < config->num_retired_strings; ii++)
+		slc_destroy_string(&config->retired_strings[ii], config->vtable.realloc);
+	_slc_free(config, config->retired_strings);
+	config->retired_strings = NULL;
+	config->num_retired_strings = 0;
+	
+	for(size_t ii = 0; ii < config->num_retired_nodes; ii++)
+		_slc_destroy_node(config->retired_nodes[ii], false);
+	_slc_free(config, config->retired_nodes);
+	config->retired_nodes = NULL;
+	config->num_retired_nodes = 0;
+}
+
+static
+void clear_load_stats(CONFIG* config)
+{
+	for(size_t ii = 0; ii < config->num_load_stats; ii++)
+		slc_destroy_string(&config->load_stats[ii].filename, config->vtable.realloc);
+	_slc_free(config, config->load_stats);
+	config->load_stats = NULL;
+	config->num_load_stats = 0;
+}
+
+static
+void clear_search_directories(CONFIG* config)
+{
+	for(size_t ii = 0; ii < config->num_search_dirs; ii++)
+	{
+		if(config->search_dir_ownerships[ii])
+			slc_destroy_string(&config->search_dirs[ii], config->vtable.realloc);
+	}
+	
+	if(config->search_dirs)
+	{
+		config->vtable.realloc(config->search_dirs, 0);
+		config->vtable.realloc(config->search_dir_ownerships, 0);
+	}
+	
+	config->search_dirs = NULL;
+	config->search_dir_ownerships = NULL;
+	config->num_search_dirs = 0;
+}
+
 static
 void destroy_config(CONFIG* config)
 {
 	if(!config)
 		return;
 	
+	reclaim(config);
+	
 	for(size_t ii = 0; ii < config->num_files; ii++)
-		slc_destroy_string(&config->files[ii], config->vtable.realloc);
+	{
+		if(config->file_caches[ii])
+			_slc_release_cached_file(config->file_caches[ii], config->files[ii]);
+		else
+			slc_destroy_string(&config->files[ii], config->vtable.realloc);
+	}
 	
 	_slc_free(config, config->files);
+	_slc_free(config, config->file_caches);
+	if(config->file_cache)
+		_slc_release_file_cache(config->file_cache);
 	
-	slc_clear_search_directories(config->root);
+	for(size_t ii = 0; ii < config->num_shared_strings; ii++)
+		slc_destroy_string(&config->shared_strings[ii], config->vtable.realloc);
+	_slc_free(config, config->shared_strings);
+	_slc_free(config, config->error_buffer);
+	
+	clear_load_stats(config);
+	clear_search_directories(config);
+	_slc_clear_load_filter(config);
+	_slc_free(config, config->observers);
+	if(config->lock)
+		_slc_destroy_rwlock(config->lock, config->vtable.realloc);
+}
+
+/* The config and its root outlive the destruction of the root while any of its forks or overlays are alive */
+static
+void release_config(CONFIG* config)
+{
+	while(config && --config->refcount == 0)
+	{
+		CONFIG* base = config->base;
+		
+		/* Newer frozen nodes can share the children of the older ones */
+		for(size_t ii = config->num_frozen_nodes; ii > 0; ii--)
+			_slc_destroy_node(config->frozen_nodes[ii - 1], false);
+		_slc_free(config, config->frozen_nodes);
+		
+		destroy_config(config);
+		_slc_free(config, config->root);
+		_slc_free(config, config);
+		
+		config = base;
+	}
 }
 
-void _slc_add_file(CONFIG* config, SLCONFIG_STRING new_file)
+/* Takes over the file, which is replaced by the cached copy if the config uses a file cache */
+void _slc_add_file(CONFIG* config, SLCONFIG_STRING path, SLCONFIG_STRING* new_file)
 {
 	assert(config);
-	config->files = config->vtable.realloc(config->files, (config->num_files + 1) * sizeof(SLCONFIG_STRING));
-	config->files[config->num_files++] = new_file;
+	SLCONFIG_FILE_CACHE* cache = new_file->start ? config->file_cache : NULL;
+	if(cache)
+		*new_file = _slc_cache_file(cache, config, path, *new_file);
+	
+	config->files = _slc_realloc(config, config->files, (config->num_files + 1) * sizeof(SLCONFIG_STRING));
+	config->file_caches = _slc_realloc(config, config->file_caches, (config->num_files + 1) * sizeof(SLCONFIG_FILE_CACHE*));
+	config->files[config->num_files] = *new_file;
+	config->file_caches[config->num_files] = cache;
+	config->num_files++;
+}
+
+void slc_set_file_cache(SLCONFIG_NODE* node, SLCONFIG_FILE_CACHE* cache)
+{
+	assert(node);
+	CONFIG* config = node->config;
+	_slc_begin_write(config);
+	if(cache)
+		_slc_retain_file_cache(cache);
+	if(config->file_cache)
+		_slc_release_file_cache(config->file_cache);
+	config->file_cache = cache;
+	_slc_end_write(config);
 }
 
 static
@@ -245,12 +620,37 @@ void detach_node(SLCONFIG_NODE* node)
 	}
 }
 
-void _slc_destroy_node(SLCONFIG_NODE* node, bool detach)
+void* _slc_grow_stack(const CONFIG* config, void* stack, size_t size, size_t* capacity, size_t frame_size)
 {
-	if(!node)
-		return;
+	if(size < *capacity)
+		return stack;
 	
-	//printf("Clearing %.*s %zu %d\n", (int)slc_string_length(node->name), node->name.start, node->num_children, node->own_comment);
+	*capacity = *capacity ? *capacity * 2 : 16;
+	return config->vtable.realloc(stack, *capacity * frame_size);
+}
+
+/* A node whose children are being visited while walking a tree */
+typedef struct
+{
+	SLCONFIG_NODE* node;
+	/* Used when copying */
+	SLCONFIG_NODE* dest;
+	size_t next_child;
+} WALK_FRAME;
+
+static
+void push_walk_frame(CONFIG* config, WALK_FRAME** stack, size_t* stack_size, size_t* stack_capacity, SLCONFIG_NODE* node, SLCONFIG_NODE* dest)
+{
+	*stack = _slc_grow_stack(config, *stack, *stack_size, stack_capacity, sizeof(WALK_FRAME));
+	WALK_FRAME* frame = &(*stack)[(*stack_size)++];
+	frame->node = node;
+	frame->dest = dest;
+	frame->next_child = 0;
+}
+
+static
+void destroy_strings(SLCONFIG_NODE* node)
+{
 	if(node->own_type)
 		slc_destroy_string(&node->type, node->config->vtable.realloc);
 
@@ -262,54 +662,203 @@ void _slc_destroy_node(SLCONFIG_NODE* node, bool detach)
 	
 	if(node->own_comment)
 		slc_destroy_string(&node->comment, node->config->vtable.realloc);
+}
+
+void _slc_destroy_node(SLCONFIG_NODE* node, bool detach)
+{
+	if(!node)
+		return;
 	
-	for(size_t ii = 0; ii < node->num_children; ii++)
-		_slc_destroy_node(node->children[ii], false);
+	CONFIG* config = node->config;
 	
-	if(node->children)
-		_slc_free(node->config, node->children);
+	/* Children are destroyed before their parents, in order */
+	WALK_FRAME* stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
 	
-	if(node->user_destructor)
-		node->user_destructor(node->user_data);
+	destroy_strings(node);
+	push_walk_frame(config, &stack, &stack_size, &stack_capacity, node, NULL);
+	
+	while(stack_size)
+	{
+		WALK_FRAME* frame = &stack[stack_size - 1];
+		SLCONFIG_NODE* cur = frame->node;
+		if(frame->next_child < cur->num_children)
+		{
+			SLCONFIG_NODE* child = cur->children[frame->next_child++];
+			/* Nodes shared with the base of an overlay belong to the base */
+			if(child->parent != cur)
+				continue;
+			destroy_strings(child);
+			push_walk_frame(config, &stack, &stack_size, &stack_capacity, child, NULL);
+			continue;
+		}
+		
+		stack_size--;
+		
+		if(cur->children)
+			_slc_free(config, cur->children);
+		
+		if(cur->user_destructor)
+			cur->user_destructor(cur->user_data);
+		
+		if(cur != node)
+			_slc_free(config, cur);
+	}
+	_slc_free(config, stack);
 	
 	if(node->parent)
 	{
 		if(detach)
 			detach_node(node);
 		
-		_slc_free(node->config, node);
+		_slc_free(config, node);
+	}
+	else if(node == config->root)
+	{
+		node->children = NULL;
+		node->num_children = 0;
+		release_config(config);
 	}
 	else
 	{
-		CONFIG* config = node->config;
-		destroy_config(config);
+		/* A node that was never attached */
 		_slc_free(config, node);
-		_slc_free(config, config);
 	}
 }
 
 void slc_destroy_node(SLCONFIG_NODE* node)
 {
-	_slc_destroy_node(node, true);
+	if(!node)
+		return;
+	
+	/* Destroying the root ends the use of the tree, so there is nobody to lock it against or to tell about it */
+	CONFIG* config = node->config;
+	if(node == config->root)
+	{
+		_slc_destroy_node(node, true);
+		return;
+	}
+	
+	_slc_begin_write(config);
+	/* A node shared between trees cannot be removed from only one of them through a pointer to it */
+	if(is_read_only(node))
+	{
+		_slc_end_write(config);
+		return;
+	}
+	
+	if(node->parent)
+	{
+		notify_observers(config, node, SLCONFIG_CHANGE_REMOVE);
+		_slc_touch_node(node->parent);
+	}
+	
+	if(config->lock && node->parent)
+	{
+		/* Readers might still hold the node, so it only goes away once it is reclaimed */
+		detach_node(node);
+		config->retired_nodes = _slc_realloc(config, config->retired_nodes, (config->num_retired_nodes + 1) * sizeof(SLCONFIG_NODE*));
+		config->retired_nodes[config->num_retired_nodes++] = node;
+	}
+	else
+	{
+		_slc_destroy_node(node, true);
+	}
+	_slc_end_write(config);
 }
 
-SLCONFIG_NODE* _slc_search_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+void _slc_destroy_children(SLCONFIG_NODE* aggregate)
 {
-	if(!aggregate)
-		return NULL;
+	for(size_t ii = 0; ii < aggregate->num_children; ii++)
+	{
+		SLCONFIG_NODE* child = aggregate->children[ii];
+		if(child->parent == aggregate)
+			_slc_destroy_node(child, false);
+	}
+	_slc_free(aggregate->config, aggregate->children);
+	aggregate->children = NULL;
+	aggregate->num_children = 0;
+}
+
+/*
+ * A node shared with the base of an overlay is replaced by a shallow copy before it is modified. The copy belongs to
+ * the overlay, but still points to the strings and the children of the original.
+ */
+SLCONFIG_NODE* _slc_own_child(SLCONFIG_NODE* aggregate, size_t idx)
+{
+	SLCONFIG_NODE* child = aggregate->children[idx];
+	if(child->parent == aggregate)
+		return child;
 	
-	SLCONFIG_NODE* ret = slc_get_node(aggregate, name);
+	CONFIG* config = aggregate->config;
+	SLCONFIG_NODE* copy = _slc_realloc(config, 0, sizeof(SLCONFIG_NODE));
+	memset(copy, 0, sizeof(SLCONFIG_NODE));
+	copy->type = child->type;
+	copy->name = child->name;
+	copy->value = child->value;
+	copy->comment = child->comment;
+	copy->value_cache = child->value_cache;
+	copy->bool_value = child->bool_value;
+	copy->int64_value = child->int64_value;
+	copy->double_value = child->double_value;
+	copy->generation = child->generation;
+	/* The generations of the base can be ahead, and the changes to the copy have to be newer */
+	if(copy->generation >= config->generation)
+		config->generation = copy->generation + 1;
+	if(child->num_children)
+	{
+		copy->children = _slc_realloc(config, NULL, child->num_children * sizeof(SLCONFIG_NODE*));
+		memcpy(copy->children, child->children, child->num_children * sizeof(SLCONFIG_NODE*));
+		copy->num_children = child->num_children;
+	}
+	copy->parent = aggregate;
+	copy->is_aggregate = child->is_aggregate;
+	copy->config = config;
 	
-	if(ret)
-		return ret;
-	else
-		return _slc_search_node(aggregate->parent, name);
+	aggregate->children[idx] = copy;
+	return copy;
 }
 
-SLCONFIG_NODE* slc_get_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+SLCONFIG_NODE* _slc_get_own_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
 {
 	assert(aggregate);
 	
+	for(size_t ii = 0; ii < aggregate->num_children; ii++)
+	{
+		if(slc_string_equal(name, aggregate->children[ii]->name))
+			return _slc_own_child(aggregate, ii);
+	}
+	
+	return NULL;
+}
+
+SLCONFIG_NODE* _slc_search_own_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+{
+	for(; aggregate; aggregate = aggregate->parent)
+	{
+		SLCONFIG_NODE* ret = _slc_get_own_node(aggregate, name);
+		if(ret)
+			return ret;
+	}
+	
+	return NULL;
+}
+
+SLCONFIG_NODE* _slc_search_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+{
+	for(; aggregate; aggregate = aggregate->parent)
+	{
+		SLCONFIG_NODE* ret = _slc_get_node(aggregate, name);
+		if(ret)
+			return ret;
+	}
+	
+	return NULL;
+}
+
+SLCONFIG_NODE* _slc_get_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+{
 	for(size_t ii = 0; ii < aggregate->num_children; ii++)
 	{
 		if(slc_string_equal(name, aggregate->children[ii]->name))
@@ -319,6 +868,16 @@ SLCONFIG_NODE* slc_get_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
 	return NULL;
 }
 
+/* Children shared with a fork or an overlay are returned as they are, see slc_get_writable_node */
+SLCONFIG_NODE* slc_get_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING name)
+{
+	assert(aggregate);
+	_slc_begin_read(aggregate->config);
+	SLCONFIG_NODE* ret = _slc_get_node(aggregate, name);
+	_slc_end_read(aggregate->config);
+	return ret;
+}
+
 SLCONFIG_NODE* _slc_add_node_no_attach(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool copy_type, SLCONFIG_STRING name, bool copy_name, bool is_aggregate)
 {
 	if(!aggregate)
@@ -326,30 +885,36 @@ SLCONFIG_NODE* _slc_add_node_no_attach(SLCONFIG_NODE* aggregate, SLCONFIG_STRING
 	if(!aggregate->is_aggregate)
 		return NULL;
 	
-	SLCONFIG_NODE* child = slc_get_node(aggregate, name);
+	SLCONFIG_NODE* child = _slc_get_node(aggregate, name);
 	if(child)
 	{
 		if(slc_string_equal(child->type, type) && child->is_aggregate == is_aggregate)
-			return child;
+			return _slc_get_own_node(aggregate, name);
 		else
 			return NULL;
 	}
 	
-	child = aggregate->config->vtable.realloc(0, sizeof(SLCONFIG_NODE));
+	CONFIG* config = aggregate->config;
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+	if(stats)
+		stats->nodes_created++;
+	
+	child = _slc_realloc(config, 0, sizeof(SLCONFIG_NODE));
 	memset(child, 0, sizeof(SLCONFIG_NODE));
 	child->is_aggregate = is_aggregate;
+	child->generation = config->generation;
 	if(copy_name)
-		slc_append_to_string(&child->name, name, aggregate->config->vtable.realloc);
+		_slc_append_to_string(config, &child->name, name);
 	else
 		child->name = name;
 	child->own_name = copy_name;
 	
 	if(copy_type)
-		slc_append_to_string(&child->type, type, aggregate->config->vtable.realloc);
+		_slc_append_to_string(config, &child->type, type);
 	else
 		child->type = type;
 	child->own_type = copy_type;
-	child->config = aggregate->config;
+	child->config = config;
 	
 	//printf("%.*s : %p\n", (int)slc_string_length(name), name.start, child);
 	
@@ -367,12 +932,22 @@ void _slc_attach_node(SLCONFIG_NODE* aggregate, SLCONFIG_NODE* node)
 	assert(node->parent == NULL);
 	//printf("Attaching %.*s to %.*s : %p\n", (int)slc_string_length(node->name), node->name.start, (int)slc_string_length(aggregate->name), aggregate->name.start, aggregate);
 	node->parent = aggregate;
-	aggregate->children = aggregate->config->vtable.realloc(aggregate->children, (aggregate->num_children + 1) * sizeof(SLCONFIG_NODE*));
+	aggregate->children = _slc_realloc(aggregate->config, aggregate->children, (aggregate->num_children + 1) * sizeof(SLCONFIG_NODE*));
 	aggregate->children[aggregate->num_children] = node;
 	aggregate->num_children++;
 }
 
-SLCONFIG_NODE* slc_add_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool own_type, SLCONFIG_STRING name, bool own_name, bool is_aggregate)
+void _slc_touch_node(SLCONFIG_NODE* node)
+{
+	CONFIG* config = node->config;
+	uint64_t generation = config->loading ? config->generation : ++config->generation;
+	node->generation = generation;
+	/* The ancestors of a node changed by the current load have been changed by it as well */
+	for(node = node->parent; node && node->generation != generation; node = node->parent)
+		node->generation = generation;
+}
+
+SLCONFIG_NODE* _slc_add_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool own_type, SLCONFIG_STRING name, bool own_name, bool is_aggregate)
 {
 	SLCONFIG_NODE* node = _slc_add_node_no_attach(aggregate, type, own_type, name, own_name, is_aggregate);
 	if(node)
@@ -380,33 +955,100 @@ SLCONFIG_NODE* slc_add_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool
 	return node;
 }
 
-static
-void get_name_impl(const SLCONFIG_NODE* node, SLCONFIG_STRING* out)
+SLCONFIG_NODE* slc_add_node(SLCONFIG_NODE* aggregate, SLCONFIG_STRING type, bool own_type, SLCONFIG_STRING name, bool own_name, bool is_aggregate)
 {
-	if(node->parent)
+	if(!aggregate)
+		return NULL;
+	_slc_begin_write(aggregate->config);
+	if(is_read_only(aggregate))
+	{
+		_slc_end_write(aggregate->config);
+		return NULL;
+	}
+	
+	size_t num_children = aggregate->num_children;
+	SLCONFIG_NODE* node = _slc_add_node(aggregate, type, own_type, name, own_name, is_aggregate);
+	/* An existing node is returned as it is */
+	if(node && aggregate->num_children != num_children)
 	{
-		get_name_impl(node->parent, out);
-		slc_append_to_string(out, slc_from_c_str(":"), node->config->vtable.realloc);
+		_slc_touch_node(node);
+		notify_observers(aggregate->config, node, SLCONFIG_CHANGE_ADD);
 	}
-	slc_append_to_string(out, node->name, node->config->vtable.realloc);
+	_slc_end_write(aggregate->config);
+	return node;
 }
 
-SLCONFIG_STRING slc_get_full_name(const SLCONFIG_NODE* node)
+size_t _slc_format_full_name(const SLCONFIG_NODE* node, char* buf, size_t capacity)
 {
-	assert(node);
-	SLCONFIG_STRING ret = {0, 0};
-	slc_append_to_string(&ret, slc_from_c_str(":"), node->config->vtable.realloc);
-	get_name_impl(node, &ret);
-	return ret;
-}
+	/* The full name is ':' followed by the names of the ancestors, starting at the root, each followed by ':' */
+	size_t length = 0;
+	for(const SLCONFIG_NODE* cur = node; cur; cur = cur->parent)
+		length += slc_string_length(cur->name) + 1;
+	
+	if(capacity == 0)
+		return length;
+	
+	/* Fill in from the end, dropping whatever does not fit */
+	size_t limit = length < capacity ? length : capacity - 1;
+	size_t pos = length;
+	for(const SLCONFIG_NODE* cur = node; cur; cur = cur->parent)
+	{
+		size_t name_length = slc_string_length(cur->name);
+		pos -= name_length;
+		if(pos < limit && name_length)
+			memcpy(buf + pos, cur->name.start, (pos + name_length <= limit ? name_length : limit - pos));
+		pos--;
+		if(pos < limit)
+			buf[pos] = ':';
+	}
+	buf[limit] = '\0';
+	return length;
+}
 
-bool slc_set_value(SLCONFIG_NODE* string_node, SLCONFIG_STRING value, bool copy)
+size_t slc_format_full_name(const SLCONFIG_NODE* node, char* buf, size_t capacity)
 {
-	assert(string_node);
-	if(string_node->is_aggregate)
+	assert(node);
+	_slc_begin_read(node->config);
+	size_t ret = _slc_format_full_name(node, buf, capacity);
+	_slc_end_read(node->config);
+	return ret;
+}
+
+SLCONFIG_STRING slc_get_full_name(const SLCONFIG_NODE* node)
+{
+	assert(node);
+	_slc_begin_read(node->config);
+	size_t length = _slc_format_full_name(node, NULL, 0);
+	char* buf = node->config->vtable.realloc(0, length + 1);
+	_slc_format_full_name(node, buf, length + 1);
+	_slc_end_read(node->config);
+	SLCONFIG_STRING ret = {buf, buf + length};
+	return ret;
+}
+
+/* Readers might still hold a string that is replaced in concurrent mode, so it is kept until it is reclaimed */
+void _slc_retire_string(CONFIG* config, SLCONFIG_STRING* str)
+{
+	if(config->lock)
+	{
+		config->retired_strings = _slc_realloc(config, config->retired_strings, (config->num_retired_strings + 1) * sizeof(SLCONFIG_STRING));
+		config->retired_strings[config->num_retired_strings++] = *str;
+		str->start = str->end = NULL;
+	}
+	else
+	{
+		slc_destroy_string(str, config->vtable.realloc);
+	}
+}
+
+/* Nodes shared between trees are refused by all of the setters, which report it */
+static
+bool set_value(SLCONFIG_NODE* string_node, SLCONFIG_STRING value, bool copy)
+{
+	if(string_node->is_aggregate || is_read_only(string_node))
 		return false;
 	if(string_node->own_value)
-		slc_destroy_string(&string_node->value, string_node->config->vtable.realloc);
+		_slc_retire_string(string_node->config, &string_node->value);
 	if(copy)
 	{
 		string_node->value.start = string_node->value.end = 0;
@@ -417,14 +1059,34 @@ bool slc_set_value(SLCONFIG_NODE* string_node, SLCONFIG_STRING value, bool copy)
 		string_node->value = value;
 	}
 	string_node->own_value = copy;
+	string_node->value_cache = 0;
+	_slc_touch_node(string_node);
 	return true;
 }
 
-void slc_set_comment(SLCONFIG_NODE* node, SLCONFIG_STRING comment, bool copy)
+bool slc_set_value(SLCONFIG_NODE* string_node, SLCONFIG_STRING value, bool copy)
+{
+	assert(string_node);
+	_slc_begin_write(string_node->config);
+	bool ret = set_value(string_node, value, copy);
+	if(ret)
+		notify_observers(string_node->config, string_node, SLCONFIG_CHANGE_VALUE);
+	_slc_end_write(string_node->config);
+	return ret;
+}
+
+bool slc_set_comment(SLCONFIG_NODE* node, SLCONFIG_STRING comment, bool copy)
 {
 	assert(node);
+	_slc_begin_write(node->config);
+	if(is_read_only(node))
+	{
+		_slc_end_write(node->config);
+		return false;
+	}
+	
 	if(node->own_comment)
-		slc_destroy_string(&node->comment, node->config->vtable.realloc);
+		_slc_retire_string(node->config, &node->comment);
 	if(copy)
 	{
 		node->comment.start = node->comment.end = 0;
@@ -435,21 +1097,238 @@ void slc_set_comment(SLCONFIG_NODE* node, SLCONFIG_STRING comment, bool copy)
 		node->comment = comment;
 	}
 	node->own_comment = copy;
+	_slc_touch_node(node);
+	notify_observers(node->config, node, SLCONFIG_CHANGE_COMMENT);
+	_slc_end_write(node->config);
+	return true;
 }
 
 SLCONFIG_STRING slc_get_value(const SLCONFIG_NODE* string_node)
 {
 	assert(string_node);
 	assert(!string_node->is_aggregate);
+	SLCONFIG_STRING ret = {0, 0};
+	if(!string_node->is_aggregate)
+	{
+		_slc_begin_read(string_node->config);
+		ret = string_node->value;
+		_slc_end_read(string_node->config);
+	}
+	return ret;
+}
+
+/*
+ * The typed getters decode the value once and cache the result (including failure) in the node. The node is only
+ * logically const, as the cache is not observable state. Readers share the lock in concurrent mode, so there they
+ * decode the value without caching it, leaving the cache to the setters.
+ */
+bool _slc_get_int64(const SLCONFIG_NODE* string_node, int64_t* value)
+{
 	if(string_node->is_aggregate)
+		return false;
+	
+	SLCONFIG_NODE* node = (SLCONFIG_NODE*)string_node;
+	if(!(node->value_cache & VALUE_CACHE_INT64) && node->config->lock)
+		return _slc_parse_int64(node->value, value);
+	
+	if(!(node->value_cache & VALUE_CACHE_INT64))
 	{
-		SLCONFIG_STRING ret = {0, 0};
-		return ret;
+		if(_slc_parse_int64(node->value, &node->int64_value))
+			node->value_cache |= VALUE_CACHE_INT64_VALID;
+		node->value_cache |= VALUE_CACHE_INT64;
 	}
-	else
+	
+	if(!(node->value_cache & VALUE_CACHE_INT64_VALID))
+		return false;
+	*value = node->int64_value;
+	return true;
+}
+
+bool slc_get_int64(const SLCONFIG_NODE* string_node, int64_t* value)
+{
+	assert(string_node);
+	assert(!string_node->is_aggregate);
+	_slc_begin_read(string_node->config);
+	bool ret = _slc_get_int64(string_node, value);
+	_slc_end_read(string_node->config);
+	return ret;
+}
+
+bool _slc_get_double(const SLCONFIG_NODE* string_node, double* value)
+{
+	if(string_node->is_aggregate)
+		return false;
+	
+	SLCONFIG_NODE* node = (SLCONFIG_NODE*)string_node;
+	if(!(node->value_cache & VALUE_CACHE_DOUBLE) && node->config->lock)
+		return _slc_parse_double(node->value, value);
+	
+	if(!(node->value_cache & VALUE_CACHE_DOUBLE))
 	{
-		return string_node->value;
+		if(_slc_parse_double(node->value, &node->double_value))
+			node->value_cache |= VALUE_CACHE_DOUBLE_VALID;
+		node->value_cache |= VALUE_CACHE_DOUBLE;
 	}
+	
+	if(!(node->value_cache & VALUE_CACHE_DOUBLE_VALID))
+		return false;
+	*value = node->double_value;
+	return true;
+}
+
+bool slc_get_double(const SLCONFIG_NODE* string_node, double* value)
+{
+	assert(string_node);
+	assert(!string_node->is_aggregate);
+	_slc_begin_read(string_node->config);
+	bool ret = _slc_get_double(string_node, value);
+	_slc_end_read(string_node->config);
+	return ret;
+}
+
+bool _slc_get_bool(const SLCONFIG_NODE* string_node, bool* value)
+{
+	if(string_node->is_aggregate)
+		return false;
+	
+	SLCONFIG_NODE* node = (SLCONFIG_NODE*)string_node;
+	if(!(node->value_cache & VALUE_CACHE_BOOL) && node->config->lock)
+		return _slc_parse_bool(node->value, value);
+	
+	if(!(node->value_cache & VALUE_CACHE_BOOL))
+	{
+		if(_slc_parse_bool(node->value, &node->bool_value))
+			node->value_cache |= VALUE_CACHE_BOOL_VALID;
+		node->value_cache |= VALUE_CACHE_BOOL;
+	}
+	
+	if(!(node->value_cache & VALUE_CACHE_BOOL_VALID))
+		return false;
+	*value = node->bool_value;
+	return true;
+}
+
+bool slc_get_bool(const SLCONFIG_NODE* string_node, bool* value)
+{
+	assert(string_node);
+	assert(!string_node->is_aggregate);
+	_slc_begin_read(string_node->config);
+	bool ret = _slc_get_bool(string_node, value);
+	_slc_end_read(string_node->config);
+	return ret;
+}
+
+size_t slc_get_values(const SLCONFIG_NODE* aggregate, SLCONFIG_STRING* values, size_t capacity)
+{
+	assert(aggregate);
+	assert(aggregate->is_aggregate);
+	if(!aggregate->is_aggregate)
+		return 0;
+	
+	_slc_begin_read(aggregate->config);
+	size_t num_values = aggregate->num_children < capacity ? aggregate->num_children : capacity;
+	size_t ii;
+	for(ii = 0; ii < num_values; ii++)
+	{
+		const SLCONFIG_NODE* child = aggregate->children[ii];
+		if(child->is_aggregate)
+			break;
+		values[ii] = child->value;
+	}
+	_slc_end_read(aggregate->config);
+	return ii;
+}
+
+size_t slc_get_int64s(const SLCONFIG_NODE* aggregate, int64_t* values, size_t capacity)
+{
+	assert(aggregate);
+	assert(aggregate->is_aggregate);
+	if(!aggregate->is_aggregate)
+		return 0;
+	
+	_slc_begin_read(aggregate->config);
+	size_t num_values = aggregate->num_children < capacity ? aggregate->num_children : capacity;
+	size_t ii;
+	for(ii = 0; ii < num_values; ii++)
+	{
+		if(!_slc_get_int64(aggregate->children[ii], &values[ii]))
+			break;
+	}
+	_slc_end_read(aggregate->config);
+	return ii;
+}
+
+size_t slc_get_doubles(const SLCONFIG_NODE* aggregate, double* values, size_t capacity)
+{
+	assert(aggregate);
+	assert(aggregate->is_aggregate);
+	if(!aggregate->is_aggregate)
+		return 0;
+	
+	_slc_begin_read(aggregate->config);
+	size_t num_values = aggregate->num_children < capacity ? aggregate->num_children : capacity;
+	size_t ii;
+	for(ii = 0; ii < num_values; ii++)
+	{
+		if(!_slc_get_double(aggregate->children[ii], &values[ii]))
+			break;
+	}
+	_slc_end_read(aggregate->config);
+	return ii;
+}
+
+bool slc_set_int64(SLCONFIG_NODE* string_node, int64_t value)
+{
+	char buf[NUMBER_BUFFER_SIZE];
+	SLCONFIG_STRING str = {buf, buf + _slc_format_int64(value, buf)};
+	_slc_begin_write(string_node->config);
+	if(!set_value(string_node, str, true))
+	{
+		_slc_end_write(string_node->config);
+		return false;
+	}
+	
+	string_node->int64_value = value;
+	string_node->value_cache = VALUE_CACHE_INT64 | VALUE_CACHE_INT64_VALID;
+	notify_observers(string_node->config, string_node, SLCONFIG_CHANGE_VALUE);
+	_slc_end_write(string_node->config);
+	return true;
+}
+
+bool slc_set_double(SLCONFIG_NODE* string_node, double value)
+{
+	char buf[NUMBER_BUFFER_SIZE];
+	SLCONFIG_STRING str = {buf, buf + _slc_format_double(value, buf)};
+	_slc_begin_write(string_node->config);
+	if(!set_value(string_node, str, true))
+	{
+		_slc_end_write(string_node->config);
+		return false;
+	}
+	
+	/* The formatted string always parses back to the same value, NaN aside */
+	string_node->double_value = value;
+	string_node->value_cache = VALUE_CACHE_DOUBLE | VALUE_CACHE_DOUBLE_VALID;
+	notify_observers(string_node->config, string_node, SLCONFIG_CHANGE_VALUE);
+	_slc_end_write(string_node->config);
+	return true;
+}
+
+bool slc_set_bool(SLCONFIG_NODE* string_node, bool value)
+{
+	/* String literals live forever, so there is no need to copy them */
+	_slc_begin_write(string_node->config);
+	if(!set_value(string_node, slc_from_c_str(value ? "true" : "false"), false))
+	{
+		_slc_end_write(string_node->config);
+		return false;
+	}
+	
+	string_node->bool_value = value;
+	string_node->value_cache = VALUE_CACHE_BOOL | VALUE_CACHE_BOOL_VALID;
+	notify_observers(string_node->config, string_node, SLCONFIG_CHANGE_VALUE);
+	_slc_end_write(string_node->config);
+	return true;
 }
 
 bool slc_is_aggregate(const SLCONFIG_NODE* node)
@@ -461,69 +1340,105 @@ bool slc_is_aggregate(const SLCONFIG_NODE* node)
 SLCONFIG_STRING slc_get_type(const SLCONFIG_NODE* node)
 {
 	assert(node);
-	return node->type;
+	_slc_begin_read(node->config);
+	SLCONFIG_STRING ret = node->type;
+	_slc_end_read(node->config);
+	return ret;
 }
 
 SLCONFIG_STRING slc_get_name(const SLCONFIG_NODE* node)
 {
 	assert(node);
-	return node->name;
+	_slc_begin_read(node->config);
+	SLCONFIG_STRING ret = node->name;
+	_slc_end_read(node->config);
+	return ret;
 }
 
 SLCONFIG_STRING slc_get_comment(const SLCONFIG_NODE* node)
 {
 	assert(node);
-	return node->comment;
+	_slc_begin_read(node->config);
+	SLCONFIG_STRING ret = node->comment;
+	_slc_end_read(node->config);
+	return ret;
 }
 
 SLCONFIG_NODE* slc_get_node_by_index(SLCONFIG_NODE* aggregate, size_t idx)
 {
 	assert(aggregate);
 	assert(aggregate->is_aggregate);
-	assert(idx < aggregate->num_children);
-	
-	if(aggregate->is_aggregate)
-		return aggregate->children[idx];
-	else
+	if(!aggregate->is_aggregate)
 		return NULL;
+	
+	_slc_begin_read(aggregate->config);
+	SLCONFIG_NODE* ret = idx < aggregate->num_children ? aggregate->children[idx] : NULL;
+	_slc_end_read(aggregate->config);
+	return ret;
 }
 
 size_t slc_get_num_children(const SLCONFIG_NODE* node)
 {
 	assert(node);
-	if(node->is_aggregate)
-		return node->num_children;
-	else
+	if(!node->is_aggregate)
 		return 0;
+	
+	_slc_begin_read(node->config);
+	size_t ret = node->num_children;
+	_slc_end_read(node->config);
+	return ret;
 }
 
-void _slc_copy_into(SLCONFIG_NODE* dest, SLCONFIG_NODE* src)
+static
+void copy_contents(SLCONFIG_NODE* dest, SLCONFIG_NODE* src)
 {
-	dest->type = src->type;
-	dest->own_type = src->own_type;
-	dest->name = src->name;
-	dest->own_name = src->own_name;
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(dest->config);
+	if(stats)
+		stats->nodes_copied++;
 	
 	dest->value.start = NULL;
 	dest->value.end = NULL;
-	slc_append_to_string(&dest->value, src->value, src->config->vtable.realloc);
+	_slc_append_to_string(dest->config, &dest->value, src->value);
 	dest->own_value = true;
+	dest->value_cache = src->value_cache;
+	dest->bool_value = src->bool_value;
+	dest->int64_value = src->int64_value;
+	dest->double_value = src->double_value;
 	
 	dest->is_aggregate = src->is_aggregate;
 	dest->num_children = 0;
 	dest->children = NULL;
 	
-	/* Don't touch the parent */
+	/* Don't touch the parent, type or name */
+}
+
+void _slc_copy_into(SLCONFIG_NODE* dest, SLCONFIG_NODE* src)
+{
+	CONFIG* config = dest->config;
+	WALK_FRAME* stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	
+	copy_contents(dest, src);
+	push_walk_frame(config, &stack, &stack_size, &stack_capacity, src, dest);
 	
-	if(src->is_aggregate)
+	while(stack_size)
 	{
-		for(size_t ii = 0; ii < src->num_children; ii++)
+		WALK_FRAME* frame = &stack[stack_size - 1];
+		if(frame->next_child < frame->node->num_children)
 		{
-			SLCONFIG_NODE* child = src->children[ii];
-			SLCONFIG_NODE* new_node = slc_add_node(dest, child->type, false, child->name, false, child->is_aggregate);
-			_slc_copy_into(new_node, child);
+			SLCONFIG_NODE* child = frame->node->children[frame->next_child++];
+			/* Owned strings are copied, as the source might be destroyed before the copy */
+			SLCONFIG_NODE* new_node = _slc_add_node(frame->dest, child->type, child->own_type, child->name, child->own_name, child->is_aggregate);
+			copy_contents(new_node, child);
+			push_walk_frame(config, &stack, &stack_size, &stack_capacity, child, new_node);
+		}
+		else
+		{
+			stack_size--;
 		}
 	}
+	_slc_free(config, stack);
 }
 
 bool _slc_add_include(CONFIG* config, SLCONFIG_STRING filename, bool own, size_t line)
@@ -536,9 +1451,9 @@ bool _slc_add_include(CONFIG* config, SLCONFIG_STRING filename, bool own, size_t
 			return false;
 	}
 	
-	config->include_list = config->vtable.realloc(config->include_list, sizeof(SLCONFIG_STRING) * (config->num_includes + 1));
-	config->include_ownerships = config->vtable.realloc(config->include_ownerships, sizeof(bool) * (config->num_includes + 1));
-	config->include_lines = config->vtable.realloc(config->include_lines, sizeof(size_t) * config->num_includes);
+	config->include_list = _slc_realloc(config, config->include_list, sizeof(SLCONFIG_STRING) * (config->num_includes + 1));
+	config->include_ownerships = _slc_realloc(config, config->include_ownerships, sizeof(bool) * (config->num_includes + 1));
+	config->include_lines = _slc_realloc(config, config->include_lines, sizeof(size_t) * config->num_includes);
 	
 	config->include_list[config->num_includes] = filename;
 	config->include_ownerships[config->num_includes] = own;
@@ -584,23 +1499,73 @@ void _slc_clear_includes(CONFIG* config)
 void slc_set_user_data(SLCONFIG_NODE* node, intptr_t data, void (*user_destructor)(intptr_t))
 {
 	assert(node);
+	_slc_begin_write(node->config);
 	if(node->user_destructor)
 		node->user_destructor(node->user_data);
 	
 	node->user_data = data;
 	node->user_destructor = user_destructor;
+	_slc_end_write(node->config);
 }
 
 intptr_t slc_get_user_data(SLCONFIG_NODE* node)
 {
 	assert(node);
-	return node->user_data;
+	_slc_begin_read(node->config);
+	intptr_t ret = node->user_data;
+	_slc_end_read(node->config);
+	return ret;
+}
+
+uint64_t slc_get_generation(const SLCONFIG_NODE* node)
+{
+	assert(node);
+	_slc_begin_read(node->config);
+	uint64_t ret = node->generation;
+	_slc_end_read(node->config);
+	return ret;
+}
+
+void slc_add_observer(SLCONFIG_NODE* node, void (*observer)(SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event, void* data), void* data)
+{
+	assert(node);
+	assert(observer);
+	CONFIG* config = node->config;
+	_slc_begin_write(config);
+	config->observers = _slc_realloc(config, config->observers, (config->num_observers + 1) * sizeof(OBSERVER));
+	config->observers[config->num_observers].callback = observer;
+	config->observers[config->num_observers].data = data;
+	config->num_observers++;
+	_slc_end_write(config);
+}
+
+bool slc_remove_observer(SLCONFIG_NODE* node, void (*observer)(SLCONFIG_NODE* node, SLCONFIG_CHANGE_EVENT event, void* data), void* data)
+{
+	assert(node);
+	CONFIG* config = node->config;
+	_slc_begin_write(config);
+	bool ret = false;
+	for(size_t ii = 0; ii < config->num_observers; ii++)
+	{
+		if(config->observers[ii].callback == observer && config->observers[ii].data == data)
+		{
+			/* Keep the order in which the rest are called */
+			for(size_t jj = ii + 1; jj < config->num_observers; jj++)
+				config->observers[jj - 1] = config->observers[jj];
+			config->num_observers--;
+			ret = true;
+			break;
+		}
+	}
+	_slc_end_write(config);
+	return ret;
 }
 
 void slc_add_search_directory(SLCONFIG_NODE* node, SLCONFIG_STRING directory, bool copy)
 {
 	assert(node);
 	CONFIG* config = node->config;
+	_slc_begin_write(config);
 	config->search_dirs = config->vtable.realloc(config->search_dirs, sizeof(SLCONFIG_STRING) * (config->num_search_dirs + 1));
 	config->search_dir_ownerships = config->vtable.realloc(config->search_dir_ownerships, sizeof(bool) * (config->num_search_dirs + 1));
 	
@@ -614,207 +1579,212 @@ void slc_add_search_directory(SLCONFIG_NODE* node, SLCONFIG_STRING directory, bo
 	config->search_dir_ownerships[config->num_search_dirs] = copy;
 	
 	config->num_search_dirs++;
+	_slc_end_write(config);
 }
 
 void slc_clear_search_directories(SLCONFIG_NODE* node)
 {
 	assert(node);
-	CONFIG* config = node->config;
-	for(size_t ii = 0; ii < config->num_search_dirs; ii++)
-	{
-		if(config->search_dir_ownerships[ii])
-			slc_destroy_string(&config->search_dirs[ii], config->vtable.realloc);
-	}
-	
-	if(config->search_dirs)
-	{
-		config->vtable.realloc(config->search_dirs, 0);
-		config->vtable.realloc(config->search_dir_ownerships, 0);
-	}
-	
-	config->search_dirs = NULL;
-	config->search_dir_ownerships = NULL;
-	config->num_search_dirs = 0;
+	_slc_begin_write(node->config);
+	clear_search_directories(node->config);
+	_slc_end_write(node->config);
 }
 
-#define SENTINEL_CHAR ('-')
-#define SENTINEL_STRING ("-")
+void slc_set_max_depth(SLCONFIG_NODE* node, size_t max_depth)
+{
+	assert(node);
+	_slc_begin_write(node->config);
+	node->config->max_depth = max_depth;
+	_slc_end_write(node->config);
+}
 
-static
-size_t get_sentinel_size(SLCONFIG_STRING string)
+void slc_set_max_errors(SLCONFIG_NODE* node, size_t max_errors)
 {
-	if(string.start == 0)
-		return 0;
+	assert(node);
+	_slc_begin_write(node->config);
+	node->config->max_errors = max_errors;
+	_slc_end_write(node->config);
+}
+
+SLCONFIG_LOAD_STATS* _slc_get_cur_stats(CONFIG* config)
+{
+	if(config->cur_stats == NO_STATS)
+		return NULL;
+	return &config->load_stats[config->cur_stats];
+}
+
+/*
+ * Starts attributing everything to a new file. Returns the index of the previous file, which should be restored into
+ * cur_stats once the new file is done.
+ */
+size_t _slc_begin_load_stats(CONFIG* config, SLCONFIG_STRING filename)
+{
+	size_t outer_stats = config->cur_stats;
+	if(!config->collect_stats)
+		return outer_stats;
+	
+	config->load_stats = config->vtable.realloc(config->load_stats, (config->num_load_stats + 1) * sizeof(SLCONFIG_LOAD_STATS));
+	SLCONFIG_LOAD_STATS* stats = &config->load_stats[config->num_load_stats];
+	memset(stats, 0, sizeof(SLCONFIG_LOAD_STATS));
+	/* The filename might not outlive the load */
+	slc_append_to_string(&stats->filename, filename, config->vtable.realloc);
+	stats->include_depth = config->num_includes ? config->num_includes - 1 : 0;
 	
-	bool need_escaping = false;
-	bool first_was_slash = false;
+	config->cur_stats = config->num_load_stats++;
+	return outer_stats;
+}
 
-	size_t idx = 0;
-	size_t ret = 0;
-	size_t max_ret = 0;
-	while(string.start < string.end)
-	{
-		if(*string.start == SENTINEL_CHAR)
-			ret++;
-		else
-			ret = 0;
-		
-		if(ret > max_ret)
-			max_ret = ret;
-		
-		if(!_slc_is_naked_string_character(*string.start))
-			need_escaping = true;
-		
-		if(idx == 0 && *string.start == '/')
-			first_was_slash = true;
-		else if(first_was_slash && idx == 1 && *string.start == '/')
-			need_escaping = true;
-		
-		idx++;
-		string.start++;
-	}
+void slc_enable_load_stats(SLCONFIG_NODE* node, bool enable)
+{
+	assert(node);
+	CONFIG* config = node->config;
+	_slc_begin_write(config);
+	clear_load_stats(config);
+	config->collect_stats = enable;
+	_slc_end_write(config);
+}
 
-	if(need_escaping)
-		return max_ret + 1;
-	else
-		return 0;
+const SLCONFIG_LOAD_STATS* slc_get_load_stats(const SLCONFIG_NODE* node, size_t* num_stats)
+{
+	assert(node);
+	assert(num_stats);
+	_slc_begin_read(node->config);
+	*num_stats = node->config->num_load_stats;
+	const SLCONFIG_LOAD_STATS* ret = node->config->load_stats;
+	_slc_end_read(node->config);
+	return ret;
 }
 
-static
-void node_writer(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, void* output, void (*writer)(void* output, const void* data, size_t size),  size_t indent_level)
-{
-	SLCONFIG_STRING sentinel_string = {SENTINEL_STRING, SENTINEL_STRING + 1};
-	
-	#define WRITE_C_STRING(s) writer(output, s, strlen(s));
-	#define WRITE_STRING(s) writer(output, s.start, slc_string_length(s));
-	#define REPEAT(s, n) for(size_t _ii = 0; _ii < (n); _ii++) { WRITE_STRING(s); }
-	#define INDENT REPEAT(indentation, indent_level);
-	#define ESCAPED_STRING(s)                                                  \
-	do                                                                         \
-	{                                                                          \
-		size_t sentinel_size = get_sentinel_size(s);                           \
-		if(sentinel_size > 0)                                                  \
-		{                                                                      \
-			REPEAT(sentinel_string, sentinel_size);                            \
-			WRITE_C_STRING("\"");                                              \
-			WRITE_STRING(s);                                                   \
-			WRITE_C_STRING("\"");                                              \
-			REPEAT(sentinel_string, sentinel_size);                            \
-		}                                                                      \
-		else                                                                   \
-		{                                                                      \
-			WRITE_STRING(s);                                                   \
-		}                                                                      \
-	} while(0)
-	
-	if(node->parent && slc_string_length(node->comment))
-	{
-		INDENT;
-		WRITE_C_STRING("/**");
-		WRITE_STRING(node->comment);
-		WRITE_C_STRING("*/");
-		WRITE_STRING(line_end);
-	}
-	
-	INDENT;
-	if(slc_string_length(node->type) > 0)
-	{
-		ESCAPED_STRING(node->type);
-		WRITE_C_STRING(" ");
-	}
-	ESCAPED_STRING(node->name);
-	
-	if(node->is_aggregate)
-	{
-		if(!node->parent)
-		{
-			for(size_t ii = 0; ii < node->num_children; ii++)
-			{
-				node_writer(node->children[ii], line_end, indentation, output, writer, indent_level);
-			}
-		}
-		else if(node->num_children > 0)
-		{
-			WRITE_STRING(line_end);
-			INDENT;
-			WRITE_C_STRING("{");
-			WRITE_STRING(line_end);
-			for(size_t ii = 0; ii < node->num_children; ii++)
-			{
-				node_writer(node->children[ii], line_end, indentation, output, writer, indent_level+1);
-			}
-			INDENT;
-			WRITE_C_STRING("}");
-		}
-		else
-		{
-			WRITE_C_STRING(" {}");
-		}
-	}
-	else
-	{
-		if(slc_string_length(node->value))
-		{
-			WRITE_C_STRING(" = ");
-			ESCAPED_STRING(node->value);
-		}
-		WRITE_C_STRING(";");
-	}
-	
-	if(node->parent)
-		WRITE_STRING(line_end);
+void slc_clear_load_stats(SLCONFIG_NODE* node)
+{
+	assert(node);
+	_slc_begin_write(node->config);
+	clear_load_stats(node->config);
+	_slc_end_write(node->config);
 }
 
-typedef struct
+/* The read locks taken with slc_begin_read by the current thread, kept as its thread data, innermost first */
+typedef struct READ_SCOPE
 {
-	SLCONFIG_STRING* str;
 	const CONFIG* config;
-} STRING_WRITER_DATA;
+	/* Number of nested slc_begin_read calls for the tree */
+	size_t depth;
+	struct READ_SCOPE* outer;
+} READ_SCOPE;
 
 static
-void string_writer(void* output, const void* data, size_t size)
+READ_SCOPE* find_read_scope(const CONFIG* config)
 {
-	STRING_WRITER_DATA* writer_data = (STRING_WRITER_DATA*)output;
-	SLCONFIG_STRING new_str = {data, data + size};
-	slc_append_to_string(writer_data->str, new_str, writer_data->config->vtable.realloc);
+	READ_SCOPE* scope = _slc_get_thread_data();
+	while(scope && scope->config != config)
+		scope = scope->outer;
+	return scope;
 }
 
-SLCONFIG_STRING slc_save_node_string(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation)
+/* The calls made while the thread holds a read lock on the tree already run under it, so the lock is not touched */
+void _slc_begin_read(const CONFIG* config)
 {
-	SLCONFIG_STRING ret = {0, 0};
-	
-	STRING_WRITER_DATA data = {&ret, node->config};
-	
-	node_writer(node, line_end, indentation, &data, &string_writer, 0);
-	
-	return ret;
+	if(config->lock && !find_read_scope(config))
+		_slc_lock_read(config->lock);
 }
 
-typedef struct
+void _slc_end_read(const CONFIG* config)
 {
-	void* output;
-	const CONFIG* config;
-	bool error;
-} FILE_WRITER_DATA;
+	if(config->lock && !find_read_scope(config))
+		_slc_unlock_read(config->lock);
+}
 
-static
-void file_writer(void* output, const void* data, size_t size)
+void _slc_begin_write(CONFIG* config)
+{
+	if(config->lock)
+	{
+		/* The thread would wait for itself to stop reading */
+		assert(!find_read_scope(config));
+		_slc_lock_write(config->lock);
+	}
+}
+
+void _slc_end_write(CONFIG* config)
 {
-	FILE_WRITER_DATA* writer_data = (FILE_WRITER_DATA*)output;
-	writer_data->error |= size != writer_data->config->vtable.fwrite(data, size, writer_data->output);
+	if(config->lock)
+		_slc_unlock_write(config->lock);
 }
 
-bool slc_save_node(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation)
+bool slc_set_concurrent(SLCONFIG_NODE* node, bool concurrent)
 {
-	bool ret = false;
-	SLCONFIG_VTABLE vtable = node->config->vtable;
-	void* file = vtable.fopen(filename, false);
-	if(file)
+	assert(node);
+	CONFIG* config = node->config;
+	if(concurrent && !config->lock)
 	{
-		FILE_WRITER_DATA data = {file, node->config, false};
-		node_writer(node, line_end, indentation, &data, &file_writer, 0);
-		ret = !data.error;
-		vtable.fclose(file);
+		config->lock = _slc_create_rwlock(config->vtable.realloc);
+		return config->lock != NULL;
 	}
-	return ret;
+	else if(!concurrent && config->lock)
+	{
+		reclaim(config);
+		_slc_destroy_rwlock(config->lock, config->vtable.realloc);
+		config->lock = NULL;
+	}
+	return true;
+}
+
+bool slc_begin_read(SLCONFIG_NODE* node)
+{
+	assert(node);
+	CONFIG* config = node->config;
+	if(!config->lock)
+		return true;
+	
+	READ_SCOPE* scope = find_read_scope(config);
+	if(scope)
+	{
+		scope->depth++;
+		return true;
+	}
+	
+	scope = _slc_realloc(config, NULL, sizeof(READ_SCOPE));
+	scope->config = config;
+	scope->depth = 1;
+	scope->outer = _slc_get_thread_data();
+	if(!_slc_set_thread_data(scope))
+	{
+		_slc_free(config, scope);
+		return false;
+	}
+	_slc_lock_read(config->lock);
+	return true;
+}
+
+void slc_end_read(SLCONFIG_NODE* node)
+{
+	assert(node);
+	CONFIG* config = node->config;
+	if(!config->lock)
+		return;
+	
+	READ_SCOPE* scope = _slc_get_thread_data();
+	READ_SCOPE** link = NULL;
+	while(scope && scope->config != config)
+	{
+		link = &scope->outer;
+		scope = scope->outer;
+	}
+	assert(scope);
+	if(!scope || --scope->depth)
+		return;
+	
+	if(link)
+		*link = scope->outer;
+	else
+		_slc_set_thread_data(scope->outer);
+	_slc_free(config, scope);
+	_slc_unlock_read(config->lock);
+}
+
+void slc_reclaim(SLCONFIG_NODE* node)
+{
+	assert(node);
+	_slc_begin_write(node->config);
+	reclaim(node->config);
+	_slc_end_write(node->config);
 }
@@ -0,0 +1,341 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "slconfig/internal/thread.h"
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+struct THREAD
+{
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	void (*func)(void* arg);
+	void* arg;
+};
+
+struct MUTEX
+{
+#ifdef _WIN32
+	CRITICAL_SECTION section;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+struct RWLOCK
+{
+#ifdef _WIN32
+	SRWLOCK lock;
+#else
+	pthread_rwlock_t lock;
+#endif
+};
+
+#ifdef _WIN32
+static
+DWORD WINAPI thread_entry(LPVOID arg)
+{
+	THREAD* thread = arg;
+	thread->func(thread->arg);
+	return 0;
+}
+#else
+static
+void* thread_entry(void* arg)
+{
+	THREAD* thread = arg;
+	thread->func(thread->arg);
+	return NULL;
+}
+#endif
+
+THREAD* _slc_start_thread(void (*func)(void* arg), void* arg, void* (*custom_realloc)(void*, size_t))
+{
+	THREAD* thread = custom_realloc(0, sizeof(THREAD));
+	if(!thread)
+		return NULL;
+	thread->func = func;
+	thread->arg = arg;
+	
+#ifdef _WIN32
+	thread->handle = CreateThread(NULL, 0, &thread_entry, thread, 0, NULL);
+	bool started = thread->handle != NULL;
+#else
+	bool started = pthread_create(&thread->handle, NULL, &thread_entry, thread) == 0;
+#endif
+	
+	if(!started)
+	{
+		custom_realloc(thread, 0);
+		return NULL;
+	}
+	return thread;
+}
+
+void _slc_join_thread(THREAD* thread, void* (*custom_realloc)(void*, size_t))
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->handle, NULL);
+#endif
+	custom_realloc(thread, 0);
+}
+
+MUTEX* _slc_create_mutex(void* (*custom_realloc)(void*, size_t))
+{
+	MUTEX* mutex = custom_realloc(0, sizeof(MUTEX));
+	if(!mutex)
+		return NULL;
+	
+#ifdef _WIN32
+	InitializeCriticalSection(&mutex->section);
+#else
+	if(pthread_mutex_init(&mutex->mutex, NULL) != 0)
+	{
+		custom_realloc(mutex, 0);
+		return NULL;
+	}
+#endif
+	return mutex;
+}
+
+void _slc_destroy_mutex(MUTEX* mutex, void* (*custom_realloc)(void*, size_t))
+{
+#ifdef _WIN32
+	DeleteCriticalSection(&mutex->section);
+#else
+	pthread_mutex_destroy(&mutex->mutex);
+#endif
+	custom_realloc(mutex, 0);
+}
+
+void _slc_lock_mutex(MUTEX* mutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&mutex->section);
+#else
+	pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void _slc_unlock_mutex(MUTEX* mutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(&mutex->section);
+#else
+	pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+RWLOCK* _slc_create_rwlock(void* (*custom_realloc)(void*, size_t))
+{
+	RWLOCK* lock = custom_realloc(0, sizeof(RWLOCK));
+	if(!lock)
+		return NULL;
+	
+#ifdef _WIN32
+	InitializeSRWLock(&lock->lock);
+#else
+	if(pthread_rwlock_init(&lock->lock, NULL) != 0)
+	{
+		custom_realloc(lock, 0);
+		return NULL;
+	}
+#endif
+	return lock;
+}
+
+void _slc_destroy_rwlock(RWLOCK* lock, void* (*custom_realloc)(void*, size_t))
+{
+#ifndef _WIN32
+	pthread_rwlock_destroy(&lock->lock);
+#endif
+	custom_realloc(lock, 0);
+}
+
+void _slc_lock_read(RWLOCK* lock)
+{
+#ifdef _WIN32
+	AcquireSRWLockShared(&lock->lock);
+#else
+	pthread_rwlock_rdlock(&lock->lock);
+#endif
+}
+
+void _slc_unlock_read(RWLOCK* lock)
+{
+#ifdef _WIN32
+	ReleaseSRWLockShared(&lock->lock);
+#else
+	pthread_rwlock_unlock(&lock->lock);
+#endif
+}
+
+void _slc_lock_write(RWLOCK* lock)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive(&lock->lock);
+#else
+	pthread_rwlock_wrlock(&lock->lock);
+#endif
+}
+
+void _slc_unlock_write(RWLOCK* lock)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(&lock->lock);
+#else
+	pthread_rwlock_unlock(&lock->lock);
+#endif
+}
+
+size_t _slc_get_num_cpus(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return num_cpus > 0 ? (size_t)num_cpus : 1;
+#endif
+}
+
+#ifdef _WIN32
+static INIT_ONCE thread_data_once = INIT_ONCE_STATIC_INIT;
+static DWORD thread_data_index = TLS_OUT_OF_INDEXES;
+
+static
+BOOL CALLBACK create_thread_data(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	(void)once;
+	(void)param;
+	(void)context;
+	thread_data_index = TlsAlloc();
+	return TRUE;
+}
+#else
+static pthread_once_t thread_data_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_data_key;
+static bool have_thread_data_key = false;
+
+static
+void create_thread_data(void)
+{
+	have_thread_data_key = pthread_key_create(&thread_data_key, NULL) == 0;
+}
+#endif
+
+void* _slc_get_thread_data(void)
+{
+#ifdef _WIN32
+	InitOnceExecuteOnce(&thread_data_once, &create_thread_data, NULL, NULL);
+	return thread_data_index != TLS_OUT_OF_INDEXES ? TlsGetValue(thread_data_index) : NULL;
+#else
+	pthread_once(&thread_data_once, &create_thread_data);
+	return have_thread_data_key ? pthread_getspecific(thread_data_key) : NULL;
+#endif
+}
+
+bool _slc_set_thread_data(void* data)
+{
+#ifdef _WIN32
+	InitOnceExecuteOnce(&thread_data_once, &create_thread_data, NULL, NULL);
+	return thread_data_index != TLS_OUT_OF_INDEXES && TlsSetValue(thread_data_index, data);
+#else
+	pthread_once(&thread_data_once, &create_thread_data);
+	return have_thread_data_key && pthread_setspecific(thread_data_key, data) == 0;
+#endif
+}
+
+/* Tasks being handed out to the threads of _slc_parallel_for */
+typedef struct
+{
+	void (*func)(void* arg, size_t task);
+	void* arg;
+	size_t num_tasks;
+	MUTEX* mutex;
+	size_t next_task;
+} TASK_QUEUE;
+
+static
+void run_tasks(void* arg)
+{
+	TASK_QUEUE* queue = arg;
+	while(true)
+	{
+		_slc_lock_mutex(queue->mutex);
+		size_t task = queue->next_task++;
+		_slc_unlock_mutex(queue->mutex);
+		
+		if(task >= queue->num_tasks)
+			break;
+		queue->func(queue->arg, task);
+	}
+}
+
+void _slc_parallel_for(size_t num_tasks, size_t num_threads, void (*func)(void* arg, size_t task), void* arg, void* (*custom_realloc)(void*, size_t))
+{
+	if(num_threads == 0)
+		num_threads = _slc_get_num_cpus();
+	if(num_threads > num_tasks)
+		num_threads = num_tasks;
+	
+	TASK_QUEUE queue;
+	queue.func = func;
+	queue.arg = arg;
+	queue.num_tasks = num_tasks;
+	queue.next_task = 0;
+	queue.mutex = num_threads > 1 ? _slc_create_mutex(custom_realloc) : NULL;
+	if(!queue.mutex)
+	{
+		for(size_t ii = 0; ii < num_tasks; ii++)
+			func(arg, ii);
+		return;
+	}
+	
+	/* The calling thread runs the tasks too, so they all get done even if no thread could be started */
+	THREAD** threads = custom_realloc(0, (num_threads - 1) * sizeof(THREAD*));
+	for(size_t ii = 0; ii < num_threads - 1; ii++)
+		threads[ii] = _slc_start_thread(&run_tasks, &queue, custom_realloc);
+	run_tasks(&queue);
+	for(size_t ii = 0; ii < num_threads - 1; ii++)
+	{
+		if(threads[ii])
+			_slc_join_thread(threads[ii], custom_realloc);
+	}
+	
+	custom_realloc(threads, 0);
+	_slc_destroy_mutex(queue.mutex, custom_realloc);
+}
@@ -100,7 +100,7 @@ bool token_character(SLCONFIG_STRING *str, TOKEN* token, char c, TOKEN_TYPE type
 }
 
 static
-bool escape_string(SLCONFIG_STRING *str, SLCONFIG_VTABLE* vtable)
+bool escape_string(SLCONFIG_STRING *str, TOKENIZER_STATE* state)
 {
 	SLCONFIG_STRING source = *str;
 	SLCONFIG_STRING source_iter = source;
@@ -113,7 +113,11 @@ bool escape_string(SLCONFIG_STRING *str, SLCONFIG_VTABLE* vtable)
 		{
 			if(!new_allocation)
 			{
-				str->start = vtable->realloc(0, slc_string_length(source));
+				/* Not every tokenizer has a config to attribute the allocation to */
+				if(state->config)
+					str->start = _slc_realloc(state->config, 0, slc_string_length(source));
+				else
+					str->start = state->vtable->realloc(0, slc_string_length(source));
 				str->end = str->start;
 				new_allocation = true;
 			}
@@ -173,104 +177,101 @@ bool escape_string(SLCONFIG_STRING *str, SLCONFIG_VTABLE* vtable)
 	return new_allocation;
 }
 
+/* Advances str up to end, counting the lines along the way */
 static
-bool token_string(SLCONFIG_STRING *str, TOKEN* token, TOKENIZER_STATE* state)
+void skip_to(SLCONFIG_STRING* str, const char* end, size_t* line)
 {
-	SLCONFIG_STRING pre_quote;
-	SLCONFIG_STRING post_quote;
-	bool first_quote = false;
-	bool second_quote = false;
-	size_t start_line = state->line;
-	bool escape = false;
-	
-	pre_quote.start = str->start;
-	while(str->start < str->end)
+	while(str->start < end)
 	{
-		if(second_quote)
-		{
-			post_quote.end = str->start;
-			
-			if(slc_string_equal(pre_quote, post_quote))
-			{
-				/*if(_slc_is_naked_string_character(*str->start))
-				{
-					_slc_print_error_prefix(state->config, state->filename, state->line, state->vtable);
-					state->vtable->error(slc_from_c_str("Error: Unexpected character '"));
-					SLCONFIG_STRING c = {str->start, str->start + 1};
-					state->vtable->error(c);
-						
-					if(slc_string_length(pre_quote) == 0)
-						state->vtable->error(slc_from_c_str("' after quoted string.\n"));
-					else
-						state->vtable->error(slc_from_c_str("' after final heredoc string sentinel.\n"));
-					token->type = TOKEN_ERROR;
-				}*/
-				goto exit;
-			}
-		}
-		
-		if(*str->start == '"')
-		{
-			if(!first_quote)
-			{
-				pre_quote.end = str->start;
-				first_quote = true;
-			}
-			else if(slc_string_length(pre_quote) != 0 || !escape)
-			{
-				post_quote.start = str->start + 1;
-				second_quote = true;
-			}
-		}
-		
-		if(!first_quote && !_slc_is_naked_string_character(*str->start))
-		{
-			pre_quote.end = str->start;
-			goto exit;
-		}
-		
-		escape = !escape && *str->start == '\\'; 
-		
-		if(!eat_newline(str, &state->line))
+		if(!eat_newline(str, line))
 			str->start++;
 	}
-	
-	if(!first_quote)
+}
+
+/* Find the first unescaped quote */
+static
+const char* find_closing_quote(SLCONFIG_STRING str)
+{
+	bool escape = false;
+	for(const char* p = str.start; p < str.end; p++)
 	{
-		pre_quote.end = str->start;
-		goto exit;
+		if(*p == '"' && !escape)
+			return p;
+		escape = !escape && *p == '\\';
 	}
-	else if(second_quote)
+	return NULL;
+}
+
+/*
+ * Find the first quote followed by the sentinel. The sentinel contains no quotes, so a partial match never reaches
+ * past the next candidate quote and the search stays linear, no matter how many near misses there are.
+ */
+static
+const char* find_heredoc_end(SLCONFIG_STRING str, SLCONFIG_STRING sentinel)
+{
+	size_t sentinel_length = slc_string_length(sentinel);
+	const char* p = str.start;
+	while(p < str.end)
 	{
-		post_quote.end = str->start;
-		if(slc_string_equal(pre_quote, post_quote))
-			goto exit;
+		const char* quote = memchr(p, '"', str.end - p);
+		if(!quote)
+			return NULL;
+		
+		if((size_t)(str.end - quote - 1) >= sentinel_length && memcmp(quote + 1, sentinel.start, sentinel_length) == 0)
+			return quote;
+		
+		p = quote + 1;
 	}
+	return NULL;
+}
+
+static
+bool token_string(SLCONFIG_STRING *str, TOKEN* token, TOKENIZER_STATE* state)
+{
+	size_t start_line = state->line;
+	
+	/* Either the whole naked string, or the sentinel of a quoted one */
+	SLCONFIG_STRING pre_quote;
+	pre_quote.start = str->start;
+	while(str->start < str->end && _slc_is_naked_string_character(*str->start))
+		str->start++;
+	pre_quote.end = str->start;
 	
-	if(!state->gag_errors)
+	if(str->start == str->end || *str->start != '"')
 	{
-		_slc_print_error_prefix(state->config, state->filename, start_line, state->vtable);
-		state->vtable->error(slc_from_c_str("Error: Unterminated string.\n"));
+		token->str = pre_quote;
+		token->type = TOKEN_STRING;
+		return true;
 	}
-	token->type = TOKEN_ERROR;
-	return true;
-exit:
-	if(second_quote)
+	
+	str->start++;
+	
+	const char* closing_quote;
+	if(slc_string_length(pre_quote))
+		closing_quote = find_heredoc_end(*str, pre_quote);
+	else
+		closing_quote = find_closing_quote(*str);
+	
+	if(!closing_quote)
 	{
-		SLCONFIG_STRING string_content;
-		string_content.start = pre_quote.end + 1;
-		string_content.end = post_quote.start - 1;
-		if(!slc_string_length(pre_quote))
+		skip_to(str, str->end, &state->line);
+		if(!state->gag_errors)
 		{
-			token->own = escape_string(&string_content, state->vtable);
+			_slc_begin_error(state->config, SLCONFIG_ERROR_UNTERMINATED_STRING, state->filename, start_line);
+			_slc_error(state->config, slc_from_c_str("Error: Unterminated string.\n"));
+			_slc_end_error(state->config);
 		}
-		
-		token->str = string_content;
-	}
-	else
-	{
-		token->str = pre_quote;
+		token->type = TOKEN_ERROR;
+		return true;
 	}
+	
+	SLCONFIG_STRING string_content = {str->start, closing_quote};
+	skip_to(str, closing_quote + 1 + slc_string_length(pre_quote), &state->line);
+	
+	if(!slc_string_length(pre_quote))
+		token->own = escape_string(&string_content, state);
+	
+	token->str = string_content;
 	token->type = TOKEN_STRING;
 	return true;
 }
@@ -342,42 +343,34 @@ bool token_block_comment(SLCONFIG_STRING* str, TOKEN* token, TOKENIZER_STATE* st
 			token->str.start = str->start;
 			while(str->start < str->end)
 			{
-				if(*str->start == '/')
+				bool has_next = str->start + 1 < str->end;
+				if(*str->start == '/' && has_next && str->start[1] == '*')
 				{
-					str->start++;
-					if(str->start < str->end && *str->start == '*')
-					{
-						opened_comments++;
-						str->start++;
-						continue;
-					}
+					opened_comments++;
+					str->start += 2;
 				}
-				
-				if(*str->start == '*')
+				else if(*str->start == '*' && has_next && str->start[1] == '/')
 				{
-					str->start++;
-					if(str->start < str->end && *str->start == '/')
+					opened_comments--;
+					str->start += 2;
+					
+					if(opened_comments == 0)
 					{
-						opened_comments--;
-						str->start++;
-						continue;
+						token->str.end = str->start - 2;
+						goto exit;
 					}
 				}
-				
-				if(opened_comments == 0)
+				else if(!eat_newline(str, &state->line))
 				{
-					token->str.end = str->start - 2;
-					goto exit;
-				}
-
-				if(!eat_newline(str, &state->line))
 					str->start++;
+				}
 			}
 
 			if(!state->gag_errors)
 			{
-				_slc_print_error_prefix(state->config, state->filename, start_line, state->vtable);
-				state->vtable->error(slc_from_c_str("Error: Unterminated block comment.\n"));
+				_slc_begin_error(state->config, SLCONFIG_ERROR_UNTERMINATED_COMMENT, state->filename, start_line);
+				_slc_error(state->config, slc_from_c_str("Error: Unterminated block comment.\n"));
+				_slc_end_error(state->config);
 			}
 			token->type = TOKEN_ERROR;
 			return true;
@@ -16,12 +16,23 @@
  * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include "slconfig/internal/utils.h"
+#include "slconfig/internal/number.h"
 #include "slconfig/internal/slconfig.h"
 
 #include <string.h>
 #include <stdio.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 void slc_append_to_string(SLCONFIG_STRING* dest, SLCONFIG_STRING new_str, void* (*custom_realloc)(void*, size_t))
 {
 	if(!custom_realloc)
@@ -42,35 +53,147 @@ void slc_destroy_string(SLCONFIG_STRING* str, void* (*custom_realloc)(void*, siz
 	str->start = str->end = 0;
 }
 
+/* Make room for length more bytes at the end of the diagnostic being assembled */
+static
+char* reserve_error(CONFIG* config, size_t length)
+{
+	size_t needed = config->error_size + length;
+	if(needed > config->error_capacity)
+	{
+		size_t capacity = config->error_capacity ? config->error_capacity : 256;
+		while(capacity < needed)
+			capacity *= 2;
+		config->error_buffer = _slc_realloc(config, config->error_buffer, capacity);
+		config->error_capacity = capacity;
+	}
+	return config->error_buffer + config->error_size;
+}
+
+static
+void error_number(CONFIG* config, size_t number)
+{
+	char buf[NUMBER_BUFFER_SIZE];
+	size_t length = _slc_format_int64((int64_t)number, buf);
+	SLCONFIG_STRING str = {buf, buf + length};
+	_slc_error(config, str);
+}
+
 /*
- * Just print a standard error prefix
+ * Start assembling a diagnostic. Unless the line is 0, which is used for errors that are not about a particular
+ * file, the message is preceded by the standard prefix with the include chain and the location
  */
-void _slc_print_error_prefix(CONFIG* config, SLCONFIG_STRING filename, size_t line, SLCONFIG_VTABLE* table)
+static
+void begin_diagnostic(CONFIG* config, SLCONFIG_SEVERITY severity, SLCONFIG_ERROR_CODE code, SLCONFIG_STRING filename, size_t line)
 {
-	char buf[32];
-	if(config->num_includes > 1)
+	SLCONFIG_DIAGNOSTIC* diagnostic = &config->diagnostic;
+	diagnostic->severity = severity;
+	diagnostic->code = code;
+	diagnostic->filename = filename;
+	diagnostic->line = line;
+	diagnostic->include_files = config->include_list;
+	diagnostic->include_lines = config->include_lines;
+	diagnostic->num_includes = line && config->num_includes > 1 ? config->num_includes - 1 : 0;
+	
+	config->error_size = 0;
+	config->node_path_start = 0;
+	config->node_path_end = 0;
+	
+	if(line)
 	{
-		for(size_t ii = 0; ii < config->num_includes - 1; ii++)
+		for(size_t ii = 0; ii < diagnostic->num_includes; ii++)
 		{
 			if(ii == 0)
-				table->error(slc_from_c_str("In file included from "));
+				_slc_error(config, slc_from_c_str("In file included from "));
 			else
-				table->error(slc_from_c_str("                 from "));
-			table->error(config->include_list[ii]);
-			table->error(slc_from_c_str(":"));
-			snprintf(buf, 32, "%zu", config->include_lines[ii]);
-			table->error(slc_from_c_str(buf));
-			if(ii == config->num_includes - 2)
-				table->error(slc_from_c_str(":\n"));
+				_slc_error(config, slc_from_c_str("                 from "));
+			_slc_error(config, config->include_list[ii]);
+			_slc_error(config, slc_from_c_str(":"));
+			error_number(config, config->include_lines[ii]);
+			if(ii == diagnostic->num_includes - 1)
+				_slc_error(config, slc_from_c_str(":\n"));
 			else
-				table->error(slc_from_c_str(",\n"));
+				_slc_error(config, slc_from_c_str(",\n"));
 		}
+		_slc_error(config, filename);
+		_slc_error(config, slc_from_c_str(":"));
+		error_number(config, line);
+		_slc_error(config, slc_from_c_str(": "));
+	}
+	
+	config->message_start = config->error_size;
+}
+
+void _slc_begin_error(CONFIG* config, SLCONFIG_ERROR_CODE code, SLCONFIG_STRING filename, size_t line)
+{
+	begin_diagnostic(config, SLCONFIG_SEVERITY_ERROR, code, filename, line);
+}
+
+void _slc_begin_warning(CONFIG* config, SLCONFIG_ERROR_CODE code, SLCONFIG_STRING filename, size_t line)
+{
+	begin_diagnostic(config, SLCONFIG_SEVERITY_WARNING, code, filename, line);
+}
+
+/*
+ * Append a piece of the message to the diagnostic being assembled
+ */
+void _slc_error(CONFIG* config, SLCONFIG_STRING str)
+{
+	size_t length = slc_string_length(str);
+	if(!length)
+		return;
+	memcpy(reserve_error(config, length), str.start, length);
+	config->error_size += length;
+}
+
+/*
+ * Append the full name of a node to the diagnostic being assembled. The first node mentioned is the one the
+ * diagnostic is about
+ */
+void _slc_error_full_name(CONFIG* config, const SLCONFIG_NODE* node)
+{
+	size_t length = _slc_format_full_name(node, NULL, 0);
+	_slc_format_full_name(node, reserve_error(config, length + 1), length + 1);
+	if(!config->node_path_end)
+	{
+		config->node_path_start = config->error_size;
+		config->node_path_end = config->error_size + length;
+	}
+	config->error_size += length;
+}
+
+/*
+ * Deliver the assembled diagnostic in a single call, to the diagnostic callback if there is one, or as one piece of
+ * text to the error callback otherwise
+ */
+void _slc_end_error(CONFIG* config)
+{
+	SLCONFIG_DIAGNOSTIC* diagnostic = &config->diagnostic;
+	const char* buffer = config->error_buffer;
+	
+	diagnostic->message.start = buffer + config->message_start;
+	diagnostic->message.end = buffer + config->error_size;
+	if(config->node_path_end)
+	{
+		diagnostic->node_path.start = buffer + config->node_path_start;
+		diagnostic->node_path.end = buffer + config->node_path_end;
+	}
+	else
+	{
+		diagnostic->node_path.start = diagnostic->node_path.end = NULL;
+	}
+	
+	if(diagnostic->severity == SLCONFIG_SEVERITY_ERROR)
+		config->num_errors++;
+	
+	if(config->vtable.diagnostic)
+	{
+		config->vtable.diagnostic(diagnostic);
+	}
+	else
+	{
+		SLCONFIG_STRING text = {buffer, buffer + config->error_size};
+		config->vtable.error(text);
 	}
-	table->error(filename);
-	table->error(slc_from_c_str(":"));
-	snprintf(buf, 32, "%zu", line);
-	table->error(slc_from_c_str(buf));
-	table->error(slc_from_c_str(": "));
 }
 
 /*
@@ -78,14 +201,15 @@ void _slc_print_error_prefix(CONFIG* config, SLCONFIG_STRING filename, size_t li
  */
 void _slc_expected_after_error(CONFIG* config, TOKENIZER_STATE* state, size_t line, SLCONFIG_STRING expected, SLCONFIG_STRING after, SLCONFIG_STRING actual)
 {
-	_slc_print_error_prefix(config, state->filename, line, state->vtable);
-	state->vtable->error(slc_from_c_str("Error: Expected "));
-	state->vtable->error(expected);
-	state->vtable->error(slc_from_c_str(" after '"));
-	state->vtable->error(after);
-	state->vtable->error(slc_from_c_str("', not '"));
-	state->vtable->error(actual);
-	state->vtable->error(slc_from_c_str("'.\n"));
+	_slc_begin_error(config, SLCONFIG_ERROR_UNEXPECTED_TOKEN, state->filename, line);
+	_slc_error(config, slc_from_c_str("Error: Expected "));
+	_slc_error(config, expected);
+	_slc_error(config, slc_from_c_str(" after '"));
+	_slc_error(config, after);
+	_slc_error(config, slc_from_c_str("', not '"));
+	_slc_error(config, actual);
+	_slc_error(config, slc_from_c_str("'.\n"));
+	_slc_end_error(config);
 }
 
 /*
@@ -93,12 +217,26 @@ void _slc_expected_after_error(CONFIG* config, TOKENIZER_STATE* state, size_t li
  */
 void _slc_expected_error(CONFIG* config, TOKENIZER_STATE* state, size_t line, SLCONFIG_STRING expected, SLCONFIG_STRING actual)
 {
-	_slc_print_error_prefix(config, state->filename, line, state->vtable);
-	state->vtable->error(slc_from_c_str("Error: Expected '"));
-	state->vtable->error(expected);
-	state->vtable->error(slc_from_c_str("', not '"));
-	state->vtable->error(actual);
-	state->vtable->error(slc_from_c_str("'.\n"));
+	_slc_begin_error(config, SLCONFIG_ERROR_UNEXPECTED_TOKEN, state->filename, line);
+	_slc_error(config, slc_from_c_str("Error: Expected '"));
+	_slc_error(config, expected);
+	_slc_error(config, slc_from_c_str("', not '"));
+	_slc_error(config, actual);
+	_slc_error(config, slc_from_c_str("'.\n"));
+	_slc_end_error(config);
+}
+
+/*
+ * 64 bit FNV-1a, continuing from a previous hash so that strings can be hashed piecewise. Start with HASH_SEED.
+ */
+uint64_t _slc_hash_string(uint64_t hash, SLCONFIG_STRING str)
+{
+	for(const char* p = str.start; p < str.end; p++)
+	{
+		hash ^= (unsigned char)*p;
+		hash *= 1099511628211ull;
+	}
+	return hash;
 }
 
 size_t slc_string_length(SLCONFIG_STRING str)
@@ -121,6 +259,20 @@ bool slc_string_equal(SLCONFIG_STRING a, SLCONFIG_STRING b)
 	return true;
 }
 
+/*
+ * Total order on strings, for sorting and binary searches
+ */
+int _slc_string_compare(SLCONFIG_STRING a, SLCONFIG_STRING b)
+{
+	size_t a_len = slc_string_length(a);
+	size_t b_len = slc_string_length(b);
+	size_t len = a_len < b_len ? a_len : b_len;
+	int ret = len ? memcmp(a.start, b.start, len) : 0;
+	if(ret != 0)
+		return ret;
+	return a_len < b_len ? -1 : a_len > b_len;
+}
+
 SLCONFIG_STRING slc_from_c_str(const char* str)
 {
 	SLCONFIG_STRING ret;
@@ -148,3 +300,55 @@ void _slc_free(CONFIG* config, void* ptr)
 		config->vtable.realloc(ptr, 0);
 	}
 }
+
+/*
+ * Allocations made while loading go through this (and _slc_append_to_string), so that they can be attributed to the
+ * file being loaded
+ */
+void* _slc_realloc(CONFIG* config, void* ptr, size_t size)
+{
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+	if(stats && size)
+	{
+		stats->allocations++;
+		stats->allocated_bytes += size;
+	}
+	return config->vtable.realloc(ptr, size);
+}
+
+void _slc_append_to_string(CONFIG* config, SLCONFIG_STRING* dest, SLCONFIG_STRING new_str)
+{
+	SLCONFIG_LOAD_STATS* stats = _slc_get_cur_stats(config);
+	if(stats)
+	{
+		stats->allocations++;
+		stats->allocated_bytes += slc_string_length(*dest) + slc_string_length(new_str);
+	}
+	slc_append_to_string(dest, new_str, config->vtable.realloc);
+}
+
+/* Gives a node its own copy of a string it does not own, before it is modified in place */
+void _slc_own_string(CONFIG* config, SLCONFIG_STRING* str, bool* own)
+{
+	if(*own)
+		return;
+	
+	SLCONFIG_STRING copy = {0, 0};
+	_slc_append_to_string(config, &copy, *str);
+	*str = copy;
+	*own = true;
+}
+
+uint64_t _slc_get_time_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
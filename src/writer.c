@@ -0,0 +1,786 @@
+/* Copyright 2012 Pavel Sountsov
+ * 
+ * This file is part of SLConfig.
+ *
+ * SLConfig is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SLConfig is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with SLConfig.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "slconfig/slconfig.h"
+#include "slconfig/internal/slconfig.h"
+#include "slconfig/internal/thread.h"
+#include "slconfig/internal/tokenizer.h"
+#include "slconfig/internal/utils.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define SENTINEL_CHAR ('-')
+#define SENTINEL_STRING ("-")
+
+/* Size of the buffer that the output to a file is collected in before it is written out */
+#define WRITER_BUFFER_SIZE (4096)
+
+/*
+ * Writes nodes out one at a time, so that neither the writer nor the user need to hold the whole tree. Saving a tree
+ * walks it through the same functions.
+ */
+struct SLCONFIG_WRITER
+{
+	SLCONFIG_VTABLE vtable;
+	/* File the buffer is flushed to. Without one, the buffer grows to hold the whole output */
+	void* file;
+	char* buffer;
+	size_t size;
+	size_t capacity;
+	
+	SLCONFIG_STRING line_end;
+	SLCONFIG_STRING indentation;
+	/* Number of open aggregates */
+	size_t depth;
+	/* Whether the innermost aggregate is yet to get its opening brace, as it may turn out to be empty */
+	bool block_pending;
+	bool error;
+	
+	/* Minimal separators and no comments */
+	bool compact;
+	/* Children sorted by name, so that the output only depends on the contents of the tree */
+	bool canonical;
+	/* Whether the output is hashed into hash instead of being kept */
+	bool hash_only;
+	uint64_t hash;
+};
+
+/*
+ * Number of sentinels to quote a string with, 0 if it can be written as is. A string is written as is if it consists
+ * of naked string characters and does not start a comment. Otherwise it is quoted with one more sentinel than the
+ * longest run of them inside it, which is the least that cannot be mistaken for the end of the string.
+ */
+static
+size_t get_sentinel_size(SLCONFIG_STRING string)
+{
+	/* Empty strings can only be written quoted */
+	if(string.start == string.end)
+		return 1;
+	
+	bool need_escaping = false;
+	bool first_was_slash = false;
+	
+	size_t idx = 0;
+	size_t ret = 0;
+	size_t max_ret = 0;
+	while(string.start < string.end)
+	{
+		if(*string.start == SENTINEL_CHAR)
+			ret++;
+		else
+			ret = 0;
+		
+		if(ret > max_ret)
+			max_ret = ret;
+		
+		if(!_slc_is_naked_string_character(*string.start))
+			need_escaping = true;
+		
+		if(idx == 0 && *string.start == '/')
+			first_was_slash = true;
+		else if(first_was_slash && idx == 1 && (*string.start == '/' || *string.start == '*'))
+			need_escaping = true;
+		
+		idx++;
+		string.start++;
+	}
+	
+	if(need_escaping)
+		return max_ret + 1;
+	else
+		return 0;
+}
+
+static
+void init_writer(SLCONFIG_WRITER* writer, const SLCONFIG_VTABLE* vtable, void* file, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, bool compact, bool canonical)
+{
+	writer->vtable = *vtable;
+	writer->file = file;
+	writer->buffer = file ? vtable->realloc(0, WRITER_BUFFER_SIZE) : NULL;
+	writer->size = 0;
+	writer->capacity = file ? WRITER_BUFFER_SIZE : 0;
+	writer->line_end = line_end;
+	writer->indentation = indentation;
+	writer->depth = 0;
+	writer->block_pending = false;
+	writer->error = false;
+	writer->compact = compact;
+	writer->canonical = canonical;
+	writer->hash_only = false;
+	writer->hash = HASH_SEED;
+}
+
+static
+void flush(SLCONFIG_WRITER* writer)
+{
+	if(writer->file && writer->size)
+	{
+		writer->error |= writer->size != writer->vtable.fwrite(writer->buffer, writer->size, writer->file);
+		writer->size = 0;
+	}
+}
+
+/* Flush the remaining output and release the buffer if it went to a file. Returns whether all of it was written */
+static
+bool finish_writer(SLCONFIG_WRITER* writer)
+{
+	flush(writer);
+	if(writer->file)
+		writer->vtable.realloc(writer->buffer, 0);
+	return !writer->error;
+}
+
+static
+void write_data(SLCONFIG_WRITER* writer, const char* data, size_t size)
+{
+	if(size == 0)
+		return;
+	
+	if(writer->hash_only)
+	{
+		SLCONFIG_STRING str = {data, data + size};
+		writer->hash = _slc_hash_string(writer->hash, str);
+		return;
+	}
+	
+	if(writer->size + size > writer->capacity)
+	{
+		if(writer->file)
+		{
+			flush(writer);
+			/* Anything that would not fit anyway is written directly */
+			if(size >= writer->capacity)
+			{
+				writer->error |= size != writer->vtable.fwrite(data, size, writer->file);
+				return;
+			}
+		}
+		else
+		{
+			/* Grow geometrically, the string gets trimmed once it is done */
+			size_t capacity = writer->capacity ? writer->capacity : 256;
+			while(capacity < writer->size + size)
+				capacity *= 2;
+			writer->buffer = writer->vtable.realloc(writer->buffer, capacity);
+			writer->capacity = capacity;
+		}
+	}
+	
+	memcpy(writer->buffer + writer->size, data, size);
+	writer->size += size;
+}
+
+static
+void write_string(SLCONFIG_WRITER* writer, SLCONFIG_STRING str)
+{
+	write_data(writer, str.start, slc_string_length(str));
+}
+
+static
+void write_c_string(SLCONFIG_WRITER* writer, const char* str)
+{
+	write_data(writer, str, strlen(str));
+}
+
+static
+void write_indent(SLCONFIG_WRITER* writer, size_t indent_level)
+{
+	if(slc_string_length(writer->indentation) == 0)
+		return;
+	for(size_t ii = 0; ii < indent_level; ii++)
+		write_string(writer, writer->indentation);
+}
+
+/* Write a string, quoting it with as many sentinels as it takes if it cannot be written as is */
+static
+void write_escaped(SLCONFIG_WRITER* writer, SLCONFIG_STRING str)
+{
+	size_t sentinel_size = get_sentinel_size(str);
+	if(sentinel_size > 0)
+	{
+		for(size_t ii = 0; ii < sentinel_size; ii++)
+			write_c_string(writer, SENTINEL_STRING);
+		write_c_string(writer, "\"");
+		write_string(writer, str);
+		write_c_string(writer, "\"");
+		for(size_t ii = 0; ii < sentinel_size; ii++)
+			write_c_string(writer, SENTINEL_STRING);
+	}
+	else
+	{
+		write_string(writer, str);
+	}
+}
+
+/* Give the innermost aggregate its opening brace, now that it is known to have children */
+static
+void open_pending_block(SLCONFIG_WRITER* writer)
+{
+	if(!writer->block_pending)
+		return;
+	writer->block_pending = false;
+	write_string(writer, writer->line_end);
+	write_indent(writer, writer->depth - 1);
+	write_c_string(writer, "{");
+	write_string(writer, writer->line_end);
+}
+
+static
+void write_header(SLCONFIG_WRITER* writer, SLCONFIG_STRING type, SLCONFIG_STRING name)
+{
+	open_pending_block(writer);
+	write_indent(writer, writer->depth);
+	if(slc_string_length(type) > 0)
+	{
+		write_escaped(writer, type);
+		write_c_string(writer, " ");
+	}
+	write_escaped(writer, name);
+}
+
+SLCONFIG_WRITER* slc_create_writer(SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, const SLCONFIG_VTABLE* vtable_ptr)
+{
+	SLCONFIG_VTABLE vtable;
+	if(vtable_ptr)
+		memcpy(&vtable, vtable_ptr, sizeof(SLCONFIG_VTABLE));
+	else
+		memset(&vtable, 0, sizeof(SLCONFIG_VTABLE));
+	_slc_fill_vtable(&vtable);
+	
+	void* file = vtable.fopen(filename, false);
+	if(!file)
+		return NULL;
+	
+	/* The line end and the indentation are kept right after the writer */
+	size_t line_end_length = slc_string_length(line_end);
+	size_t indentation_length = slc_string_length(indentation);
+	SLCONFIG_WRITER* writer = vtable.realloc(0, sizeof(SLCONFIG_WRITER) + line_end_length + indentation_length);
+	char* strings = (char*)(writer + 1);
+	if(line_end_length)
+		memcpy(strings, line_end.start, line_end_length);
+	if(indentation_length)
+		memcpy(strings + line_end_length, indentation.start, indentation_length);
+	
+	SLCONFIG_STRING own_line_end = {strings, strings + line_end_length};
+	SLCONFIG_STRING own_indentation = {strings + line_end_length, strings + line_end_length + indentation_length};
+	init_writer(writer, &vtable, file, own_line_end, own_indentation, false, false);
+	return writer;
+}
+
+bool slc_destroy_writer(SLCONFIG_WRITER* writer)
+{
+	assert(writer);
+	while(writer->depth > 0)
+		slc_writer_end_aggregate(writer);
+	
+	bool ret = finish_writer(writer);
+	writer->vtable.fclose(writer->file);
+	writer->vtable.realloc(writer, 0);
+	return ret;
+}
+
+bool slc_writer_begin_aggregate(SLCONFIG_WRITER* writer, SLCONFIG_STRING type, SLCONFIG_STRING name)
+{
+	assert(writer);
+	write_header(writer, type, name);
+	writer->depth++;
+	writer->block_pending = true;
+	return !writer->error;
+}
+
+bool slc_writer_end_aggregate(SLCONFIG_WRITER* writer)
+{
+	assert(writer);
+	assert(writer->depth > 0);
+	if(writer->depth == 0)
+		return false;
+	
+	writer->depth--;
+	if(writer->block_pending)
+	{
+		writer->block_pending = false;
+		write_c_string(writer, writer->compact ? "{}" : " {}");
+	}
+	else
+	{
+		write_indent(writer, writer->depth);
+		write_c_string(writer, "}");
+	}
+	write_string(writer, writer->line_end);
+	return !writer->error;
+}
+
+bool slc_writer_string_node(SLCONFIG_WRITER* writer, SLCONFIG_STRING type, SLCONFIG_STRING name, SLCONFIG_STRING value)
+{
+	assert(writer);
+	write_header(writer, type, name);
+	if(slc_string_length(value))
+	{
+		write_c_string(writer, writer->compact ? "=" : " = ");
+		write_escaped(writer, value);
+	}
+	write_c_string(writer, ";");
+	write_string(writer, writer->line_end);
+	return !writer->error;
+}
+
+bool slc_writer_comment(SLCONFIG_WRITER* writer, SLCONFIG_STRING comment)
+{
+	assert(writer);
+	if(writer->compact)
+		return !writer->error;
+	
+	open_pending_block(writer);
+	write_indent(writer, writer->depth);
+	write_c_string(writer, "/**");
+	write_string(writer, comment);
+	write_c_string(writer, "*/");
+	write_string(writer, writer->line_end);
+	return !writer->error;
+}
+
+/* An aggregate whose children are being written */
+typedef struct
+{
+	const SLCONFIG_NODE* node;
+	size_t next_child;
+	/* Children sorted by name in canonical mode, NULL to write them in their own order */
+	SLCONFIG_NODE** order;
+} WRITER_FRAME;
+
+static
+int compare_names(const void* a, const void* b)
+{
+	return _slc_string_compare((*(SLCONFIG_NODE* const*)a)->name, (*(SLCONFIG_NODE* const*)b)->name);
+}
+
+/*
+ * Write a node and its children. The root has no braces, so only its children are written. Aggregates are written
+ * using an explicit stack, so that deep trees cannot overflow the call stack
+ */
+static
+void write_tree(SLCONFIG_WRITER* writer, const SLCONFIG_NODE* node)
+{
+	WRITER_FRAME* stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	const CONFIG* config = node->config;
+	
+	while(node)
+	{
+		if(node->parent)
+		{
+			if(slc_string_length(node->comment))
+				slc_writer_comment(writer, node->comment);
+			
+			if(node->is_aggregate)
+				slc_writer_begin_aggregate(writer, node->type, node->name);
+			else
+				slc_writer_string_node(writer, node->type, node->name, node->value);
+		}
+		
+		if(node->is_aggregate)
+		{
+			stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(WRITER_FRAME));
+			WRITER_FRAME* frame = &stack[stack_size++];
+			frame->node = node;
+			frame->next_child = 0;
+			frame->order = NULL;
+			
+			/* Names are unique within an aggregate, so this order is fully determined */
+			if(writer->canonical && node->num_children > 1)
+			{
+				frame->order = config->vtable.realloc(0, node->num_children * sizeof(SLCONFIG_NODE*));
+				memcpy(frame->order, node->children, node->num_children * sizeof(SLCONFIG_NODE*));
+				qsort(frame->order, node->num_children, sizeof(SLCONFIG_NODE*), &compare_names);
+			}
+		}
+		
+		/* Find the next node to write, closing the aggregates that ran out of children */
+		node = NULL;
+		while(!node && stack_size)
+		{
+			WRITER_FRAME* frame = &stack[stack_size - 1];
+			if(frame->next_child < frame->node->num_children)
+			{
+				SLCONFIG_NODE** children = frame->order ? frame->order : frame->node->children;
+				node = children[frame->next_child++];
+			}
+			else
+			{
+				stack_size--;
+				if(frame->order)
+					config->vtable.realloc(frame->order, 0);
+				if(frame->node->parent)
+					slc_writer_end_aggregate(writer);
+			}
+		}
+	}
+	
+	if(stack)
+		config->vtable.realloc(stack, 0);
+}
+
+static
+SLCONFIG_STRING save_to_string(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, bool compact, bool canonical)
+{
+	SLCONFIG_WRITER writer;
+	init_writer(&writer, &node->config->vtable, NULL, line_end, indentation, compact, canonical);
+	write_tree(&writer, node);
+	finish_writer(&writer);
+	
+	SLCONFIG_STRING ret = {writer.buffer, writer.buffer + writer.size};
+	if(writer.size > 0 && writer.size < writer.capacity)
+	{
+		ret.start = writer.vtable.realloc(writer.buffer, writer.size);
+		ret.end = ret.start + writer.size;
+	}
+	
+	return ret;
+}
+
+static
+bool save_to_file(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, bool compact, bool canonical)
+{
+	const SLCONFIG_VTABLE* vtable = &node->config->vtable;
+	void* file = vtable->fopen(filename, false);
+	if(!file)
+		return false;
+	
+	SLCONFIG_WRITER writer;
+	init_writer(&writer, vtable, file, line_end, indentation, compact, canonical);
+	write_tree(&writer, node);
+	bool ret = finish_writer(&writer);
+	vtable->fclose(file);
+	return ret;
+}
+
+SLCONFIG_STRING slc_save_node_string(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation)
+{
+	_slc_begin_read(node->config);
+	SLCONFIG_STRING ret = save_to_string(node, line_end, indentation, false, false);
+	_slc_end_read(node->config);
+	return ret;
+}
+
+bool slc_save_node(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation)
+{
+	_slc_begin_read(node->config);
+	bool ret = save_to_file(node, filename, line_end, indentation, false, false);
+	_slc_end_read(node->config);
+	return ret;
+}
+
+SLCONFIG_STRING slc_save_node_compact_string(const SLCONFIG_NODE* node, bool canonical)
+{
+	SLCONFIG_STRING empty = {0, 0};
+	_slc_begin_read(node->config);
+	SLCONFIG_STRING ret = save_to_string(node, empty, empty, true, canonical);
+	_slc_end_read(node->config);
+	return ret;
+}
+
+bool slc_save_node_compact(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, bool canonical)
+{
+	SLCONFIG_STRING empty = {0, 0};
+	_slc_begin_read(node->config);
+	bool ret = save_to_file(node, filename, empty, empty, true, canonical);
+	_slc_end_read(node->config);
+	return ret;
+}
+
+uint64_t slc_hash_node(const SLCONFIG_NODE* node)
+{
+	SLCONFIG_STRING empty = {0, 0};
+	SLCONFIG_WRITER writer;
+	init_writer(&writer, &node->config->vtable, NULL, empty, empty, true, true);
+	writer.hash_only = true;
+	_slc_begin_read(node->config);
+	write_tree(&writer, node);
+	_slc_end_read(node->config);
+	return writer.hash;
+}
+
+/* Trees smaller than this are not worth starting threads for */
+#define PARALLEL_MIN_NODES (4096)
+/* Parts per thread, more of them even out the uneven subtrees */
+#define PARTS_PER_THREAD (8)
+/* How many levels of aggregates may be split into parts. Deeper aggregates are written as a single part */
+#define MAX_SPLIT_DEPTH (8)
+
+typedef enum
+{
+	/* A run of children of an aggregate */
+	PART_CHILDREN,
+	/* Comment, header and opening brace of an aggregate that was split */
+	PART_OPEN,
+	/* Closing brace of an aggregate that was split */
+	PART_CLOSE
+} PART_TYPE;
+
+/* A piece of the output that can be written independently of the others */
+typedef struct
+{
+	PART_TYPE type;
+	/* Aggregate whose children are written, or which is opened */
+	const SLCONFIG_NODE* node;
+	size_t first_child;
+	size_t num_children;
+	/* Indentation level of the part */
+	size_t depth;
+	SLCONFIG_STRING output;
+} PART;
+
+typedef struct
+{
+	const SLCONFIG_VTABLE* vtable;
+	SLCONFIG_STRING line_end;
+	SLCONFIG_STRING indentation;
+	
+	PART* parts;
+	size_t num_parts;
+	size_t parts_capacity;
+	/* Number of nodes in a part that makes it worth handing off on its own */
+	size_t part_size;
+} PARALLEL_SAVE;
+
+static
+size_t count_nodes(const SLCONFIG_NODE* node)
+{
+	const CONFIG* config = node->config;
+	const SLCONFIG_NODE** stack = NULL;
+	size_t stack_size = 0;
+	size_t stack_capacity = 0;
+	size_t ret = 0;
+	
+	while(node)
+	{
+		ret++;
+		for(size_t ii = 0; ii < node->num_children; ii++)
+		{
+			stack = _slc_grow_stack(config, stack, stack_size, &stack_capacity, sizeof(SLCONFIG_NODE*));
+			stack[stack_size++] = node->children[ii];
+		}
+		node = stack_size ? stack[--stack_size] : NULL;
+	}
+	
+	if(stack)
+		config->vtable.realloc(stack, 0);
+	return ret;
+}
+
+static
+void add_part(PARALLEL_SAVE* save, PART_TYPE type, const SLCONFIG_NODE* node, size_t first_child, size_t num_children, size_t depth)
+{
+	save->parts = _slc_grow_stack(node->config, save->parts, save->num_parts, &save->parts_capacity, sizeof(PART));
+	PART* part = &save->parts[save->num_parts++];
+	part->type = type;
+	part->node = node;
+	part->first_child = first_child;
+	part->num_children = num_children;
+	part->depth = depth;
+	part->output.start = part->output.end = NULL;
+}
+
+/*
+ * Split the children of an aggregate into runs of about part_size nodes. Children that are too large for a single part
+ * are split in turn, with their header and closing brace becoming parts of their own
+ */
+static
+void partition(PARALLEL_SAVE* save, const SLCONFIG_NODE* aggregate, size_t depth, size_t split_depth)
+{
+	size_t first_child = 0;
+	size_t run_size = 0;
+	for(size_t ii = 0; ii < aggregate->num_children; ii++)
+	{
+		const SLCONFIG_NODE* child = aggregate->children[ii];
+		size_t size = count_nodes(child);
+		if(size > save->part_size && child->is_aggregate && split_depth < MAX_SPLIT_DEPTH)
+		{
+			if(ii > first_child)
+				add_part(save, PART_CHILDREN, aggregate, first_child, ii - first_child, depth);
+			add_part(save, PART_OPEN, child, 0, 0, depth);
+			partition(save, child, depth + 1, split_depth + 1);
+			add_part(save, PART_CLOSE, child, 0, 0, depth);
+			first_child = ii + 1;
+			run_size = 0;
+		}
+		else
+		{
+			run_size += size;
+			if(run_size >= save->part_size)
+			{
+				add_part(save, PART_CHILDREN, aggregate, first_child, ii + 1 - first_child, depth);
+				first_child = ii + 1;
+				run_size = 0;
+			}
+		}
+	}
+	
+	if(first_child < aggregate->num_children)
+		add_part(save, PART_CHILDREN, aggregate, first_child, aggregate->num_children - first_child, depth);
+}
+
+static
+void render_part(const PARALLEL_SAVE* save, PART* part)
+{
+	SLCONFIG_WRITER writer;
+	init_writer(&writer, save->vtable, NULL, save->line_end, save->indentation, false, false);
+	writer.depth = part->depth;
+	
+	switch(part->type)
+	{
+		case PART_CHILDREN:
+			for(size_t ii = 0; ii < part->num_children; ii++)
+				write_tree(&writer, part->node->children[part->first_child + ii]);
+			break;
+		case PART_OPEN:
+			if(slc_string_length(part->node->comment))
+				slc_writer_comment(&writer, part->node->comment);
+			slc_writer_begin_aggregate(&writer, part->node->type, part->node->name);
+			/* Only aggregates with children are split, so the brace is always needed */
+			open_pending_block(&writer);
+			break;
+		case PART_CLOSE:
+			writer.depth++;
+			slc_writer_end_aggregate(&writer);
+			break;
+	}
+	
+	finish_writer(&writer);
+	part->output.start = writer.buffer;
+	part->output.end = writer.buffer + writer.size;
+}
+
+static
+void render_part_task(void* arg, size_t task)
+{
+	PARALLEL_SAVE* save = arg;
+	render_part(save, &save->parts[task]);
+}
+
+/*
+ * Render the node into parts on num_threads threads. Returns false if the node is not worth splitting, in which case
+ * there are no parts
+ */
+static
+bool render_parallel(PARALLEL_SAVE* save, const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, size_t num_threads)
+{
+	save->vtable = &node->config->vtable;
+	save->line_end = line_end;
+	save->indentation = indentation;
+	save->parts = NULL;
+	save->num_parts = 0;
+	save->parts_capacity = 0;
+	
+	if(num_threads == 0)
+		num_threads = _slc_get_num_cpus();
+	if(num_threads <= 1 || !node->is_aggregate || node->num_children == 0)
+		return false;
+	
+	size_t num_nodes = count_nodes(node);
+	if(num_nodes < PARALLEL_MIN_NODES)
+		return false;
+	save->part_size = num_nodes / (num_threads * PARTS_PER_THREAD) + 1;
+	
+	if(node->parent)
+	{
+		add_part(save, PART_OPEN, node, 0, 0, 0);
+		partition(save, node, 1, 1);
+		add_part(save, PART_CLOSE, node, 0, 0, 0);
+	}
+	else
+	{
+		partition(save, node, 0, 0);
+	}
+	
+	_slc_parallel_for(save->num_parts, num_threads, &render_part_task, save, save->vtable->realloc);
+	return true;
+}
+
+static
+void destroy_parts(PARALLEL_SAVE* save)
+{
+	for(size_t ii = 0; ii < save->num_parts; ii++)
+		save->vtable->realloc((char*)save->parts[ii].output.start, 0);
+	save->vtable->realloc(save->parts, 0);
+}
+
+SLCONFIG_STRING slc_save_node_string_parallel(const SLCONFIG_NODE* node, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, size_t num_threads)
+{
+	PARALLEL_SAVE save;
+	_slc_begin_read(node->config);
+	if(!render_parallel(&save, node, line_end, indentation, num_threads))
+	{
+		SLCONFIG_STRING ret = save_to_string(node, line_end, indentation, false, false);
+		_slc_end_read(node->config);
+		return ret;
+	}
+	_slc_end_read(node->config);
+	
+	size_t size = 0;
+	for(size_t ii = 0; ii < save.num_parts; ii++)
+		size += slc_string_length(save.parts[ii].output);
+	
+	char* buffer = save.vtable->realloc(0, size);
+	char* end = buffer;
+	for(size_t ii = 0; ii < save.num_parts; ii++)
+	{
+		size_t length = slc_string_length(save.parts[ii].output);
+		if(length)
+			memcpy(end, save.parts[ii].output.start, length);
+		end += length;
+	}
+	
+	destroy_parts(&save);
+	SLCONFIG_STRING ret = {buffer, end};
+	return ret;
+}
+
+bool slc_save_node_parallel(const SLCONFIG_NODE* node, SLCONFIG_STRING filename, SLCONFIG_STRING line_end, SLCONFIG_STRING indentation, size_t num_threads)
+{
+	PARALLEL_SAVE save;
+	_slc_begin_read(node->config);
+	if(!render_parallel(&save, node, line_end, indentation, num_threads))
+	{
+		bool ret = save_to_file(node, filename, line_end, indentation, false, false);
+		_slc_end_read(node->config);
+		return ret;
+	}
+	_slc_end_read(node->config);
+	
+	bool ret = false;
+	void* file = save.vtable->fopen(filename, false);
+	if(file)
+	{
+		/* The parts are written one by one rather than gathered into one buffer */
+		ret = true;
+		for(size_t ii = 0; ii < save.num_parts; ii++)
+		{
+			size_t length = slc_string_length(save.parts[ii].output);
+			if(length)
+				ret &= length == save.vtable->fwrite(save.parts[ii].output.start, length, file);
+		}
+		save.vtable->fclose(file);
+	}
+	
+	destroy_parts(&save);
+	return ret;
+}